@@ -0,0 +1,118 @@
+/**
+ * @file bench_disk.c
+ * @author timoteus <mail@timoteus.se>
+ *
+ * Write and read throughput and compression ratio of saved index
+ * arrays for every storage mode (see rock_save_mode in disk.h).
+ *
+ * Usage: bench_disk [file.hdf5 ...]
+ *
+ * The files hold index arrays saved by rock_indx_save, e.g., those of
+ * tests/data.
+ */
+
+#include "core.h"
+#include "disk.h"
+#include "hdf5.h"
+#include "hdf5_hl.h"
+
+#define BENCH_REPS 5
+
+static const char *mode_names[] = {"plain", "deflate", "bitpack"};
+
+/*
+ * The size of a file in bytes.
+ */
+static long
+file_size(char *fname)
+{
+    FILE *f = fopen(fname, "rb");
+    if (f == NULL) {
+        return -1;
+    }
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+
+    return size;
+}
+
+/*
+ * Load an index array saved by rock_indx_save, sized from the file.
+ */
+static rock_indx_t *
+bench_load(char *fname)
+{
+    hsize_t dims[1];
+    hid_t file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+
+    if (file_id < 0) {
+        return NULL;
+    }
+    herr_t status = H5LTget_dataset_info(file_id, "/indx", dims, NULL, NULL);
+    H5Fclose(file_id);
+    if (status < 0) {
+        return NULL;
+    }
+
+    rock_indx_t *indx = rock_indx_init(dims[0]);
+    if (rock_indx_load(indx, fname) != ROCK_OK) {
+        rock_indx_free(indx);
+        return NULL;
+    }
+
+    return indx;
+}
+
+int
+main(int argc, char **argv)
+{
+    char *out = "bench_disk.hdf5";
+
+    printf("%-48s %-8s %10s %10s %8s\n", "file", "mode",
+            "write MB/s", "read MB/s", "ratio");
+
+    for (int f = 1; f < argc; f++) {
+        rock_indx_t *indx = bench_load(argv[f]);
+        if (indx == NULL) {
+            fprintf(stderr, "Failed to load %s\n", argv[f]);
+            return ROCK_ERR;
+        }
+
+        double mb = indx->len * sizeof(rock_uint_t) / 1e6;
+        rock_indx_t *loaded = rock_indx_init(indx->len);
+
+        for (int mode = ROCK_SAVE_PLAIN; mode <= ROCK_SAVE_BITPACK; mode++) {
+            double write_time = 0, read_time = 0;
+
+            rock_save_mode = mode;
+            for (int r = 0; r < BENCH_REPS; r++) {
+                double start = omp_get_wtime();
+                rock_indx_save(indx, out);
+                write_time += omp_get_wtime() - start;
+
+                start = omp_get_wtime();
+                rock_indx_load(loaded, out);
+                read_time += omp_get_wtime() - start;
+            }
+
+            if (!rock_indx_eq(indx, loaded)) {
+                fprintf(stderr, "Mismatch for %s\n", argv[f]);
+                return ROCK_ERR;
+            }
+
+            char *name = strrchr(argv[f], '/');
+            printf("%-48s %-8s %10.1f %10.1f %8.2f\n",
+                    name ? name + 1 : argv[f], mode_names[mode],
+                    BENCH_REPS * mb / write_time, BENCH_REPS * mb / read_time,
+                    indx->len * sizeof(rock_uint_t) / (double) file_size(out));
+        }
+
+        rock_indx_free(indx);
+        rock_indx_free(loaded);
+    }
+
+    remove(out);
+
+    return ROCK_OK;
+}
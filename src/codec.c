@@ -0,0 +1,301 @@
+/**
+ * @file codec.c
+ * @author timoteus <mail@timoteus.se>
+ */
+
+#include "codec.h"
+
+#define ROCK_UINT_BITS (sizeof(rock_uint_t) * CHAR_BIT)
+
+/*
+ * Map the difference between two values to a small unsigned number,
+ * i.e., 0, -1, +1, -2, +2, ... to 0, 1, 2, 3, 4, ...
+ */
+static inline rock_uint_t
+codec_zigzag(rock_uint_t val, rock_uint_t prev)
+{
+    rock_uint_t delta = val - prev;
+    rock_uint_t sign = -(delta >> (ROCK_UINT_BITS - 1));
+
+    return (delta << 1) ^ sign;
+}
+
+static inline rock_uint_t
+codec_unzigzag(rock_uint_t zz, rock_uint_t prev)
+{
+    return prev + ((zz >> 1) ^ -(zz & 1));
+}
+
+size_t
+rock_codec_size(const rock_uint_t *v, rock_uint_t len)
+{
+    size_t size = 0;
+    rock_uint_t prev = 0;
+
+    for (rock_uint_t i = 0; i < len; i++) {
+        rock_uint_t zz = codec_zigzag(v[i], prev);
+
+        do {
+            size++;
+            zz >>= 7;
+        } while (zz);
+
+        prev = v[i];
+    }
+
+    return size;
+}
+
+size_t
+rock_codec_encode(const rock_uint_t *v, rock_uint_t len, uint8_t *buf)
+{
+    size_t pos = 0;
+    rock_uint_t prev = 0;
+
+    for (rock_uint_t i = 0; i < len; i++) {
+        rock_uint_t zz = codec_zigzag(v[i], prev);
+
+        /* Seven bits per byte, the high bit marks more bytes to come. */
+        while (zz >= 0x80) {
+            buf[pos++] = (uint8_t) (zz | 0x80);
+            zz >>= 7;
+        }
+        buf[pos++] = (uint8_t) zz;
+
+        prev = v[i];
+    }
+
+    return pos;
+}
+
+size_t
+rock_codec_decode(const uint8_t *buf, rock_uint_t len, rock_uint_t *v)
+{
+    size_t pos = 0;
+    rock_uint_t prev = 0;
+
+    for (rock_uint_t i = 0; i < len; i++) {
+        rock_uint_t zz = 0;
+        unsigned shift = 0;
+        uint8_t byte;
+
+        do {
+            byte = buf[pos++];
+            zz |= (rock_uint_t) (byte & 0x7f) << shift;
+            shift += 7;
+        } while (byte & 0x80);
+
+        prev = codec_unzigzag(zz, prev);
+        v[i] = prev;
+    }
+
+    return pos;
+}
+
+/*
+ * The number of bits needed to represent a value.
+ */
+static inline unsigned
+codec_width(rock_uint_t val)
+{
+    unsigned width = 0;
+
+    while (val) {
+        width++;
+        val >>= 1;
+    }
+
+    return width;
+}
+
+/*
+ * Zigzag a block of values and choose the bit width minimizing its
+ * packed size. Values wider than that (exceptions) store their high
+ * bits as varints after the block, preceded by their position.
+ */
+static unsigned
+codec_block(const rock_uint_t *v,
+            rock_uint_t len,
+            rock_uint_t *prev,
+            rock_uint_t *zz,
+            size_t *size)
+{
+    size_t count[ROCK_UINT_BITS + 1] = {0};
+    unsigned max_width = 0;
+
+    for (rock_uint_t i = 0; i < len; i++) {
+        unsigned width;
+
+        zz[i] = codec_zigzag(v[i], *prev);
+        width = codec_width(zz[i]);
+        count[width]++;
+        max_width = (width > max_width) ? width : max_width;
+        *prev = v[i];
+    }
+
+    unsigned best_width = max_width;
+    *size = 2 + ((size_t) len * max_width + 7) / 8;
+
+    for (unsigned w = 0; w < max_width; w++) {
+        size_t cost = 2 + ((size_t) len * w + 7) / 8;
+
+        for (unsigned b = w + 1; b <= max_width; b++) {
+            cost += count[b] * (1 + (b - w + 6) / 7);
+        }
+
+        if (cost < *size) {
+            *size = cost;
+            best_width = w;
+        }
+    }
+
+    return best_width;
+}
+
+size_t
+rock_codec_pack_size(const rock_uint_t *v, rock_uint_t len)
+{
+    size_t size = 0;
+    rock_uint_t prev = 0;
+    rock_uint_t zz[ROCK_CODEC_BLOCK_LEN];
+
+    for (rock_uint_t b = 0; b < len; b += ROCK_CODEC_BLOCK_LEN) {
+        rock_uint_t n = (len - b < ROCK_CODEC_BLOCK_LEN) ?
+                len - b : ROCK_CODEC_BLOCK_LEN;
+        size_t block_size;
+
+        codec_block(&v[b], n, &prev, zz, &block_size);
+        size += block_size;
+    }
+
+    return size;
+}
+
+size_t
+rock_codec_pack(const rock_uint_t *v, rock_uint_t len, uint8_t *buf)
+{
+    size_t pos = 0;
+    rock_uint_t prev = 0;
+    rock_uint_t zz[ROCK_CODEC_BLOCK_LEN];
+
+    for (rock_uint_t b = 0; b < len; b += ROCK_CODEC_BLOCK_LEN) {
+        rock_uint_t n = (len - b < ROCK_CODEC_BLOCK_LEN) ?
+                len - b : ROCK_CODEC_BLOCK_LEN;
+        size_t block_size;
+        unsigned width = codec_block(&v[b], n, &prev, zz, &block_size);
+        size_t num_bytes = ((size_t) n * width + 7) / 8;
+        uint8_t *num_exc = &buf[pos + 1];
+
+        buf[pos] = (uint8_t) width;
+        *num_exc = 0;
+        pos += 2;
+        memset(&buf[pos], 0, num_bytes);
+
+        /* Least significant bits first, a byte (or less) at a time. */
+        size_t bit = 0;
+        for (rock_uint_t i = 0; i < n; i++) {
+            for (unsigned k = 0; k < width; ) {
+                unsigned off = bit & 7;
+                unsigned take = (8 - off < width - k) ? 8 - off : width - k;
+
+                buf[pos + (bit >> 3)] |=
+                        (uint8_t) (((zz[i] >> k) & ((1u << take) - 1)) << off);
+                k += take;
+                bit += take;
+            }
+        }
+        pos += num_bytes;
+
+        for (rock_uint_t i = 0; i < n; i++) {
+            rock_uint_t high = (width < ROCK_UINT_BITS) ? zz[i] >> width : 0;
+
+            if (high) {
+                (*num_exc)++;
+                buf[pos++] = (uint8_t) i;
+                while (high >= 0x80) {
+                    buf[pos++] = (uint8_t) (high | 0x80);
+                    high >>= 7;
+                }
+                buf[pos++] = (uint8_t) high;
+            }
+        }
+    }
+
+    return pos;
+}
+
+size_t
+rock_codec_unpack(const uint8_t *buf,
+                  size_t size,
+                  rock_uint_t len,
+                  rock_uint_t *v)
+{
+    size_t pos = 0;
+    rock_uint_t prev = 0;
+    rock_uint_t zz[ROCK_CODEC_BLOCK_LEN];
+
+    for (rock_uint_t b = 0; b < len; b += ROCK_CODEC_BLOCK_LEN) {
+        rock_uint_t n = (len - b < ROCK_CODEC_BLOCK_LEN) ?
+                len - b : ROCK_CODEC_BLOCK_LEN;
+
+        if (size - pos < 2) {
+            return 0;
+        }
+
+        unsigned width = buf[pos];
+        unsigned num_exc = buf[pos + 1];
+        pos += 2;
+
+        /* Reject what rock_codec_pack never writes. */
+        if (width > ROCK_UINT_BITS || num_exc > n ||
+                (width == ROCK_UINT_BITS && num_exc > 0) ||
+                size - pos < ((size_t) n * width + 7) / 8) {
+            return 0;
+        }
+
+        size_t bit = 0;
+        for (rock_uint_t i = 0; i < n; i++) {
+            zz[i] = 0;
+
+            for (unsigned k = 0; k < width; ) {
+                unsigned off = bit & 7;
+                unsigned take = (8 - off < width - k) ? 8 - off : width - k;
+
+                zz[i] |= (rock_uint_t) ((buf[pos + (bit >> 3)] >> off) &
+                        ((1u << take) - 1)) << k;
+                k += take;
+                bit += take;
+            }
+        }
+        pos += ((size_t) n * width + 7) / 8;
+
+        for (unsigned e = 0; e < num_exc; e++) {
+            if (pos >= size || buf[pos] >= n) {
+                return 0;
+            }
+
+            rock_uint_t i = buf[pos++];
+            rock_uint_t high = 0;
+            unsigned shift = 0;
+            uint8_t byte;
+
+            do {
+                if (pos >= size || shift >= ROCK_UINT_BITS) {
+                    return 0;
+                }
+                byte = buf[pos++];
+                high |= (rock_uint_t) (byte & 0x7f) << shift;
+                shift += 7;
+            } while (byte & 0x80);
+
+            zz[i] |= high << width;
+        }
+
+        for (rock_uint_t i = 0; i < n; i++) {
+            prev = codec_unzigzag(zz[i], prev);
+            v[b + i] = prev;
+        }
+    }
+
+    return pos;
+}
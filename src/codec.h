@@ -0,0 +1,116 @@
+/**
+ * @file codec.h
+ * @author timoteus <mail@timoteus.se>
+ *
+ * Compact encoding of index arrays, e.g., to send less data over the
+ * network. Every value is stored as the difference to the previous
+ * value (delta), mapped to an unsigned number such that small negative
+ * and positive differences are both small (zigzag), using as few bytes
+ * as needed (varint, seven bits per byte):
+ *
+ *     values     100      103      101      300
+ *     deltas     100       +3       -2     +199
+ *     zigzag     200        6        3      398
+ *     bytes    c8 01       06       03    8e 03
+ *
+ * Sorted runs of packed multi-indices thus mostly take one or two bytes
+ * per index. Unsorted arrays round-trip as well, only less compactly.
+ *
+ * The packed variant (@c rock_codec_pack) stores the zigzag deltas of
+ * every block of @c ROCK_CODEC_BLOCK_LEN values using a common bit
+ * width, chosen to minimize the size of the block. The few values wider
+ * than that (exceptions, e.g., jumps to the next fiber) store their
+ * high bits as varints after the block:
+ *
+ *     block      [width] [num_exc] [packed low bits ...]
+ *                [position] [varint high bits] ...   (num_exc times)
+ *
+ * which avoids the byte granularity of varints for long sorted runs.
+ */
+
+#ifndef _CODEC_H
+#define _CODEC_H
+
+#include "core.h"
+
+/** The largest number of bytes of one encoded value. */
+#define ROCK_CODEC_MAX_BYTES ((sizeof(rock_uint_t) * CHAR_BIT + 6) / 7)
+
+/** The number of values sharing a bit width in packed arrays. */
+#define ROCK_CODEC_BLOCK_LEN 128
+
+/**
+ * Calculate the number of bytes of an encoded array of values.
+ *
+ * @param [in] v            The values to encode.
+ * @param [in] len          The number of values.
+ * @return                  The number of bytes @c rock_codec_encode writes.
+ */
+size_t
+rock_codec_size(const rock_uint_t *v, rock_uint_t len);
+
+/**
+ * Encode an array of values.
+ *
+ * @param [in] v            The values to encode.
+ * @param [in] len          The number of values.
+ * @param [out] buf         The encoded bytes, large enough to fit
+ *                          @c rock_codec_size bytes.
+ * @return                  The number of bytes written.
+ */
+size_t
+rock_codec_encode(const rock_uint_t *v, rock_uint_t len, uint8_t *buf);
+
+/**
+ * Decode an array of values.
+ *
+ * @param [in] buf          The encoded bytes.
+ * @param [in] len          The number of values to decode.
+ * @param [out] v           The decoded values.
+ * @return                  The number of bytes read.
+ */
+size_t
+rock_codec_decode(const uint8_t *buf, rock_uint_t len, rock_uint_t *v);
+
+/**
+ * Calculate the number of bytes of a bit-packed array of values.
+ *
+ * @param [in] v            The values to pack.
+ * @param [in] len          The number of values.
+ * @return                  The number of bytes @c rock_codec_pack writes.
+ */
+size_t
+rock_codec_pack_size(const rock_uint_t *v, rock_uint_t len);
+
+/**
+ * Bit-pack an array of values.
+ *
+ * @param [in] v            The values to pack.
+ * @param [in] len          The number of values.
+ * @param [out] buf         The packed bytes, large enough to fit
+ *                          @c rock_codec_pack_size bytes.
+ * @return                  The number of bytes written.
+ */
+size_t
+rock_codec_pack(const rock_uint_t *v, rock_uint_t len, uint8_t *buf);
+
+/**
+ * Unpack an array of bit-packed values.
+ *
+ * Never reads past @c size bytes, such that corrupt or truncated input
+ * (e.g., read from a file) is detected.
+ *
+ * @param [in] buf          The packed bytes.
+ * @param [in] size         The number of bytes available.
+ * @param [in] len          The number of values to unpack.
+ * @param [out] v           The unpacked values.
+ * @return                  The number of bytes read, or 0 if the bytes
+ *                          don't hold @c len values.
+ */
+size_t
+rock_codec_unpack(const uint8_t *buf,
+                  size_t size,
+                  rock_uint_t len,
+                  rock_uint_t *v);
+
+#endif
@@ -48,7 +48,7 @@
 
 #define ROCK_MAX_SHIFT ROCK_MAX_ORDER - 1
 
-#define ROCK_MAX_MESH_ORDER 3
+#define ROCK_MAX_MESH_ORDER ROCK_MAX_ORDER
 #define ROCK_MASTER 0
 
 #define ROCK_PARALLEL_THRESHOLD 1e5
@@ -57,6 +57,12 @@
 
 #define ROCK_DEFAULT_RADIX_BITS 8
 
+#define ROCK_DEFAULT_CHUNK_LEN (1 << 20)
+
+#define ROCK_DEFAULT_SAVE_CHUNK_LEN (1 << 16)
+
+#define ROCK_DEFAULT_SAVE_LEVEL 4
+
 #include "error_codes.h"
 
 #endif
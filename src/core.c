@@ -37,7 +37,7 @@ rock_indx_t *
 rock_indx_init(rock_uint_t len)
 {
     rock_indx_t *indx = calloc(1, sizeof(rock_indx_t));
-    indx->v = calloc(len, sizeof(rock_indx_t));
+    indx->v = calloc(len, sizeof(*indx->v));
 
     indx->len = len;
 
@@ -48,7 +48,7 @@ rock_elem_t *
 rock_elem_init(rock_uint_t len)
 {
     rock_elem_t *elem = calloc(1, sizeof(rock_elem_t));
-    elem->v = calloc(len, sizeof(rock_elem_t));
+    elem->v = calloc(len, sizeof(*elem->v));
 
     elem->len = len;
 
@@ -114,6 +114,26 @@ rock_freq_init(rock_desc_t *desc, rock_indx_t *indx)
     return freq;
 }
 
+rock_lmap_t *
+rock_lmap_init(rock_desc_t *desc)
+{
+    rock_lmap_t *lmap = calloc(1, sizeof(rock_lmap_t));
+
+    for (rock_uint_t i = 0; i < desc->order; i++) {
+        lmap->dim_map[i] = calloc(desc->dim_size[i], sizeof(rock_uint_t));
+        lmap->dim_inv[i] = calloc(desc->dim_size[i], sizeof(rock_uint_t));
+
+        for (rock_uint_t k = 0; k < desc->dim_size[i]; k++) {
+            lmap->dim_map[i][k] = k;
+            lmap->dim_inv[i][k] = k;
+        }
+    }
+
+    lmap->desc = desc;
+
+    return lmap;
+}
+
 rock_view_t *
 rock_view_init(rock_desc_t *desc,
                rock_indx_t *indx,
@@ -209,11 +229,22 @@ rock_view_free(rock_view_t *view)
     free(view);
 }
 
+void
+rock_lmap_free(rock_lmap_t *lmap)
+{
+    for (rock_uint_t i = 0; i < lmap->desc->order; i++) {
+        free(lmap->dim_map[i]);
+        free(lmap->dim_inv[i]);
+    }
+
+    free(lmap);
+}
+
 rock_indx_t *
 rock_indx_copy(rock_indx_t *indx)
 {
     rock_indx_t *copy = rock_indx_init(indx->len);
-    memcpy(copy->v, indx->v, sizeof(indx->v)*indx->len);
+    memcpy(copy->v, indx->v, sizeof(*indx->v)*indx->len);
 
     return copy;
 }
@@ -222,7 +253,7 @@ rock_elem_t *
 rock_elem_copy(rock_elem_t *elem)
 {
     rock_elem_t *copy = rock_elem_init(elem->len);
-    memcpy(copy->v, elem->v, sizeof(elem->v)*elem->len);
+    memcpy(copy->v, elem->v, sizeof(*elem->v)*elem->len);
 
     return copy;
 }
@@ -339,7 +370,7 @@ rock_indx_permute_alt(rock_indx_t *indx,
         for (rock_uint_t i = 0; i < indx->len; i++) {
             tmp->v[i] = indx->v[perm->v[i]];
         }
-        memcpy(indx->v, tmp->v, sizeof(rock_indx_t)*indx->len);
+        memcpy(indx->v, tmp->v, sizeof(*indx->v)*indx->len);
 
         rock_indx_free(tmp);
     }
@@ -372,7 +403,7 @@ rock_elem_permute_alt(rock_elem_t *elem,
             tmp->v[i] = elem->v[perm->v[i]];
         }
 
-        memcpy(elem->v, tmp->v, sizeof(rock_elem_t)*elem->len);
+        memcpy(elem->v, tmp->v, sizeof(*elem->v)*elem->len);
 
         rock_elem_free(tmp);
     }
@@ -489,3 +520,192 @@ rock_part_desc_based(rock_desc_t *desc,
 
     return ROCK_OK;
 }
+
+rock_uint_t
+rock_part_find(rock_part_t *part, rock_uint_t val)
+{
+    /* Binary search for the last part starting at or before val. */
+    rock_uint_t low = 0;
+    rock_uint_t high = part->num_parts - 1;
+
+    while (low < high) {
+        rock_uint_t mid = (low + high + 1) / 2;
+        if (part->offset[mid] <= val) {
+            low = mid;
+        } else {
+            high = mid - 1;
+        }
+    }
+
+    return low;
+}
+
+int
+rock_part_freq_based(rock_freq_t *freq,
+                     rock_part_t *part,
+                     rock_uint_t dim_num)
+{
+    rock_desc_t *desc = freq->desc;
+
+    if (dim_num >= desc->order) {
+        return ROCK_BAD_INPUT;
+    }
+    if (desc->dim_size[dim_num] < part->num_parts) {
+        return ROCK_BAD_INPUT;
+    }
+
+    rock_uint_t *dim_freq = freq->dim_freq[dim_num];
+    rock_uint_t dim_size = desc->dim_size[dim_num];
+    rock_uint_t num_parts = part->num_parts;
+
+    uint64_t total = 0;
+    for (rock_uint_t i = 0; i < dim_size; i++) {
+        total += dim_freq[i];
+    }
+
+    rock_uint_t i = 0;
+    uint64_t sum = 0;
+
+    part->offset[0] = 0;
+
+    for (rock_uint_t k = 1; k < num_parts; k++) {
+        uint64_t target = total * k / num_parts;
+
+        /* Leave room for at least one index in each part. */
+        rock_uint_t first = part->offset[k-1] + 1;
+        rock_uint_t last = dim_size - (num_parts - k);
+
+        while (i < last && sum + dim_freq[i] <= target) {
+            sum += dim_freq[i++];
+        }
+
+        /* Include the straddling index if that gets us closer. */
+        if (i < last && sum + dim_freq[i] - target < target - sum) {
+            sum += dim_freq[i++];
+        }
+
+        while (i < first) {
+            sum += dim_freq[i++];
+        }
+
+        part->offset[k] = i;
+    }
+
+    part->offset[num_parts] = dim_size;
+
+    return ROCK_OK;
+}
+
+int
+rock_lmap_freq_based(rock_lmap_t *lmap,
+                     rock_freq_t *freq,
+                     rock_uint_t *dim_num_parts)
+{
+    rock_desc_t *desc = lmap->desc;
+
+    for (rock_uint_t i = 0; i < desc->order; i++) {
+        if (dim_num_parts[i] == 0 || desc->dim_size[i] < dim_num_parts[i]) {
+            return ROCK_BAD_INPUT;
+        }
+    }
+
+    for (rock_uint_t i = 0; i < desc->order; i++) {
+        rock_uint_t dim_size = desc->dim_size[i];
+        rock_uint_t *dim_freq = freq->dim_freq[i];
+
+        /* Order the indices by frequency using a one-dimensional sort. */
+        rock_uint_t max_freq = 0;
+        for (rock_uint_t k = 0; k < dim_size; k++) {
+            max_freq = (dim_freq[k] > max_freq) ? dim_freq[k] : max_freq;
+        }
+
+        rock_perm_t *perm = rock_perm_init(dim_size);
+
+        if (max_freq == 0) {
+            for (rock_uint_t k = 0; k < dim_size; k++) {
+                perm->v[k] = k;
+            }
+        } else {
+            rock_uint_t freq_size[] = {max_freq + 1};
+            rock_uint_t dims[] = {0};
+            rock_desc_t *freq_desc = rock_desc_init(1, freq_size);
+            rock_indx_t *freq_indx = rock_indx_init(dim_size);
+
+            memcpy(freq_indx->v, dim_freq, dim_size * sizeof(rock_uint_t));
+            rock_indx_sort(freq_desc, 1, dims, perm, freq_indx);
+
+            rock_indx_free(freq_indx);
+            rock_desc_free(freq_desc);
+        }
+
+        /* Parts as created by rock_part_desc_based. */
+        rock_uint_t num_parts = dim_num_parts[i];
+        rock_part_t *part = rock_part_init(num_parts);
+        rock_part_desc_based(desc, part, i);
+
+        rock_uint_t *next = calloc(num_parts, sizeof(rock_uint_t));
+        memcpy(next, part->offset, num_parts * sizeof(rock_uint_t));
+
+        /* Hand out labels round-robin, hottest index first. */
+        rock_uint_t curr = 0;
+        for (rock_uint_t k = dim_size; k-- > 0;) {
+            while (next[curr] == part->offset[curr+1]) {
+                curr = (curr + 1) % num_parts;
+            }
+
+            rock_uint_t old = perm->v[k];
+            rock_uint_t new = next[curr]++;
+
+            lmap->dim_map[i][old] = new;
+            lmap->dim_inv[i][new] = old;
+
+            curr = (curr + 1) % num_parts;
+        }
+
+        free(next);
+        rock_part_free(part);
+        rock_perm_free(perm);
+    }
+
+    return ROCK_OK;
+}
+
+/*
+ * Replace every index of every dimension of an index array using one
+ * lookup table per dimension.
+ */
+static void
+indx_relabel(rock_desc_t *desc,
+             rock_uint_t **dim_map,
+             rock_indx_t *indx)
+{
+    #pragma omp parallel for num_threads(rock_thread_count(indx->len))
+    for (rock_uint_t i = 0; i < indx->len; i++) {
+        rock_uint_t val = indx->v[i];
+        rock_uint_t out = 0;
+
+        for (rock_uint_t k = 0; k < desc->order; k++) {
+            rock_uint_t dim_val = (val & desc->bit_mask[k])
+                    >> desc->bit_offset[k];
+            out |= dim_map[k][dim_val] << desc->bit_offset[k];
+        }
+
+        indx->v[i] = out;
+    }
+}
+
+int
+rock_indx_relabel(rock_lmap_t *lmap, rock_indx_t *indx)
+{
+    indx_relabel(lmap->desc, lmap->dim_map, indx);
+
+    return ROCK_OK;
+}
+
+int
+rock_indx_relabel_inv(rock_lmap_t *lmap, rock_indx_t *indx)
+{
+    indx_relabel(lmap->desc, lmap->dim_inv, indx);
+
+    return ROCK_OK;
+}
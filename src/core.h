@@ -118,6 +118,13 @@ typedef struct rock_elem_s
 
 } rock_elem_t;
 
+/** The size of an element. */
+#ifdef ROCK_ELEM_DOUBLE
+    #define ROCK_ELEM_SIZE sizeof(double)
+#else
+    #define ROCK_ELEM_SIZE sizeof(float)
+#endif
+
 /** An array of unpacked unsigned integers (indices). */
 typedef struct rock_upkd_s
 {
@@ -219,6 +226,30 @@ typedef struct rock_view_s
 
 } rock_view_t;
 
+/**
+ * Label map object.
+ *
+ * Represents a relabeling of the indices of each dimension of a tensor
+ * together with its inverse.
+ *
+ * Used to spread frequently occurring ("hot") indices over the tensor
+ * space, which makes partitions based on tensor space (e.g.
+ * @c rock_part_desc_based) balanced also for skewed tensors. The
+ * inverse maps are kept so results can be mapped back.
+ */
+typedef struct rock_lmap_s
+{
+    /** Reference of a tensor descriptor (not owned). */
+    rock_desc_t *desc;
+
+    /** The mapping from old to new index (one for each dimension). */
+    rock_uint_t *dim_map[ROCK_MAX_ORDER];
+
+    /** The mapping from new to old index (one for each dimension). */
+    rock_uint_t *dim_inv[ROCK_MAX_ORDER];
+
+} rock_lmap_t;
+
 /**
  * Initialize a tensor descriptor object.
  *
@@ -313,6 +344,18 @@ rock_view_init(rock_desc_t *desc,
                rock_indx_t *indx,
                rock_uint_t sorted_dim);
 
+/**
+ * Initialize a label map object.
+ *
+ * Every dimension is initialized with the identity mapping. Use
+ * @c rock_lmap_freq_based or @c rock_lmap_sample to populate it.
+ *
+ * @param [in] desc         Descriptor object to associate with map.
+ * @return                  Initialized label map object.
+ */
+rock_lmap_t *
+rock_lmap_init(rock_desc_t *desc);
+
 /**
  * Free a tensor descriptor object.
  *
@@ -381,6 +424,16 @@ rock_freq_free(rock_freq_t *freq);
 void
 rock_view_free(rock_view_t *view);
 
+/**
+ * Free a label map object.
+ *
+ * Associated objects should be free'd separately.
+ *
+ * @param [in] lmap
+ */
+void
+rock_lmap_free(rock_lmap_t *lmap);
+
 /**
  * Duplicate an index array.
  *
@@ -599,6 +652,79 @@ rock_part_desc_based(rock_desc_t *desc,
                      rock_part_t *part,
                      rock_uint_t dim_num);
 
+/**
+ * Find the part of a partition object a value belongs to.
+ *
+ * @param [in] part
+ * @param [in] val          A value between @c offset[0] and
+ *                          @c offset[num_parts] (exclusive).
+ * @return                  The number of the part.
+ */
+rock_uint_t
+rock_part_find(rock_part_t *part, rock_uint_t val);
+
+/**
+ * Partition a dimension of a tensor based on index frequencies.
+ *
+ * Split points are chosen such that each part holds about the same
+ * number of non-zero elements, which makes this routine suitable for
+ * skewed tensors where @c rock_part_desc_based would result in an
+ * unbalanced partition. Each part contains at least one index.
+ *
+ *          dim_freq
+ *     +--------+--+-+-------+
+ *     |########|##|#|#######|   part->num_parts = 4
+ *     +--------+--+-+-------+
+ *
+ * @param [in] freq         Frequencies to base partition on.
+ * @param [in,out] part     An already initialized partition object.
+ * @param [in] dim_num      The dimension to partition.
+ */
+int
+rock_part_freq_based(rock_freq_t *freq,
+                     rock_part_t *part,
+                     rock_uint_t dim_num);
+
+/**
+ * Populate a label map based on index frequencies.
+ *
+ * The indices of each dimension are ordered by decreasing frequency and
+ * handed out round-robin over the parts that @c rock_part_desc_based
+ * would create, such that every part gets its share of hot indices:
+ *
+ *     freq       9 7 5 3 2 1         new labels
+ *     index      4 0 2 5 1 3    ->   +-------+-------+
+ *                                    | 4 2 1 | 0 5 3 |
+ *     num_parts  2                   +-------+-------+
+ *
+ * @param [in,out] lmap         An initialized label map object.
+ * @param [in] freq             Frequencies of the tensor to relabel.
+ * @param [in] dim_num_parts    The number of parts of each dimension
+ *                              (1 for dimensions not partitioned).
+ */
+int
+rock_lmap_freq_based(rock_lmap_t *lmap,
+                     rock_freq_t *freq,
+                     rock_uint_t *dim_num_parts);
+
+/**
+ * Relabel an index array using a label map.
+ *
+ * @param [in] lmap         The label map to apply.
+ * @param [in,out] indx     The index array to relabel.
+ */
+int
+rock_indx_relabel(rock_lmap_t *lmap, rock_indx_t *indx);
+
+/**
+ * Restore the original labels of a relabeled index array.
+ *
+ * @param [in] lmap         The label map previously applied.
+ * @param [in,out] indx     The index array to restore.
+ */
+int
+rock_indx_relabel_inv(rock_lmap_t *lmap, rock_indx_t *indx);
+
 /**
  * Get the @c ith multi-index from a multi-index array.
  *
@@ -6,16 +6,201 @@
 #include "disk.h"
 #include "hdf5.h"
 #include "hdf5_hl.h"
+#include "codec.h"
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define NATIVE_MAGIC "ROCKTNS"
+#define NATIVE_VERSION 1
+
+/*
+ * The header of native files, see rock_tensor_save_native.
+ */
+typedef struct disk_native_header_s
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t word_size;
+    uint32_t elem_size;
+    uint32_t order;
+    uint64_t len;
+    uint64_t sorted_dim;
+    uint64_t dim_size[64];
+    uint64_t indx_offset;
+    uint64_t elem_offset;
+
+} disk_native_header_t;
+
+/* Use default value if not manually overridden. */
+int rock_save_mode = ROCK_USE_DEFAULT;
+int rock_save_chunk_len = ROCK_USE_DEFAULT;
+int rock_save_level = ROCK_USE_DEFAULT;
+
+/*
+ * HDF5 filter delta-encoding and bit-packing a chunk of unsigned
+ * integers, see codec.h. The chunk is stored as the number of values
+ * (eight bytes) followed by the packed values. The size of the values
+ * is the only client data (cd_values[0]).
+ */
+static size_t
+disk_filter_bitpack(unsigned flags,
+                    size_t cd_nelmts,
+                    const unsigned cd_values[],
+                    size_t nbytes,
+                    size_t *buf_size,
+                    void **buf)
+{
+    uint64_t len;
+    size_t size;
+
+    if (cd_nelmts < 1 || cd_values[0] != sizeof(rock_uint_t)) {
+        return 0;
+    }
+
+    if (flags & H5Z_FLAG_REVERSE) {
+        if (nbytes < sizeof(len)) {
+            return 0;
+        }
+        memcpy(&len, *buf, sizeof(len));
+
+        /* Every block takes at least two bytes, don't trust the header. */
+        size_t packed_size = nbytes - sizeof(len);
+        if (len > (uint64_t) (packed_size / 2) * ROCK_CODEC_BLOCK_LEN) {
+            return 0;
+        }
+
+        size = len * sizeof(rock_uint_t);
+        rock_uint_t *v = malloc(size + sizeof(rock_uint_t));
+        if (len > 0 && rock_codec_unpack((uint8_t *) *buf + sizeof(len),
+                    packed_size, len, v) == 0) {
+            free(v);
+            return 0;
+        }
+
+        free(*buf);
+        *buf = v;
+        *buf_size = size + sizeof(rock_uint_t);
+    } else {
+        len = nbytes / sizeof(rock_uint_t);
+
+        /* At worst every block is stored at full width. */
+        uint8_t *packed = malloc(sizeof(len) + nbytes +
+                2 * (len / ROCK_CODEC_BLOCK_LEN + 1));
+        memcpy(packed, &len, sizeof(len));
+        size = sizeof(len) + rock_codec_pack(*buf, len, packed + sizeof(len));
+
+        /* Optional filter, incompressible chunks are stored as is. */
+        if (size >= nbytes) {
+            free(packed);
+            return 0;
+        }
+
+        free(*buf);
+        *buf = packed;
+        *buf_size = size;
+    }
+
+    return size;
+}
+
+int
+rock_filter_register()
+{
+    static const H5Z_class2_t filter_class = {
+        H5Z_CLASS_T_VERS,
+        ROCK_H5Z_FILTER_BITPACK,
+        1, 1,
+        "rock delta bit-packing",
+        NULL,
+        NULL,
+        disk_filter_bitpack
+    };
+
+    if (H5Zfilter_avail(ROCK_H5Z_FILTER_BITPACK) > 0) {
+        return ROCK_OK;
+    }
+
+    if (H5Zregister(&filter_class) < 0) {
+        return ROCK_ERR;
+    }
+
+    return ROCK_OK;
+}
+
+/*
+ * Create and write a one-dimensional dataset as set by rock_save_mode.
+ * Bit-packing only applies to arrays of unsigned integers (packable),
+ * other arrays are shuffled and deflated instead.
+ */
+static herr_t
+disk_make_dataset(hid_t file_id,
+                  const char *name,
+                  rock_uint_t len,
+                  hid_t type,
+                  bool packable,
+                  const void *buf)
+{
+    hsize_t dims[] = {len};
+    int mode = (rock_save_mode == ROCK_USE_DEFAULT) ?
+            ROCK_SAVE_PLAIN : rock_save_mode;
+
+    /* Chunks can't be empty. */
+    if (mode == ROCK_SAVE_PLAIN || len == 0) {
+        return H5LTmake_dataset(file_id, name, 1, dims, type, buf);
+    }
+
+    hsize_t chunk_dims[] = {(rock_save_chunk_len == ROCK_USE_DEFAULT) ?
+            ROCK_DEFAULT_SAVE_CHUNK_LEN : rock_save_chunk_len};
+    if (chunk_dims[0] > len) {
+        chunk_dims[0] = len;
+    }
+
+    hid_t dcpl_id = H5Pcreate(H5P_DATASET_CREATE);
+    herr_t status = H5Pset_chunk(dcpl_id, 1, chunk_dims);
+
+    if (mode == ROCK_SAVE_BITPACK && packable) {
+        unsigned cd_values[] = {sizeof(rock_uint_t)};
+
+        status |= rock_filter_register();
+        status |= H5Pset_filter(dcpl_id, ROCK_H5Z_FILTER_BITPACK,
+                H5Z_FLAG_OPTIONAL, 1, cd_values);
+    } else {
+        status |= H5Pset_shuffle(dcpl_id);
+        status |= H5Pset_deflate(dcpl_id,
+                (rock_save_level == ROCK_USE_DEFAULT) ?
+                ROCK_DEFAULT_SAVE_LEVEL : rock_save_level);
+    }
+
+    hid_t space_id = H5Screate_simple(1, dims, NULL);
+    hid_t dset_id = H5Dcreate2(file_id, name, type, space_id, H5P_DEFAULT,
+            dcpl_id, H5P_DEFAULT);
+
+    if (status || dset_id < 0 ||
+            H5Dwrite(dset_id, type, H5S_ALL, H5S_ALL, H5P_DEFAULT, buf) < 0) {
+        status = -1;
+    }
+
+    if (dset_id >= 0) {
+        H5Dclose(dset_id);
+    }
+    H5Sclose(space_id);
+    H5Pclose(dcpl_id);
+
+    return status ? -1 : 0;
+}
 
 int
 rock_indx_save(rock_indx_t *indx, char *fname)
 {
     hid_t file_id;
     herr_t status;
-    hsize_t dims[] = {indx->len};
 
     file_id = H5Fcreate (fname, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
-    status = H5LTmake_dataset(file_id, "/indx", 1, dims, ROCK_UINT_H5T, indx->v);
+    status = disk_make_dataset(file_id, "/indx", indx->len, ROCK_UINT_H5T, true,
+            indx->v);
     if (status) {
         return ROCK_ERR;
     }
@@ -33,6 +218,7 @@ rock_indx_load(rock_indx_t *indx, char *fname)
     hid_t file_id;
     herr_t status;
 
+    rock_filter_register();
     file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
 #ifdef ROCK_WORD_SIZE_64
     status = H5LTread_dataset_long(file_id, "/indx", (long *)indx->v);
@@ -55,10 +241,10 @@ rock_elem_save(rock_elem_t *elem, char *fname)
 {
     hid_t file_id;
     herr_t status;
-    hsize_t dims[] = {elem->len};
 
     file_id = H5Fcreate (fname, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
-    status = H5LTmake_dataset(file_id, "/elem", 1, dims, ROCK_ELEM_H5T, elem->v);
+    status = disk_make_dataset(file_id, "/elem", elem->len, ROCK_ELEM_H5T,
+            false, elem->v);
     if (status) {
         return ROCK_ERR;
     }
@@ -76,6 +262,7 @@ rock_elem_load(rock_elem_t *elem, char *fname)
     hid_t file_id;
     herr_t status;
 
+    rock_filter_register();
     file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
 #ifdef ROCK_ELEM_FLOAT
     status = H5LTread_dataset_float(file_id, "/elem", elem->v);
@@ -98,10 +285,10 @@ rock_upkd_save(rock_upkd_t *upkd, char *fname)
 {
     hid_t file_id;
     herr_t status;
-    hsize_t dims[] = {upkd->len};
 
     file_id = H5Fcreate (fname, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
-    status = H5LTmake_dataset(file_id, "/upkd", 1, dims, ROCK_UINT_H5T, upkd->v);
+    status = disk_make_dataset(file_id, "/upkd", upkd->len, ROCK_UINT_H5T, true,
+            upkd->v);
     if (status) {
         return ROCK_ERR;
     }
@@ -119,6 +306,7 @@ rock_upkd_load(rock_upkd_t *upkd, char *fname)
     hid_t file_id;
     herr_t status;
 
+    rock_filter_register();
     file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
 #ifdef ROCK_WORD_SIZE_64
     status = H5LTread_dataset_long(file_id, "/upkd", (long *)upkd->v);
@@ -141,10 +329,10 @@ rock_perm_save(rock_perm_t *perm, char *fname)
 {
     hid_t file_id;
     herr_t status;
-    hsize_t dims[] = {perm->len};
 
     file_id = H5Fcreate (fname, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
-    status = H5LTmake_dataset(file_id, "/perm", 1, dims, ROCK_UINT_H5T, perm->v);
+    status = disk_make_dataset(file_id, "/perm", perm->len, ROCK_UINT_H5T, true,
+            perm->v);
     if (status) {
         return ROCK_ERR;
     }
@@ -162,6 +350,7 @@ rock_perm_load(rock_perm_t *perm, char *fname)
     hid_t file_id;
     herr_t status;
 
+    rock_filter_register();
     file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
 #ifdef ROCK_WORD_SIZE_64
     status = H5LTread_dataset_long(file_id, "/perm", (long *)perm->v);
@@ -178,3 +367,706 @@ rock_perm_load(rock_perm_t *perm, char *fname)
 
     return ROCK_OK;
 }
+
+/*
+ * Whether partition offsets split an array of len elements, i.e., are
+ * increasing and end at len.
+ */
+static bool
+disk_part_valid(rock_part_t *part, rock_uint_t len)
+{
+    for (rock_uint_t k = 0; k < part->num_parts; k++) {
+        if (part->offset[k] > part->offset[k + 1]) {
+            return false;
+        }
+    }
+
+    return part->offset[part->num_parts] == len;
+}
+
+int
+rock_tensor_save(rock_tensor_t *tensor, rock_part_t *part, char *fname)
+{
+    hid_t file_id;
+    herr_t status = 0;
+    hsize_t dims[1];
+    int sorted_dim = (tensor->sorted_dim == ROCK_UINT_MAX) ?
+            -1 : (int) tensor->sorted_dim;
+
+    if (part && !disk_part_valid(part, tensor->indx->len)) {
+        return ROCK_BAD_INPUT;
+    }
+
+    file_id = H5Fcreate(fname, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+    if (file_id < 0) {
+        return ROCK_ERR;
+    }
+
+    dims[0] = tensor->desc->order;
+    status |= H5LTmake_dataset(file_id, "/dim_size", 1, dims, ROCK_UINT_H5T,
+            tensor->desc->dim_size);
+    status |= disk_make_dataset(file_id, "/indx", tensor->indx->len,
+            ROCK_UINT_H5T, true, tensor->indx->v);
+    status |= disk_make_dataset(file_id, "/elem", tensor->elem->len,
+            ROCK_ELEM_H5T, false, tensor->elem->v);
+    if (part) {
+        dims[0] = part->num_parts + 1;
+        status |= H5LTmake_dataset(file_id, "/part_offset", 1, dims,
+                ROCK_UINT_H5T, part->offset);
+    }
+    status |= H5LTset_attribute_int(file_id, "/", "sorted_dim",
+            &sorted_dim, 1);
+
+    status |= H5Fclose(file_id);
+    if (status) {
+        return ROCK_ERR;
+    }
+
+    return ROCK_OK;
+}
+
+/*
+ * The length of a one-dimensional dataset, 0 if missing.
+ */
+static hsize_t
+disk_dataset_len(hid_t file_id, const char *name)
+{
+    hsize_t dims[1] = {0};
+    int rank;
+
+    if (H5Lexists(file_id, name, H5P_DEFAULT) <= 0 ||
+            H5LTget_dataset_ndims(file_id, name, &rank) < 0 || rank != 1 ||
+            H5LTget_dataset_info(file_id, name, dims, NULL, NULL) < 0) {
+        return 0;
+    }
+
+    return dims[0];
+}
+
+/*
+ * The sorted dimension of a tensor from its saved attribute, -1 if
+ * unsorted.
+ */
+static rock_uint_t
+disk_sorted_dim(int sorted_dim)
+{
+    return (sorted_dim < 0) ? ROCK_UINT_MAX : (rock_uint_t) sorted_dim;
+}
+
+rock_tensor_t *
+rock_tensor_load(rock_part_t **part, char *fname)
+{
+    hid_t file_id;
+    herr_t status = 0;
+    int sorted_dim = -1;
+
+    if (part) {
+        *part = NULL;
+    }
+
+    rock_filter_register();
+    file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file_id < 0) {
+        return NULL;
+    }
+
+    /* Size everything from the file. */
+    rock_uint_t order = disk_dataset_len(file_id, "/dim_size");
+    rock_uint_t len = disk_dataset_len(file_id, "/indx");
+    rock_uint_t num_offsets = disk_dataset_len(file_id, "/part_offset");
+
+    if (order == 0 || order > ROCK_MAX_ORDER ||
+            disk_dataset_len(file_id, "/elem") != len) {
+        H5Fclose(file_id);
+        return NULL;
+    }
+
+    rock_uint_t dim_size[ROCK_MAX_ORDER];
+    status |= H5LTread_dataset(file_id, "/dim_size", ROCK_UINT_H5T, dim_size);
+    if (status) {
+        H5Fclose(file_id);
+        return NULL;
+    }
+
+    rock_tensor_t *tensor = rock_tensor_init(order, dim_size, len);
+
+    status |= H5LTread_dataset(file_id, "/indx", ROCK_UINT_H5T,
+            tensor->indx->v);
+    status |= H5LTread_dataset(file_id, "/elem", ROCK_ELEM_H5T,
+            tensor->elem->v);
+    status |= H5LTget_attribute_int(file_id, "/", "sorted_dim", &sorted_dim);
+
+    if (part && num_offsets > 0) {
+        *part = rock_part_init(num_offsets - 1);
+        status |= H5LTread_dataset(file_id, "/part_offset", ROCK_UINT_H5T,
+                (*part)->offset);
+    }
+
+    status |= H5Fclose(file_id);
+    if (part && *part && !disk_part_valid(*part, len)) {
+        status = -1;
+    }
+    if (status) {
+        rock_tensor_free(tensor);
+        if (part && *part) {
+            rock_part_free(*part);
+            *part = NULL;
+        }
+        return NULL;
+    }
+
+    tensor->sorted_dim = disk_sorted_dim(sorted_dim);
+
+    return tensor;
+}
+
+/*
+ * The state of a streaming reader. The back buffers are filled by a
+ * reader thread while the front buffers (of the iterator) are used.
+ * The thread sleeps until a block is requested (pending) and clears
+ * the request once read, both signaled through the condition.
+ */
+typedef struct disk_iter_state_s
+{
+    hid_t indx_file_id;
+    hid_t elem_file_id;
+    hid_t indx_dset_id;
+    hid_t elem_dset_id;
+
+    rock_indx_t *indx;
+    rock_elem_t *elem;
+    rock_uint_t offset;
+    int status;
+
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+    bool started;
+    bool pending;
+    bool quit;
+
+} disk_iter_state_t;
+
+/*
+ * Read a block of a one-dimensional dataset.
+ */
+static herr_t
+disk_read_block(hid_t dset_id,
+                hid_t type,
+                rock_uint_t offset,
+                rock_uint_t len,
+                void *buf)
+{
+    hsize_t start[] = {offset};
+    hsize_t count[] = {len};
+    hid_t space_id = H5Dget_space(dset_id);
+    hid_t mem_id = H5Screate_simple(1, count, NULL);
+
+    herr_t status = H5Sselect_hyperslab(space_id, H5S_SELECT_SET, start, NULL,
+            count, NULL);
+    status |= H5Dread(dset_id, type, mem_id, space_id, H5P_DEFAULT, buf);
+
+    H5Sclose(mem_id);
+    H5Sclose(space_id);
+
+    return status;
+}
+
+/*
+ * Fill the back buffers with the block at the offset of the state.
+ */
+static void *
+disk_iter_read(void *arg)
+{
+    disk_iter_state_t *state = arg;
+    rock_uint_t len = state->indx->len;
+    herr_t status = 0;
+
+    if (len > 0) {
+        status |= disk_read_block(state->indx_dset_id, ROCK_UINT_H5T,
+                state->offset, len, state->indx->v);
+        if (state->elem) {
+            status |= disk_read_block(state->elem_dset_id, ROCK_ELEM_H5T,
+                    state->offset, len, state->elem->v);
+        }
+    }
+
+    state->status = status ? ROCK_ERR : ROCK_OK;
+
+    return NULL;
+}
+
+#ifdef H5_HAVE_THREADSAFE
+/*
+ * Read the requested blocks until told to quit.
+ */
+static void *
+disk_iter_worker(void *arg)
+{
+    disk_iter_state_t *state = arg;
+
+    pthread_mutex_lock(&state->lock);
+    while (true) {
+        while (!state->pending && !state->quit) {
+            pthread_cond_wait(&state->cond, &state->lock);
+        }
+        if (state->quit) {
+            break;
+        }
+
+        pthread_mutex_unlock(&state->lock);
+        disk_iter_read(state);
+        pthread_mutex_lock(&state->lock);
+
+        state->pending = false;
+        pthread_cond_broadcast(&state->cond);
+    }
+    pthread_mutex_unlock(&state->lock);
+
+    return NULL;
+}
+#endif
+
+/*
+ * Request the block following the current one, read in the background
+ * by the worker if running, otherwise by disk_iter_wait.
+ */
+static void
+disk_iter_prefetch(rock_iter_t *iter, rock_uint_t offset)
+{
+    disk_iter_state_t *state = iter->state;
+    rock_uint_t len = (offset < iter->len) ? iter->len - offset : 0;
+
+    len = (len < iter->block_len) ? len : iter->block_len;
+    state->offset = offset;
+    state->indx->len = len;
+    if (state->elem) {
+        state->elem->len = len;
+    }
+
+    pthread_mutex_lock(&state->lock);
+    state->pending = true;
+    pthread_cond_broadcast(&state->cond);
+    pthread_mutex_unlock(&state->lock);
+}
+
+/*
+ * Wait for the requested block.
+ */
+static void
+disk_iter_wait(rock_iter_t *iter)
+{
+    disk_iter_state_t *state = iter->state;
+
+    if (!state->started) {
+        if (state->pending) {
+            disk_iter_read(state);
+            state->pending = false;
+        }
+        return;
+    }
+
+    pthread_mutex_lock(&state->lock);
+    while (state->pending) {
+        pthread_cond_wait(&state->cond, &state->lock);
+    }
+    pthread_mutex_unlock(&state->lock);
+}
+
+rock_iter_t *
+rock_iter_init(char *indx_fname, char *elem_fname, rock_uint_t block_len)
+{
+    if (block_len == 0) {
+        return NULL;
+    }
+
+    rock_filter_register();
+
+    disk_iter_state_t *state = calloc(1, sizeof(disk_iter_state_t));
+    pthread_mutex_init(&state->lock, NULL);
+    pthread_cond_init(&state->cond, NULL);
+    state->indx_file_id = H5Fopen(indx_fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+    state->elem_file_id = -1;
+    state->indx_dset_id = -1;
+    state->elem_dset_id = -1;
+
+    hsize_t len = 0;
+    bool valid = state->indx_file_id >= 0;
+
+    if (valid) {
+        state->indx_dset_id = H5Dopen2(state->indx_file_id, "/indx",
+                H5P_DEFAULT);
+        len = disk_dataset_len(state->indx_file_id, "/indx");
+        valid = state->indx_dset_id >= 0;
+    }
+
+    if (valid && elem_fname) {
+        state->elem_file_id = H5Fopen(elem_fname, H5F_ACC_RDONLY,
+                H5P_DEFAULT);
+        valid = state->elem_file_id >= 0;
+        if (valid) {
+            state->elem_dset_id = H5Dopen2(state->elem_file_id, "/elem",
+                    H5P_DEFAULT);
+            valid = state->elem_dset_id >= 0 &&
+                    disk_dataset_len(state->elem_file_id, "/elem") == len;
+        }
+    }
+
+    rock_iter_t *iter = calloc(1, sizeof(rock_iter_t));
+    iter->state = state;
+
+    if (!valid) {
+        rock_iter_free(iter);
+        return NULL;
+    }
+
+    iter->len = len;
+    iter->block_len = block_len;
+    iter->offset = 0;
+    iter->status = ROCK_OK;
+
+    /* Front and back buffers. */
+    iter->indx = rock_indx_init(block_len);
+    state->indx = rock_indx_init(block_len);
+    if (elem_fname) {
+        iter->elem = rock_elem_init(block_len);
+        state->elem = rock_elem_init(block_len);
+    }
+    iter->indx->len = 0;
+
+    /* One reader for all blocks, read on demand if none can be started. */
+#ifdef H5_HAVE_THREADSAFE
+    state->started = pthread_create(&state->thread, NULL, disk_iter_worker,
+            state) == 0;
+#endif
+
+    disk_iter_prefetch(iter, 0);
+
+    return iter;
+}
+
+bool
+rock_iter_next(rock_iter_t *iter)
+{
+    disk_iter_state_t *state = iter->state;
+
+    disk_iter_wait(iter);
+
+    if (state->status != ROCK_OK) {
+        iter->status = ROCK_ERR;
+    }
+    if (state->indx->len == 0 || iter->status != ROCK_OK) {
+        iter->indx->len = 0;
+        if (iter->elem) {
+            iter->elem->len = 0;
+        }
+        return false;
+    }
+
+    /* Swap buffers and read the block after. */
+    rock_indx_t *indx = iter->indx;
+    iter->indx = state->indx;
+    state->indx = indx;
+
+    rock_elem_t *elem = iter->elem;
+    iter->elem = state->elem;
+    state->elem = elem;
+
+    iter->offset = state->offset;
+    disk_iter_prefetch(iter, iter->offset + iter->indx->len);
+
+    return true;
+}
+
+void
+rock_iter_free(rock_iter_t *iter)
+{
+    disk_iter_state_t *state = iter->state;
+
+    if (state->started) {
+        pthread_mutex_lock(&state->lock);
+        state->pending = false;
+        state->quit = true;
+        pthread_cond_broadcast(&state->cond);
+        pthread_mutex_unlock(&state->lock);
+        pthread_join(state->thread, NULL);
+    }
+    pthread_mutex_destroy(&state->lock);
+    pthread_cond_destroy(&state->cond);
+
+    if (state->indx_dset_id >= 0) {
+        H5Dclose(state->indx_dset_id);
+    }
+    if (state->elem_dset_id >= 0) {
+        H5Dclose(state->elem_dset_id);
+    }
+    if (state->indx_file_id >= 0) {
+        H5Fclose(state->indx_file_id);
+    }
+    if (state->elem_file_id >= 0) {
+        H5Fclose(state->elem_file_id);
+    }
+
+    if (state->indx) {
+        rock_indx_free(state->indx);
+        rock_indx_free(iter->indx);
+    }
+    if (state->elem) {
+        rock_elem_free(state->elem);
+        rock_elem_free(iter->elem);
+    }
+
+    free(state);
+    free(iter);
+}
+
+/*
+ * Read a range of a one-dimensional dataset of a file.
+ */
+static int
+disk_load_range(char *fname,
+                const char *name,
+                hid_t type,
+                rock_uint_t offset,
+                rock_uint_t len,
+                void *buf)
+{
+    rock_filter_register();
+
+    hid_t file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file_id < 0) {
+        return ROCK_ERR;
+    }
+
+    int status = ROCK_OK;
+    hsize_t total = disk_dataset_len(file_id, name);
+
+    if (offset > total || len > total - offset) {
+        status = ROCK_BAD_INPUT;
+    } else if (len > 0) {
+        hid_t dset_id = H5Dopen2(file_id, name, H5P_DEFAULT);
+
+        if (dset_id < 0 ||
+                disk_read_block(dset_id, type, offset, len, buf) < 0) {
+            status = ROCK_ERR;
+        }
+        if (dset_id >= 0) {
+            H5Dclose(dset_id);
+        }
+    }
+
+    if (H5Fclose(file_id) < 0) {
+        status = ROCK_ERR;
+    }
+
+    return status;
+}
+
+int
+rock_indx_load_range(rock_indx_t *indx, char *fname, rock_uint_t offset)
+{
+    return disk_load_range(fname, "/indx", ROCK_UINT_H5T, offset, indx->len,
+            indx->v);
+}
+
+int
+rock_elem_load_range(rock_elem_t *elem, char *fname, rock_uint_t offset)
+{
+    return disk_load_range(fname, "/elem", ROCK_ELEM_H5T, offset, elem->len,
+            elem->v);
+}
+
+rock_tensor_t *
+rock_tensor_load_part(char *fname, rock_uint_t k)
+{
+    hid_t file_id;
+    herr_t status = 0;
+    int sorted_dim = -1;
+
+    rock_filter_register();
+
+    file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file_id < 0) {
+        return NULL;
+    }
+
+    /* The descriptor and the partition are small, read them whole. */
+    rock_uint_t order = disk_dataset_len(file_id, "/dim_size");
+    rock_uint_t len = disk_dataset_len(file_id, "/indx");
+    rock_uint_t num_offsets = disk_dataset_len(file_id, "/part_offset");
+    rock_uint_t dim_size[ROCK_MAX_ORDER];
+    rock_part_t *part = NULL;
+
+    if (order == 0 || order > ROCK_MAX_ORDER ||
+            num_offsets == 0 || k >= num_offsets - 1 ||
+            disk_dataset_len(file_id, "/elem") != len) {
+        status = -1;
+    } else {
+        part = rock_part_init(num_offsets - 1);
+        status |= H5LTread_dataset(file_id, "/dim_size", ROCK_UINT_H5T,
+                dim_size);
+        status |= H5LTread_dataset(file_id, "/part_offset", ROCK_UINT_H5T,
+                part->offset);
+        status |= H5LTget_attribute_int(file_id, "/", "sorted_dim",
+                &sorted_dim);
+    }
+
+    status |= H5Fclose(file_id);
+
+    /* The offsets must split the elements (see rock_tensor_save). */
+    if (status || !disk_part_valid(part, len)) {
+        if (part) {
+            rock_part_free(part);
+        }
+        return NULL;
+    }
+
+    rock_uint_t offset = part->offset[k];
+    rock_tensor_t *tensor = rock_tensor_init(order, dim_size,
+            part->offset[k + 1] - offset);
+    rock_part_free(part);
+
+    if (rock_indx_load_range(tensor->indx, fname, offset) != ROCK_OK ||
+            rock_elem_load_range(tensor->elem, fname, offset) != ROCK_OK) {
+        rock_tensor_free(tensor);
+        return NULL;
+    }
+
+    tensor->sorted_dim = disk_sorted_dim(sorted_dim);
+
+    return tensor;
+}
+
+/*
+ * Round up to the alignment of native arrays.
+ */
+static uint64_t
+disk_native_align(uint64_t offset)
+{
+    return (offset + ROCK_NATIVE_ALIGN - 1) / ROCK_NATIVE_ALIGN *
+            ROCK_NATIVE_ALIGN;
+}
+
+int
+rock_tensor_save_native(rock_tensor_t *tensor, char *fname)
+{
+    disk_native_header_t header;
+    rock_uint_t len = tensor->indx->len;
+    size_t elem_size = ROCK_ELEM_SIZE;
+
+    if (tensor->elem->len != len) {
+        return ROCK_ERR;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, NATIVE_MAGIC, sizeof(NATIVE_MAGIC));
+    header.version = NATIVE_VERSION;
+    header.word_size = sizeof(rock_uint_t);
+    header.elem_size = elem_size;
+    header.order = tensor->desc->order;
+    header.len = len;
+    header.sorted_dim = (tensor->sorted_dim == ROCK_UINT_MAX) ?
+            UINT64_MAX : tensor->sorted_dim;
+    for (rock_uint_t i = 0; i < tensor->desc->order; i++) {
+        header.dim_size[i] = tensor->desc->dim_size[i];
+    }
+    header.indx_offset = disk_native_align(sizeof(header));
+    header.elem_offset = disk_native_align(header.indx_offset +
+            len * sizeof(rock_uint_t));
+
+    FILE *file = fopen(fname, "wb");
+    if (file == NULL) {
+        return ROCK_ERR;
+    }
+
+    /* Pad with zeros up to the aligned arrays. */
+    int status = ROCK_OK;
+    status |= fwrite(&header, sizeof(header), 1, file) != 1;
+    status |= fseek(file, header.indx_offset, SEEK_SET) != 0;
+    status |= fwrite(tensor->indx->v, sizeof(rock_uint_t), len, file) != len;
+    status |= fseek(file, header.elem_offset, SEEK_SET) != 0;
+    status |= fwrite(tensor->elem->v, elem_size, len, file) != len;
+    status |= fclose(file) != 0;
+
+    return status ? ROCK_ERR : ROCK_OK;
+}
+
+rock_tensor_t *
+rock_tensor_mmap(char *fname)
+{
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        return NULL;
+    }
+
+    struct stat st;
+    disk_native_header_t *header = MAP_FAILED;
+    size_t map_len = 0;
+
+    if (fstat(fd, &st) == 0 && st.st_size >= (off_t) sizeof(*header)) {
+        map_len = st.st_size;
+        header = mmap(NULL, map_len, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                fd, 0);
+    }
+
+    /* The mapping outlives the descriptor. */
+    close(fd);
+
+    if (header == MAP_FAILED) {
+        return NULL;
+    }
+
+    size_t elem_size = ROCK_ELEM_SIZE;
+    bool valid = memcmp(header->magic, NATIVE_MAGIC,
+            sizeof(NATIVE_MAGIC)) == 0 &&
+            header->version == NATIVE_VERSION &&
+            header->word_size == sizeof(rock_uint_t) &&
+            header->elem_size == elem_size &&
+            header->order > 0 && header->order <= ROCK_MAX_ORDER &&
+            header->len <= ROCK_UINT_MAX &&
+            (header->sorted_dim < header->order ||
+            header->sorted_dim == UINT64_MAX) &&
+            header->indx_offset % ROCK_NATIVE_ALIGN == 0 &&
+            header->elem_offset % ROCK_NATIVE_ALIGN == 0;
+
+    /* Both arrays within the mapping, without overflowing. */
+    if (valid && header->len > 0) {
+        valid = header->indx_offset <= map_len &&
+                header->elem_offset <= map_len &&
+                header->len <= (map_len - header->indx_offset) /
+                    sizeof(rock_uint_t) &&
+                header->len <= (map_len - header->elem_offset) / elem_size;
+    }
+
+    for (rock_uint_t i = 0; valid && i < header->order; i++) {
+        valid = header->dim_size[i] > 0 &&
+                header->dim_size[i] <= ROCK_UINT_MAX;
+    }
+
+    if (!valid) {
+        munmap(header, map_len);
+        return NULL;
+    }
+
+    rock_uint_t dim_size[ROCK_MAX_ORDER];
+    for (rock_uint_t i = 0; i < header->order; i++) {
+        dim_size[i] = header->dim_size[i];
+    }
+
+    rock_tensor_t *tensor = calloc(1, sizeof(rock_tensor_t));
+    tensor->desc = rock_desc_init(header->order, dim_size);
+    tensor->indx = calloc(1, sizeof(rock_indx_t));
+    tensor->elem = calloc(1, sizeof(rock_elem_t));
+
+    tensor->indx->len = header->len;
+    tensor->indx->v = (void *) ((char *) header + header->indx_offset);
+    tensor->elem->len = header->len;
+    tensor->elem->v = (void *) ((char *) header + header->elem_offset);
+
+    tensor->sorted_dim = (header->sorted_dim == UINT64_MAX) ?
+            ROCK_UINT_MAX : header->sorted_dim;
+    tensor->map = header;
+    tensor->map_len = map_len;
+
+    return tensor;
+}
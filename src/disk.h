@@ -7,6 +7,56 @@
 #define _DISK_H
 
 #include "core.h"
+#include "tensor.h"
+
+/**
+ * @name Storage of saved arrays
+ *
+ * Arrays are saved contiguously and uncompressed by default. Setting
+ * @c rock_save_mode before saving stores them in chunks of
+ * @c rock_save_chunk_len elements instead, either
+ *
+ *   - shuffled and deflated (@c ROCK_SAVE_DEFLATE, level
+ *     @c rock_save_level), or
+ *   - delta-encoded and bit-packed (@c ROCK_SAVE_BITPACK), which suits
+ *     sorted packed indices, see codec.h. Element arrays are shuffled
+ *     and deflated.
+ *
+ * Loading handles all of them transparently. Reading bit-packed files
+ * outside of the library requires registering the filter
+ * (@c ROCK_H5Z_FILTER_BITPACK) using @c rock_filter_register.
+ * @{
+ */
+#define ROCK_SAVE_PLAIN 0
+#define ROCK_SAVE_DEFLATE 1
+#define ROCK_SAVE_BITPACK 2
+/** @} */
+
+/** The HDF5 filter id of delta bit-packing (in the range for testing). */
+#define ROCK_H5Z_FILTER_BITPACK 311
+
+/** The alignment in bytes of the arrays of native files (a page). */
+#define ROCK_NATIVE_ALIGN 4096
+
+/** How to store saved arrays (@c ROCK_USE_DEFAULT for plain). */
+extern int rock_save_mode;
+
+/** The number of elements of each chunk of saved arrays. */
+extern int rock_save_chunk_len;
+
+/** The deflate level (1-9) of saved arrays. */
+extern int rock_save_level;
+
+/**
+ * Register the HDF5 filter used by @c ROCK_SAVE_BITPACK.
+ *
+ * Called by the library when saving and loading, does nothing if
+ * already registered.
+ *
+ * @return                  ROCK_OK or ROCK_ERR.
+ */
+int
+rock_filter_register();
 
 /**
  * Save an array of packed multi-indices to disk.
@@ -48,6 +98,36 @@ rock_elem_save(rock_elem_t *elem, char *fname);
 int
 rock_elem_load(rock_elem_t *elem, char *fname);
 
+/**
+ * Load a range of an array of previously saved packed multi-indices.
+ *
+ * Only the range is read (using a hyperslab selection).
+ *
+ * @param [out] indx        An already initialized index object, its
+ *                          length is the length of the range.
+ * @param [in] fname
+ * @param [in] offset       The position of the range in the saved array.
+ * @return                  ROCK_OK, ROCK_BAD_INPUT if the range exceeds
+ *                          the saved array, or ROCK_ERR.
+ */
+int
+rock_indx_load_range(rock_indx_t *indx, char *fname, rock_uint_t offset);
+
+/**
+ * Load a range of an array of previously saved data elements.
+ *
+ * Only the range is read (using a hyperslab selection).
+ *
+ * @param [out] elem        An already initialized elem object, its
+ *                          length is the length of the range.
+ * @param [in] fname
+ * @param [in] offset       The position of the range in the saved array.
+ * @return                  ROCK_OK, ROCK_BAD_INPUT if the range exceeds
+ *                          the saved array, or ROCK_ERR.
+ */
+int
+rock_elem_load_range(rock_elem_t *elem, char *fname, rock_uint_t offset);
+
 /**
  * Save an array of unpacked unsigned integers.
  *
@@ -88,4 +168,196 @@ rock_perm_save(rock_perm_t *perm, char *fname);
 int
 rock_perm_load(rock_perm_t *perm, char *fname);
 
+/**
+ * Save a tensor to a single file.
+ *
+ * Besides the index and element arrays, the file holds the dimension
+ * sizes, the dimension the tensor is sorted by (if any) and optionally
+ * a partition of the non-zero elements:
+ *
+ *     /dim_size            The dimension sizes (the order is its length).
+ *     /indx, /elem         The index and element arrays.
+ *     /part_offset         The partition offsets (optional).
+ *     sorted_dim           The sorted dimension, -1 if unsorted
+ *                          (attribute of the root group).
+ *
+ * The partition offsets are positions in the (sorted) index and
+ * element arrays, not indices of a dimension: part @c k holds the
+ * elements @c offset[k] to @c offset[k+1]-1, and the last offset is the
+ * number of elements.
+ *
+ * @param [in] tensor
+ * @param [in] part         A partition of the elements or NULL.
+ * @param [in] fname
+ * @return                  ROCK_OK, ROCK_BAD_INPUT if the partition
+ *                          offsets aren't increasing or don't end at the
+ *                          number of elements, or ROCK_ERR.
+ */
+int
+rock_tensor_save(rock_tensor_t *tensor, rock_part_t *part, char *fname);
+
+/**
+ * Load a tensor previously saved by @c rock_tensor_save.
+ *
+ * All objects are sized from the file, and the tensor keeps the sort
+ * state it was saved with (no need to sort it again).
+ *
+ * - All: buffers and objects allocated
+ *
+ * @param [out] part        The saved partition, NULL if there is none.
+ *                          Pass NULL to skip it.
+ * @param [in] fname
+ * @return                  Initialized and populated tensor object or
+ *                          NULL on failure (including a saved partition
+ *                          not matching the elements).
+ */
+rock_tensor_t *
+rock_tensor_load(rock_part_t **part, char *fname);
+
+/**
+ * Load one part of a tensor previously saved by @c rock_tensor_save
+ * together with a partition.
+ *
+ * Only the non-zero elements from @c offset[k] to @c offset[k+1]-1 of
+ * the saved partition are read, e.g., by the worker processing part
+ * @c k.
+ *
+ * - All: buffers and objects allocated
+ *
+ * @param [in] fname
+ * @param [in] k            The part to load.
+ * @return                  Initialized and populated tensor object
+ *                          holding the part, or NULL if the file has no
+ *                          partition, @c k is out of range, or on
+ *                          failure.
+ */
+rock_tensor_t *
+rock_tensor_load_part(char *fname, rock_uint_t k);
+
+/**
+ * Save a tensor using the native binary format.
+ *
+ * The format is the memory layout of the tensor (native byte order and
+ * word size), such that it can be memory mapped by
+ * @c rock_tensor_mmap:
+ *
+ *     offset 0             Header: magic "ROCKTNS", version, word and
+ *                          element sizes, order, number of non-zero
+ *                          elements, sorted dimension, dimension sizes,
+ *                          and the offsets of the arrays.
+ *     indx_offset          The index array.
+ *     elem_offset          The element array.
+ *
+ * Both arrays start at multiples of @c ROCK_NATIVE_ALIGN bytes.
+ *
+ * @param [in] tensor
+ * @param [in] fname
+ * @return                  ROCK_OK or ROCK_ERR.
+ */
+int
+rock_tensor_save_native(rock_tensor_t *tensor, char *fname);
+
+/**
+ * Memory map a tensor saved by @c rock_tensor_save_native.
+ *
+ * Nothing is read up front, the index and element arrays point
+ * straight into the mapping and pages are read on first access. The
+ * page cache is shared by all processes mapping the file. The mapping
+ * is private, i.e., modifying the arrays (e.g., sorting) copies the
+ * modified pages and leaves the file untouched.
+ *
+ * The arrays may be modified in place (e.g., sorted, or grouped by
+ * @c rock_dist_init), but aren't allocated: call @c rock_tensor_detach
+ * before handing them to routines freeing or reallocating buffers,
+ * e.g., the scatter functions, @c rock_redistribute,
+ * @c rock_dist_append or @c rock_mpart_rebalance.
+ *
+ * Free the tensor with @c rock_tensor_free as usual to unmap it.
+ *
+ * @param [in] fname
+ * @return                  Tensor object, or NULL if the file can't be
+ *                          mapped, was saved using another word or
+ *                          element size, or its header is corrupt.
+ */
+rock_tensor_t *
+rock_tensor_mmap(char *fname);
+
+/**
+ * Streaming reader object.
+ *
+ * Iterates over the index and element arrays of saved files in blocks
+ * of a fixed length, such that tensors larger than memory can be
+ * processed (e.g., counted or filtered) a block at a time. The next
+ * block is read in the background while the current one is processed
+ * (double buffering) by a reader thread. As HDF5 may only be called
+ * from several threads if built thread-safe, blocks are otherwise read
+ * on demand by @c rock_iter_next.
+ */
+typedef struct rock_iter_s
+{
+    /** The total number of items of the files. */
+    rock_uint_t len;
+
+    /** The (maximum) number of items of each block. */
+    rock_uint_t block_len;
+
+    /** The position of the current block in the files. */
+    rock_uint_t offset;
+
+    /** The indices of the current block. */
+    rock_indx_t *indx;
+
+    /** The elements of the current block (NULL if not read). */
+    rock_elem_t *elem;
+
+    /** ROCK_OK, or ROCK_ERR if reading any block failed. */
+    int status;
+
+    /** The state of the reader (private). */
+    void *state;
+
+} rock_iter_t;
+
+/**
+ * Initialize a streaming reader object.
+ *
+ * Reads /indx and /elem as saved by, e.g., @c rock_indx_save and
+ * @c rock_elem_save, or @c rock_tensor_save (pass the same file
+ * twice). Reading the first block starts immediately.
+ *
+ * @param [in] indx_fname   The file holding the indices.
+ * @param [in] elem_fname   The file holding the elements, or NULL to
+ *                          only read indices.
+ * @param [in] block_len    The number of items of each block.
+ * @return                  Initialized reader object, or NULL if the
+ *                          files can't be opened or don't match.
+ */
+rock_iter_t *
+rock_iter_init(char *indx_fname, char *elem_fname, rock_uint_t block_len);
+
+/**
+ * Advance a streaming reader to the next block.
+ *
+ * The arrays of the previous block are reused, copy them to keep them.
+ *
+ *     while (rock_iter_next(iter)) {
+ *         ... iter->indx, iter->elem ...
+ *     }
+ *
+ * @param [in] iter
+ * @return                  true if a block is available, false at the
+ *                          end of the files or on failure (see
+ *                          @c status).
+ */
+bool
+rock_iter_next(rock_iter_t *iter);
+
+/**
+ * Free a streaming reader object, closing its files.
+ *
+ * @param [in] iter
+ */
+void
+rock_iter_free(rock_iter_t *iter);
+
 #endif
@@ -3,28 +3,181 @@
  * @author timoteus <mail@timoteus.se>
  */
 
+/* Needed for sched_getaffinity, sched_setaffinity and CPU_SET. */
+#ifdef __linux__
+    #define _GNU_SOURCE
+    #include <sched.h>
+#endif
+#include <unistd.h>
+
 #include "distribute.h"
+#include "codec.h"
+#include "profile.h"
+#include "random.h"
 #include "sort.h"
 
+#define ROCK_TAG_INDX 1
+#define ROCK_TAG_ELEM 2
+#define ROCK_TAG_TENSOR 3
+
+/* The size of an item (index and element) of a tensor. */
+#define DIST_ITEM_SIZE (sizeof(rock_uint_t) + ROCK_ELEM_SIZE)
+
+/* Use default value if not manually overridden. */
+int rock_chunk_len = ROCK_USE_DEFAULT;
+
+/*
+ * The number of items per message of chunked transfers, the default
+ * unless a positive length was set.
+ */
+static rock_uint_t
+dist_chunk_len()
+{
+    return (rock_chunk_len > 0) ?
+            (rock_uint_t) rock_chunk_len : ROCK_DEFAULT_CHUNK_LEN;
+}
+
+/*
+ * The cores the processor may run on, e.g., as restricted by a cpuset,
+ * a cgroup or the launcher, otherwise all online cores.
+ */
+static rock_uint_t *
+dist_cores(rock_uint_t *num_cores)
+{
+    rock_uint_t *cores;
+
+#ifdef __linux__
+    cpu_set_t set;
+
+    if (sched_getaffinity(0, sizeof(set), &set) == 0 && CPU_COUNT(&set) > 0) {
+        cores = malloc(CPU_COUNT(&set) * sizeof(rock_uint_t));
+        *num_cores = 0;
+        for (int c = 0; c < CPU_SETSIZE; c++) {
+            if (CPU_ISSET(c, &set)) {
+                cores[(*num_cores)++] = c;
+            }
+        }
+        return cores;
+    }
+#endif
+
+    long num_online = sysconf(_SC_NPROCESSORS_ONLN);
+    *num_cores = (num_online > 0) ? num_online : 1;
+    cores = malloc(*num_cores * sizeof(rock_uint_t));
+    for (rock_uint_t c = 0; c < *num_cores; c++) {
+        cores[c] = c;
+    }
+
+    return cores;
+}
+
 rock_mesh_t *
 rock_mesh_init(MPI_Comm comm,
                rock_uint_t order,
                rock_uint_t *dim_size)
 {
-    rock_mesh_t *mesh = calloc(1, sizeof(rock_mesh_t));
+    int np;
+    MPI_Comm_size(comm, &np);
+
+    rock_uint_t total_size = 1;
+    for (rock_uint_t i = 0; i < order; i++) {
+        total_size *= dim_size[i];
+    }
+    if (order == 0 || order > ROCK_MAX_MESH_ORDER ||
+            total_size != (rock_uint_t) np) {
+        return NULL;
+    }
 
-    MPI_Comm_size(comm, &mesh->np);
-    MPI_Comm_rank(comm, &mesh->rank);
+    rock_mesh_t *mesh = calloc(1, sizeof(rock_mesh_t));
 
-    mesh->comm = comm;
+    mesh->np = np;
     mesh->order = order;
     for (rock_uint_t i = 0; i < order; i++) {
         mesh->dim_size[i] = dim_size[i];
     }
 
+    /*
+     * MPI numbers ranks with the last dimension varying fastest, pass
+     * dimensions in reverse to have dimension 0 vary fastest.
+     */
+    int dims[ROCK_MAX_MESH_ORDER];
+    int periods[ROCK_MAX_MESH_ORDER];
+    int coords[ROCK_MAX_MESH_ORDER];
+    int remain[ROCK_MAX_MESH_ORDER];
+
+    for (rock_uint_t i = 0; i < order; i++) {
+        dims[i] = dim_size[order-1-i];
+        periods[i] = 0;
+    }
+
+    MPI_Cart_create(comm, order, dims, periods, 1, &mesh->comm);
+    MPI_Comm_rank(mesh->comm, &mesh->rank);
+    MPI_Cart_coords(mesh->comm, mesh->rank, order, coords);
+
+    for (rock_uint_t i = 0; i < order; i++) {
+        rock_uint_t dim = order-1-i;
+
+        mesh->coord[i] = coords[dim];
+
+        /* Fiber: vary only dimension i. */
+        for (rock_uint_t k = 0; k < order; k++) {
+            remain[k] = (k == dim);
+        }
+        MPI_Cart_sub(mesh->comm, remain, &mesh->dim_comm[i]);
+
+        /* Slice: vary all but dimension i. */
+        for (rock_uint_t k = 0; k < order; k++) {
+            remain[k] = (k != dim);
+        }
+        MPI_Cart_sub(mesh->comm, remain, &mesh->slice_comm[i]);
+    }
+
+    /* Share the cores of the node evenly among its processors. */
+    int node_rank, node_size;
+    MPI_Comm_split_type(mesh->comm, MPI_COMM_TYPE_SHARED, mesh->rank,
+            MPI_INFO_NULL, &mesh->node_comm);
+    MPI_Comm_rank(mesh->node_comm, &node_rank);
+    MPI_Comm_size(mesh->node_comm, &node_size);
+
+    rock_uint_t num_cores;
+    rock_uint_t *cores = dist_cores(&num_cores);
+
+    mesh->node_rank = node_rank;
+    mesh->node_size = node_size;
+    mesh->num_threads = (num_cores > (rock_uint_t) node_size) ?
+            num_cores / node_size : 1;
+    mesh->cores = malloc(mesh->num_threads * sizeof(rock_uint_t));
+
+    rock_uint_t first = (node_rank * mesh->num_threads) % num_cores;
+    for (rock_uint_t i = 0; i < mesh->num_threads; i++) {
+        mesh->cores[i] = cores[(first + i) % num_cores];
+    }
+    free(cores);
+
     return mesh;
 }
 
+int
+rock_mesh_bind(rock_mesh_t *mesh)
+{
+#ifdef __linux__
+    cpu_set_t set;
+    CPU_ZERO(&set);
+
+    for (rock_uint_t i = 0; i < mesh->num_threads; i++) {
+        CPU_SET(mesh->cores[i], &set);
+    }
+
+    if (sched_setaffinity(0, sizeof(set), &set) != 0) {
+        return ROCK_ERR;
+    }
+
+    return ROCK_OK;
+#else
+    return ROCK_ERR;
+#endif
+}
+
 rock_mpart_t *
 rock_mpart_init(rock_uint_t order, rock_uint_t *dim_num_parts)
 {
@@ -40,61 +193,395 @@ rock_mpart_init(rock_uint_t order, rock_uint_t *dim_num_parts)
     return mpart;
 }
 
+/*
+ * Calculate offsets and sum of a distribution object from its counts.
+ */
+static void
+dist_update_offset(rock_dist_t *dist)
+{
+    for (rock_uint_t i = 1; i <= dist->mesh->np; i++) {
+        dist->offset[i] = dist->offset[i-1] + dist->count[i-1];
+    }
+
+    dist->sum = dist->offset[dist->mesh->np];
+}
+
+/*
+ * The number of bytes and messages a processor moves in a collective
+ * between the master and all other processors, see profile.h.
+ */
+static void
+dist_root_traffic(rock_dist_t *dist,
+                  size_t item_size,
+                  uint64_t *bytes,
+                  uint64_t *msgs)
+{
+    rock_mesh_t *mesh = dist->mesh;
+
+    if (mesh->rank == ROCK_MASTER) {
+        *bytes = (uint64_t) (dist->sum - dist->count[ROCK_MASTER]) * item_size;
+        *msgs = mesh->np - 1;
+    } else {
+        *bytes = (uint64_t) dist->count[mesh->rank] * item_size;
+        *msgs = 1;
+    }
+}
+
+/*
+ * Group an index and element array by owning processor using a parallel
+ * counting sort.
+ *
+ * Each thread counts the owners of its chunk, a prefix sum over all
+ * (processor, thread) pairs gives each thread a private write position
+ * per processor, and a second pass moves the chunk into place. The
+ * grouping is stable and requires neither a processor index array nor
+ * a permutation. The owner of each item is added to @c count.
+ *
+ * The grouped arrays are swapped into @c indx and @c elem, unless
+ * @c in_place, where they are copied back such that the arrays stay
+ * where the caller put them (e.g., a memory mapping).
+ */
+static void
+dist_bucket(rock_indx_t *indx,
+            rock_elem_t *elem,
+            rock_mpart_t *mpart,
+            rock_uint_t np,
+            rock_uint_t *count,
+            bool in_place)
+{
+    int max_threads = rock_thread_count(indx->len);
+
+    rock_indx_t *indx_out = rock_indx_init(indx->len);
+    rock_elem_t *elem_out = rock_elem_init(elem->len);
+    rock_uint_t *bins = calloc(max_threads * np, sizeof(rock_uint_t));
+
+    #pragma omp parallel num_threads(max_threads)
+    {
+        int id = omp_get_thread_num();
+        int num_threads = omp_get_num_threads();
+
+        rock_uint_t chunk = indx->len / num_threads;
+        rock_uint_t begin = id * chunk;
+        rock_uint_t end = (id == num_threads - 1) ? indx->len : begin + chunk;
+        rock_uint_t *bin = &bins[id * np];
+
+        /* Phase 1: Histogram of owners. */
+        for (rock_uint_t i = begin; i < end; i++) {
+            bin[rock_part_num_from_mpart(mpart, indx, i)]++;
+        }
+
+        #pragma omp barrier
+
+        #pragma omp master
+        {
+            /* Phase 2: Prefix sum, processor major and thread minor. */
+            rock_uint_t total = 0;
+            for (rock_uint_t p = 0; p < np; p++) {
+                for (int k = 0; k < num_threads; k++) {
+                    rock_uint_t old = bins[(k*np) + p];
+                    bins[(k*np) + p] = total;
+                    total += old;
+                    count[p] += old;
+                }
+            }
+        }
+
+        #pragma omp barrier
+
+        /* Phase 3: Movement. */
+        for (rock_uint_t i = begin; i < end; i++) {
+            rock_uint_t pos = bin[rock_part_num_from_mpart(mpart, indx, i)]++;
+            indx_out->v[pos] = indx->v[i];
+            elem_out->v[pos] = elem->v[i];
+        }
+    }
+
+    if (in_place) {
+        memcpy(indx->v, indx_out->v, indx->len * sizeof(*indx->v));
+        memcpy(elem->v, elem_out->v, elem->len * sizeof(*elem->v));
+    } else {
+        /* Hand the grouped buffers over to the caller's objects. */
+        rock_uint_t *indx_v = indx->v;
+        indx->v = indx_out->v;
+        indx_out->v = indx_v;
+
+        void *elem_v = elem->v;
+        elem->v = elem_out->v;
+        elem_out->v = elem_v;
+    }
+
+    rock_indx_free(indx_out);
+    rock_elem_free(elem_out);
+    free(bins);
+}
+
 rock_dist_t *
 rock_dist_init(rock_indx_t *indx,
                rock_elem_t *elem,
                rock_mpart_t *mpart,
                rock_mesh_t *mesh)
 {
+    double start = rock_prof_start();
+
     rock_dist_t *dist = calloc(1, sizeof(rock_dist_t));
     dist->count = calloc(mesh->np, sizeof(rock_uint_t));
     dist->offset = calloc(mesh->np + 1, sizeof(rock_uint_t));
 
     /*
      * Find out what process each index belongs to using the supplied
-     * multi-partition object. Calculate counts and offsets for each 
-     * processor.
+     * multi-partition object and group indx and elem by processor.
      */
     if (mesh->rank == ROCK_MASTER) {
+        /* The caller's arrays may be mapped (see rock_tensor_mmap). */
+        dist_bucket(indx, elem, mpart, mesh->np, dist->count, true);
+    }
+
+    MPI_Bcast(dist->count, mesh->np, ROCK_UINT_MPI, ROCK_MASTER, mesh->comm);
+
+    dist->mesh = mesh;
+    dist_update_offset(dist);
 
-        /* Create new index array to hold processor indices. */
-        rock_indx_t *proc_indx = rock_indx_init(indx->len);
+    bool master = mesh->rank == ROCK_MASTER;
+    rock_prof_stop(ROCK_PROF_DIST_INIT, start,
+            (master ? mesh->np - 1 : 1) * mesh->np * sizeof(rock_uint_t),
+            master ? mesh->np - 1 : 1);
 
-        /* Populate proc array and counts. */
-        for (rock_uint_t i = 0; i < indx->len; i++) {
-            rock_uint_t part_num = rock_part_num_from_mpart(mpart, indx, i);
-            rock_indx_set(proc_indx, i, part_num);
-            dist->count[part_num]++;
+    return dist;
+}
+
+/*
+ * Send every local item to its owner according to a multi-partition.
+ *
+ * Local items are grouped by owner, counts are exchanged and the items
+ * themselves are moved using one all-to-all exchange each for indx and
+ * elem. The local arrays are replaced by the received ones.
+ *
+ * The bytes and messages moved (see profile.h) are added to the last
+ * two arguments.
+ */
+static void
+dist_exchange(rock_indx_t **indx,
+              rock_elem_t **elem,
+              rock_mpart_t *mpart,
+              rock_mesh_t *mesh,
+              uint64_t *bytes,
+              uint64_t *msgs)
+{
+    rock_uint_t np = mesh->np;
+    rock_uint_t *send_count = calloc(np, sizeof(rock_uint_t));
+    rock_uint_t *recv_count = calloc(np, sizeof(rock_uint_t));
+
+    dist_bucket(*indx, *elem, mpart, np, send_count, false);
+
+    MPI_Alltoall(send_count, 1, ROCK_UINT_MPI,
+            recv_count, 1, ROCK_UINT_MPI, mesh->comm);
+
+    int *scounts = calloc(np, sizeof(int));
+    int *sdispls = calloc(np, sizeof(int));
+    int *rcounts = calloc(np, sizeof(int));
+    int *rdispls = calloc(np, sizeof(int));
+
+    rock_uint_t recv_len = 0;
+    for (rock_uint_t p = 0; p < np; p++) {
+        scounts[p] = send_count[p];
+        rcounts[p] = recv_count[p];
+        sdispls[p] = (p == 0) ? 0 : sdispls[p-1] + scounts[p-1];
+        rdispls[p] = (p == 0) ? 0 : rdispls[p-1] + rcounts[p-1];
+        recv_len += recv_count[p];
+
+        if (p != mesh->rank) {
+            *bytes += (uint64_t) (send_count[p] + recv_count[p]) *
+                    DIST_ITEM_SIZE;
+            *msgs += 2 * ((send_count[p] > 0) + (recv_count[p] > 0));
         }
+    }
+
+    rock_indx_t *indx_recv = rock_indx_init(recv_len);
+    rock_elem_t *elem_recv = rock_elem_init(recv_len);
+
+    MPI_Alltoallv((*indx)->v, scounts, sdispls, ROCK_UINT_MPI,
+            indx_recv->v, rcounts, rdispls, ROCK_UINT_MPI, mesh->comm);
+    MPI_Alltoallv((*elem)->v, scounts, sdispls, ROCK_ELEM_MPI,
+            elem_recv->v, rcounts, rdispls, ROCK_ELEM_MPI, mesh->comm);
+
+    rock_indx_free(*indx);
+    rock_elem_free(*elem);
+    *indx = indx_recv;
+    *elem = elem_recv;
+
+    free(send_count);
+    free(recv_count);
+    free(scounts);
+    free(sdispls);
+    free(rcounts);
+    free(rdispls);
+}
+
+rock_dist_t *
+rock_dist_local(rock_uint_t len, rock_mesh_t *mesh)
+{
+    rock_dist_t *dist = calloc(1, sizeof(rock_dist_t));
+    dist->count = calloc(mesh->np, sizeof(rock_uint_t));
+    dist->offset = calloc(mesh->np + 1, sizeof(rock_uint_t));
 
-        /* Sort proc indices and permute indx and elem. */
-        rock_uint_t order = 1;
-        rock_uint_t dim_size[] = {mesh->np};
-        rock_desc_t *desc = rock_desc_init(order, dim_size);
-        rock_perm_t *perm = rock_perm_init(indx->len);
-        rock_uint_t num_dims = 1;
-        rock_uint_t dims[] = {0};
+    MPI_Allgather(&len, 1, ROCK_UINT_MPI,
+            dist->count, 1, ROCK_UINT_MPI, mesh->comm);
+
+    dist->mesh = mesh;
+    dist_update_offset(dist);
 
-        rock_indx_sort(desc, num_dims, dims, perm, proc_indx);
+    return dist;
+}
 
-        rock_indx_permute(indx, perm);
-        rock_elem_permute(elem, perm);
+rock_dist_t *
+rock_redistribute(rock_indx_t **indx,
+                  rock_elem_t **elem,
+                  rock_dist_t *old_dist,
+                  rock_mpart_t *new_mpart,
+                  rock_mesh_t *mesh)
+{
+    int valid = (*indx)->len == old_dist->count[mesh->rank] &&
+            (*elem)->len == (*indx)->len;
 
-        rock_indx_free(proc_indx);
-        rock_desc_free(desc);
+    /* Fail everywhere if any processor fails, the exchange is collective. */
+    MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_INT, MPI_LAND, mesh->comm);
+    if (!valid) {
+        return NULL;
     }
 
-    MPI_Bcast(dist->count, mesh->np, ROCK_UINT_MPI, ROCK_MASTER, mesh->comm);
+    double start = rock_prof_start();
+    uint64_t bytes = 0;
+    uint64_t msgs = 0;
 
-    /* Calculate offsets from counts. */
-    for (rock_uint_t i = 1; i <= mesh->np; i++) {
-        dist->offset[i] = dist->offset[i-1] + dist->count[i-1];
+    dist_exchange(indx, elem, new_mpart, mesh, &bytes, &msgs);
+
+    rock_dist_t *dist = calloc(1, sizeof(rock_dist_t));
+    dist->count = calloc(mesh->np, sizeof(rock_uint_t));
+    dist->offset = calloc(mesh->np + 1, sizeof(rock_uint_t));
+
+    MPI_Allgather(&(*indx)->len, 1, ROCK_UINT_MPI,
+            dist->count, 1, ROCK_UINT_MPI, mesh->comm);
+
+    dist->mesh = mesh;
+    dist_update_offset(dist);
+
+    rock_prof_stop(ROCK_PROF_REDISTRIBUTE, start, bytes, msgs);
+
+    return dist;
+}
+
+int
+rock_dist_append(rock_indx_t **indx,
+                 rock_elem_t **elem,
+                 rock_indx_t **new_indx,
+                 rock_elem_t **new_elem,
+                 rock_mpart_t *mpart,
+                 rock_dist_t *dist)
+{
+    rock_mesh_t *mesh = dist->mesh;
+
+    rock_uint_t new_len = *new_indx ? (*new_indx)->len : 0;
+    int valid = (*indx)->len == dist->count[mesh->rank] &&
+            (*elem)->len == (*indx)->len &&
+            (*new_elem ? (*new_elem)->len : 0) == new_len;
+
+    /* Fail everywhere if any processor fails, the exchange is collective. */
+    MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_INT, MPI_LAND, mesh->comm);
+    if (!valid) {
+        return ROCK_BAD_INPUT;
+    }
+
+    double start = rock_prof_start();
+    uint64_t bytes = 0;
+    uint64_t msgs = 0;
+
+    rock_indx_t *batch_indx = *new_indx ? *new_indx : rock_indx_init(0);
+    rock_elem_t *batch_elem = *new_elem ? *new_elem : rock_elem_init(0);
+    *new_indx = NULL;
+    *new_elem = NULL;
+
+    dist_exchange(&batch_indx, &batch_elem, mpart, mesh, &bytes, &msgs);
+
+    /* Append the received items to the local arrays. */
+    rock_uint_t len = (*indx)->len;
+    rock_uint_t recv_len = batch_indx->len;
+
+    (*indx)->v = realloc((*indx)->v, (len + recv_len) * sizeof(rock_uint_t));
+    (*elem)->v = realloc((*elem)->v,
+            (len + recv_len) * sizeof(*(*elem)->v));
+    memcpy(&(*indx)->v[len], batch_indx->v, recv_len * sizeof(rock_uint_t));
+    memcpy(&(*elem)->v[len], batch_elem->v,
+            recv_len * sizeof(*(*elem)->v));
+    (*indx)->len = len + recv_len;
+    (*elem)->len = len + recv_len;
+
+    rock_indx_free(batch_indx);
+    rock_elem_free(batch_elem);
+
+    /* Grow the counts by what every processor received. */
+    rock_uint_t *recv_count = malloc(mesh->np * sizeof(rock_uint_t));
+    MPI_Allgather(&recv_len, 1, ROCK_UINT_MPI, recv_count, 1, ROCK_UINT_MPI,
+            mesh->comm);
+
+    for (rock_uint_t p = 0; p < mesh->np; p++) {
+        dist->count[p] += recv_count[p];
+    }
+    dist_update_offset(dist);
+
+    free(recv_count);
+
+    rock_prof_stop(ROCK_PROF_DIST_APPEND, start, bytes, msgs);
+
+    return ROCK_OK;
+}
+
+/*
+ * The first of len items split into np shares differing at most by one.
+ */
+static inline rock_uint_t
+dist_share_offset(rock_uint_t len, rock_uint_t np, rock_uint_t p)
+{
+    rock_uint_t rem = len % np;
+
+    return p * (len / np) + ((p < rem) ? p : rem);
+}
+
+rock_dist_t *
+rock_dist_sample(rock_indx_t **indx,
+                 rock_elem_t **elem,
+                 rock_desc_t *desc,
+                 rock_uint_t nnz,
+                 uint64_t seed,
+                 rock_mesh_t *mesh)
+{
+    if (nnz > desc->total_size) {
+        return NULL;
     }
 
-    /* Calculate sum from offset. */
-    dist->sum = dist->offset[mesh->np];
+    rock_dist_t *dist = calloc(1, sizeof(rock_dist_t));
+    dist->count = calloc(mesh->np, sizeof(rock_uint_t));
+    dist->offset = calloc(mesh->np + 1, sizeof(rock_uint_t));
+
+    /* Shares are known everywhere, no need to communicate them. */
+    for (rock_uint_t p = 0; p < mesh->np; p++) {
+        dist->count[p] = dist_share_offset(nnz, mesh->np, p + 1) -
+                dist_share_offset(nnz, mesh->np, p);
+    }
 
     dist->mesh = mesh;
+    dist_update_offset(dist);
+
+    /* Share p <= range p as long as nnz <= total_size. */
+    rock_uint_t first = dist_share_offset(desc->total_size, mesh->np,
+            mesh->rank);
+    rock_uint_t range = dist_share_offset(desc->total_size, mesh->np,
+            mesh->rank + 1) - first;
+
+    *indx = rock_indx_init(dist->count[mesh->rank]);
+    *elem = rock_elem_init(dist->count[mesh->rank]);
+
+    rock_indx_sample_range(desc, *indx, first, range, seed);
+    rock_elem_sample_counter(*elem, seed, dist->offset[mesh->rank]);
 
     return dist;
 }
@@ -102,6 +589,14 @@ rock_dist_init(rock_indx_t *indx,
 void
 rock_mesh_free(rock_mesh_t *mesh)
 {
+    for (rock_uint_t i = 0; i < mesh->order; i++) {
+        MPI_Comm_free(&mesh->dim_comm[i]);
+        MPI_Comm_free(&mesh->slice_comm[i]);
+    }
+    MPI_Comm_free(&mesh->node_comm);
+    MPI_Comm_free(&mesh->comm);
+
+    free(mesh->cores);
     free(mesh);
 }
 
@@ -136,6 +631,11 @@ rock_mesh_print(rock_mesh_t *mesh)
         printf("%" PRIu32 " ", mesh->dim_size[i]);
     }
     printf("\n");
+    printf("    coord       ");
+    for (rock_uint_t i = 0; i < mesh->order; i++) {
+        printf("%" PRIu32 " ", mesh->coord[i]);
+    }
+    printf("\n");
     printf("    comm        ");
     if (mesh->comm)  {
         printf("obj\n");
@@ -174,7 +674,8 @@ rock_mpart_print(rock_mpart_t *mpart)
 void
 rock_indx_scatter(rock_indx_t **indx, rock_dist_t *dist)
 {
-    MPI_Barrier(dist->mesh->comm);
+    double start = rock_prof_start();
+    rock_prof_barrier(ROCK_PROF_INDX_SCATTER, dist->mesh->comm);
 
     /* Allocate memory from counts for everyone. */
     rock_indx_t *recv = rock_indx_init(dist->count[dist->mesh->rank]);
@@ -195,12 +696,17 @@ rock_indx_scatter(rock_indx_t **indx, rock_dist_t *dist)
     }
 
     *indx = recv;
+
+    uint64_t bytes, msgs;
+    dist_root_traffic(dist, sizeof(rock_uint_t), &bytes, &msgs);
+    rock_prof_stop(ROCK_PROF_INDX_SCATTER, start, bytes, msgs);
 }
 
 void
 rock_indx_gather(rock_indx_t **indx, rock_dist_t *dist)
 {
-    MPI_Barrier(dist->mesh->comm);
+    double start = rock_prof_start();
+    rock_prof_barrier(ROCK_PROF_INDX_GATHER, dist->mesh->comm);
 
     rock_indx_t *recv = NULL;
     rock_uint_t *v = NULL;
@@ -215,17 +721,23 @@ rock_indx_gather(rock_indx_t **indx, rock_dist_t *dist)
             v, dist->count, dist->offset, ROCK_UINT_MPI,
             ROCK_MASTER, dist->mesh->comm);
 
+    uint64_t bytes, msgs;
+    dist_root_traffic(dist, sizeof(rock_uint_t), &bytes, &msgs);
+
     /* Free old buffers at all processes and point root to new buffer. */
     free(*indx);
     if (dist->mesh->rank == ROCK_MASTER) {
         *indx = recv;
     }
+
+    rock_prof_stop(ROCK_PROF_INDX_GATHER, start, bytes, msgs);
 }
 
 void
 rock_elem_scatter(rock_elem_t **elem, rock_dist_t *dist)
 {
-    MPI_Barrier(dist->mesh->comm);
+    double start = rock_prof_start();
+    rock_prof_barrier(ROCK_PROF_ELEM_SCATTER, dist->mesh->comm);
 
     /* Allocate memory from counts for everyone. */
     rock_elem_t *recv = rock_elem_init(dist->count[dist->mesh->rank]);
@@ -253,12 +765,17 @@ rock_elem_scatter(rock_elem_t **elem, rock_dist_t *dist)
         free(*elem);
     }
     *elem = recv;
+
+    uint64_t bytes, msgs;
+    dist_root_traffic(dist, sizeof(*(*elem)->v), &bytes, &msgs);
+    rock_prof_stop(ROCK_PROF_ELEM_SCATTER, start, bytes, msgs);
 }
 
 void
 rock_elem_gather(rock_elem_t **elem, rock_dist_t *dist)
 {
-    MPI_Barrier(dist->mesh->comm);
+    double start = rock_prof_start();
+    rock_prof_barrier(ROCK_PROF_ELEM_GATHER, dist->mesh->comm);
 
     /* Allocate memory for recv buffer at root. */
     rock_elem_t *recv = NULL;
@@ -278,105 +795,1071 @@ rock_elem_gather(rock_elem_t **elem, rock_dist_t *dist)
             v, dist->count, dist->offset, ROCK_ELEM_MPI,
             ROCK_MASTER, dist->mesh->comm);
 
+    uint64_t bytes, msgs;
+    dist_root_traffic(dist, sizeof(*(*elem)->v), &bytes, &msgs);
+
     /* Free old buffers at all processes and point root to new buffer. */
     free(*elem);
     if (dist->mesh->rank == ROCK_MASTER) {
         *elem = recv;
     }
+
+    rock_prof_stop(ROCK_PROF_ELEM_GATHER, start, bytes, msgs);
 }
 
-rock_uint_t
-rock_part_num_from_mpart(rock_mpart_t *mpart,
-                         rock_indx_t *indx,
-                         rock_uint_t i)
+/*
+ * Move the parts of an index and an element array between the master
+ * and all other processors in chunks of bounded size.
+ *
+ * The master passes the whole arrays and moves part p from/to
+ * offset[p], the others pass their local arrays. Chunks are sent in
+ * rounds, where a round is posted before the previous one is waited
+ * for. Messages between two processors with the same tag never overtake
+ * each other, so chunks arrive in order.
+ */
+static void
+chunk_transfer(rock_indx_t *indx,
+               rock_elem_t *elem,
+               rock_dist_t *dist,
+               bool scatter)
 {
-    rock_uint_t part_indx[mpart->order];
-
-    for (rock_uint_t j = 0; j < mpart->order; j++) {
-        part_indx[j] = 0;
-        rock_uint_t dim_indx =
-                rock_indx_extract(mpart->desc, indx, i, mpart->dim_num[j]);
+    rock_mesh_t *mesh = dist->mesh;
+    bool master = mesh->rank == ROCK_MASTER;
+    bool send = master == scatter;
 
-        while (dim_indx >= mpart->dim_part[j]->offset[part_indx[j] + 1]) {
-            part_indx[j]++;
-        }
-    }
+    rock_uint_t chunk = dist_chunk_len();
 
-    rock_uint_t part_num = 0;
+    /* The master talks to everyone, the others only to the master. */
+    rock_uint_t first = master ? 0 : mesh->rank;
+    rock_uint_t last = master ? mesh->np : mesh->rank + 1;
 
-    for (rock_uint_t j = 0; j < mpart->order; j++) {
-        rock_uint_t prev_prod = 1;
-        for (rock_uint_t k = 0; k < j; k++) {
-            prev_prod *= mpart->dim_part[k]->num_parts;
+    rock_uint_t num_rounds = 0;
+    for (rock_uint_t p = first; p < last; p++) {
+        if (p != ROCK_MASTER) {
+            rock_uint_t rounds = (dist->count[p] + chunk - 1) / chunk;
+            num_rounds = (rounds > num_rounds) ? rounds : num_rounds;
         }
-        part_num += prev_prod * part_indx[j];
     }
 
-    return part_num;
-}
-
-rock_uint_t
-rock_get_largest_remaining_dim(rock_desc_t *desc, rock_mpart_t *mpart)
-{
-    rock_uint_t dim_num = ROCK_UINT_MAX;
+    /* Requests of two rounds, the one posted and the one in flight. */
+    int max_reqs = 2 * (last - first);
+    MPI_Request *reqs = malloc(2 * max_reqs * sizeof(MPI_Request));
+    int num_reqs[2] = {0, 0};
 
-    for (rock_uint_t i = 0; i < desc->order; i++) {
-        bool already_partitioned = false;
+    for (rock_uint_t r = 0; r <= num_rounds; r++) {
+        int curr = r % 2;
+        MPI_Request *round = &reqs[curr * max_reqs];
+        num_reqs[curr] = 0;
 
-        /* Did we already partition this dimension? */
-        if (mpart->dim_num[i] == ROCK_UINT_MAX) {
-            already_partitioned = false;
-        } else {
-            for (rock_uint_t k = 0; k < mpart->order; k++) {
-                if (i == mpart->dim_num[k]) {
-                    already_partitioned = true;
-                }
+        for (rock_uint_t p = first; p < last && r < num_rounds; p++) {
+            rock_uint_t begin = r * chunk;
+            if (p == ROCK_MASTER || begin >= dist->count[p]) {
+                continue;
             }
-        }
 
-        if (!already_partitioned) {
+            rock_uint_t len = dist->count[p] - begin;
+            len = (len > chunk) ? chunk : len;
+            rock_uint_t pos = master ? dist->offset[p] + begin : begin;
+            int peer = master ? p : ROCK_MASTER;
 
-            /* We want the largest remaining. */
-            if (dim_num == ROCK_UINT_MAX) {
-                dim_num = i;
+            if (send) {
+                MPI_Isend(&indx->v[pos], len, ROCK_UINT_MPI, peer,
+                        ROCK_TAG_INDX, mesh->comm, &round[num_reqs[curr]++]);
+                MPI_Isend(&elem->v[pos], len, ROCK_ELEM_MPI, peer,
+                        ROCK_TAG_ELEM, mesh->comm, &round[num_reqs[curr]++]);
             } else {
-                if (desc->dim_size[dim_num] < desc->dim_size[i]) {
-                    dim_num = i;
-                }
+                MPI_Irecv(&indx->v[pos], len, ROCK_UINT_MPI, peer,
+                        ROCK_TAG_INDX, mesh->comm, &round[num_reqs[curr]++]);
+                MPI_Irecv(&elem->v[pos], len, ROCK_ELEM_MPI, peer,
+                        ROCK_TAG_ELEM, mesh->comm, &round[num_reqs[curr]++]);
             }
         }
+
+        /* Complete the previous round while the current one is moving. */
+        if (r > 0) {
+            int prev = 1 - curr;
+            MPI_Waitall(num_reqs[prev], &reqs[prev * max_reqs],
+                    MPI_STATUSES_IGNORE);
+        }
     }
 
-    return dim_num;
+    free(reqs);
 }
 
-int
-rock_mpart_desc_based(rock_desc_t *desc,
-                     rock_mpart_t *mpart,
-                     rock_uint_t num_prio_dims,
-                     rock_uint_t *prio_dims)
+/*
+ * The number of bytes and messages a processor moves in a chunked
+ * transfer, see chunk_transfer.
+ */
+static void
+chunk_traffic(rock_dist_t *dist, uint64_t *bytes, uint64_t *msgs)
 {
-    for (rock_uint_t i = 0; i < mpart->order; i++) {
+    rock_mesh_t *mesh = dist->mesh;
+    rock_uint_t chunk = dist_chunk_len();
 
-        rock_uint_t dim_num;
+    dist_root_traffic(dist, DIST_ITEM_SIZE, bytes, msgs);
 
-        /*
-         * Start partitioning specified dimensions, use largest remaining
-         * if not enough are specified (i.e. if mpart->order > num_prio_dims).
-         */
-        if (i < num_prio_dims) {
-            dim_num = prio_dims[i];
-        } else {
-            dim_num = rock_get_largest_remaining_dim(desc, mpart);
+    /* One message for indx and one for elem per chunk. */
+    *msgs = 0;
+    for (rock_uint_t p = 0; p < mesh->np; p++) {
+        if (p != ROCK_MASTER &&
+                (mesh->rank == ROCK_MASTER || p == mesh->rank)) {
+            *msgs += 2 * ((dist->count[p] + chunk - 1) / chunk);
         }
+    }
+}
 
-        /* Create partition and store it in the mpartribution object. */
-        rock_part_desc_based(desc, mpart->dim_part[i], dim_num);
+/*
+ * Encode the part of each processor of an index array, the parts are
+ * stored one after the other in the returned buffer. NULL if the
+ * encoded array doesn't fit in an int (MPI counts and displacements).
+ */
+static uint8_t *
+dist_encode(rock_indx_t *indx, rock_dist_t *dist, int *size, int *displ)
+{
+    rock_uint_t np = dist->mesh->np;
+    size_t *part_size = malloc(np * sizeof(size_t));
 
-        mpart->dim_num[i] = dim_num;
+    #pragma omp parallel for num_threads(rock_thread_count(indx->len))
+    for (rock_uint_t p = 0; p < np; p++) {
+        part_size[p] = rock_codec_size(&indx->v[dist->offset[p]],
+                dist->count[p]);
     }
 
-    mpart->desc = desc;
+    uint64_t total = 0;
+    for (rock_uint_t p = 0; p < np; p++) {
+        total += part_size[p];
+    }
+    if (total > INT_MAX) {
+        free(part_size);
+        return NULL;
+    }
+
+    for (rock_uint_t p = 0; p < np; p++) {
+        size[p] = part_size[p];
+        displ[p] = (p > 0) ? displ[p-1] + size[p-1] : 0;
+    }
+    free(part_size);
+
+    uint8_t *buf = malloc(total + 1);
+
+    #pragma omp parallel for num_threads(rock_thread_count(indx->len))
+    for (rock_uint_t p = 0; p < np; p++) {
+        rock_codec_encode(&indx->v[dist->offset[p]], dist->count[p],
+                &buf[displ[p]]);
+    }
+
+    return buf;
+}
+
+void
+rock_indx_scatter_compressed(rock_indx_t **indx, rock_dist_t *dist)
+{
+    double start = rock_prof_start();
+
+    rock_mesh_t *mesh = dist->mesh;
+    bool master = mesh->rank == ROCK_MASTER;
+
+    rock_indx_t *recv = rock_indx_init(dist->count[mesh->rank]);
+
+    int *size = NULL;
+    int *displ = NULL;
+    uint8_t *buf = NULL;
+
+    if (master) {
+        size = malloc(mesh->np * sizeof(int));
+        displ = malloc(mesh->np * sizeof(int));
+        buf = dist_encode(*indx, dist, size, displ);
+
+        /* Too large to encode, tell everyone. */
+        if (buf == NULL) {
+            for (rock_uint_t p = 0; p < mesh->np; p++) {
+                size[p] = -1;
+            }
+        }
+    }
+
+    int recv_size;
+    MPI_Scatter(size, 1, MPI_INT, &recv_size, 1, MPI_INT,
+            ROCK_MASTER, mesh->comm);
+
+    if (recv_size < 0) {
+        free(size);
+        free(displ);
+        rock_indx_free(recv);
+        rock_indx_scatter(indx, dist);
+        return;
+    }
+
+    uint8_t *recv_buf = malloc(recv_size + 1);
+    MPI_Scatterv(buf, size, displ, MPI_BYTE, recv_buf, recv_size, MPI_BYTE,
+            ROCK_MASTER, mesh->comm);
+
+    rock_codec_decode(recv_buf, recv->len, recv->v);
+
+    uint64_t bytes = recv_size;
+    uint64_t msgs = 1;
+
+    free(recv_buf);
+    if (master) {
+        bytes = displ[mesh->np-1] + size[mesh->np-1] - recv_size;
+        msgs = mesh->np - 1;
+
+        free(buf);
+        free(size);
+        free(displ);
+        rock_indx_free(*indx);
+    }
+
+    *indx = recv;
+
+    rock_prof_stop(ROCK_PROF_INDX_SCATTER_COMPRESSED, start, bytes, msgs);
+}
+
+void
+rock_indx_gather_compressed(rock_indx_t **indx, rock_dist_t *dist)
+{
+    double start = rock_prof_start();
+
+    rock_mesh_t *mesh = dist->mesh;
+    bool master = mesh->rank == ROCK_MASTER;
+
+    uint64_t part_size = rock_codec_size((*indx)->v, (*indx)->len);
+    uint64_t total;
+    MPI_Allreduce(&part_size, &total, 1, MPI_UINT64_T, MPI_SUM, mesh->comm);
+
+    /* Too large to encode. */
+    if (total > INT_MAX) {
+        rock_indx_gather(indx, dist);
+        return;
+    }
+
+    int send_size = part_size;
+    uint8_t *send_buf = malloc(send_size + 1);
+    rock_codec_encode((*indx)->v, (*indx)->len, send_buf);
+
+    int *size = NULL;
+    int *displ = NULL;
+    uint8_t *buf = NULL;
+
+    if (master) {
+        size = malloc(mesh->np * sizeof(int));
+        displ = malloc(mesh->np * sizeof(int));
+    }
+
+    MPI_Gather(&send_size, 1, MPI_INT, size, 1, MPI_INT,
+            ROCK_MASTER, mesh->comm);
+
+    if (master) {
+        displ[0] = 0;
+        for (rock_uint_t p = 1; p < mesh->np; p++) {
+            displ[p] = displ[p-1] + size[p-1];
+        }
+        buf = malloc(displ[mesh->np-1] + size[mesh->np-1] + 1);
+    }
+
+    MPI_Gatherv(send_buf, send_size, MPI_BYTE, buf, size, displ, MPI_BYTE,
+            ROCK_MASTER, mesh->comm);
+
+    uint64_t bytes = send_size;
+    uint64_t msgs = 1;
+
+    free(send_buf);
+    rock_indx_free(*indx);
+    *indx = NULL;
+
+    if (master) {
+        rock_indx_t *recv = rock_indx_init(dist->sum);
+
+        #pragma omp parallel for num_threads(rock_thread_count(dist->sum))
+        for (rock_uint_t p = 0; p < mesh->np; p++) {
+            rock_codec_decode(&buf[displ[p]], dist->count[p],
+                    &recv->v[dist->offset[p]]);
+        }
+
+        bytes = displ[mesh->np-1] + size[mesh->np-1] - send_size;
+        msgs = mesh->np - 1;
+
+        free(buf);
+        free(size);
+        free(displ);
+
+        *indx = recv;
+    }
+
+    rock_prof_stop(ROCK_PROF_INDX_GATHER_COMPRESSED, start, bytes, msgs);
+}
+
+void
+rock_chunk_scatter(rock_indx_t **indx,
+                   rock_elem_t **elem,
+                   rock_dist_t *dist)
+{
+    double start = rock_prof_start();
+
+    rock_mesh_t *mesh = dist->mesh;
+
+    /* Allocate memory from counts for everyone. */
+    rock_indx_t *indx_recv = rock_indx_init(dist->count[mesh->rank]);
+    rock_elem_t *elem_recv = rock_elem_init(dist->count[mesh->rank]);
+
+    if (mesh->rank == ROCK_MASTER) {
+        rock_uint_t offset = dist->offset[ROCK_MASTER];
+        memcpy(indx_recv->v, &(*indx)->v[offset],
+                indx_recv->len * sizeof(rock_uint_t));
+        memcpy(elem_recv->v, &(*elem)->v[offset],
+                elem_recv->len * sizeof(*elem_recv->v));
+
+        chunk_transfer(*indx, *elem, dist, true);
+
+        rock_indx_free(*indx);
+        rock_elem_free(*elem);
+    } else {
+        chunk_transfer(indx_recv, elem_recv, dist, true);
+    }
+
+    *indx = indx_recv;
+    *elem = elem_recv;
+
+    uint64_t bytes, msgs;
+    chunk_traffic(dist, &bytes, &msgs);
+    rock_prof_stop(ROCK_PROF_CHUNK_SCATTER, start, bytes, msgs);
+}
+
+void
+rock_chunk_gather(rock_indx_t **indx,
+                  rock_elem_t **elem,
+                  rock_dist_t *dist)
+{
+    double start = rock_prof_start();
+
+    rock_mesh_t *mesh = dist->mesh;
+
+    if (mesh->rank == ROCK_MASTER) {
+        /* Allocate memory for recv buffers at root. */
+        rock_indx_t *indx_recv = rock_indx_init(dist->sum);
+        rock_elem_t *elem_recv = rock_elem_init(dist->sum);
+
+        rock_uint_t offset = dist->offset[ROCK_MASTER];
+        memcpy(&indx_recv->v[offset], (*indx)->v,
+                (*indx)->len * sizeof(rock_uint_t));
+        memcpy(&elem_recv->v[offset], (*elem)->v,
+                (*elem)->len * sizeof(*elem_recv->v));
+
+        chunk_transfer(indx_recv, elem_recv, dist, false);
+
+        rock_indx_free(*indx);
+        rock_elem_free(*elem);
+        *indx = indx_recv;
+        *elem = elem_recv;
+    } else {
+        chunk_transfer(*indx, *elem, dist, false);
+
+        rock_indx_free(*indx);
+        rock_elem_free(*elem);
+        *indx = NULL;
+        *elem = NULL;
+    }
+
+    uint64_t bytes, msgs;
+    chunk_traffic(dist, &bytes, &msgs);
+    rock_prof_stop(ROCK_PROF_CHUNK_GATHER, start, bytes, msgs);
+}
+
+/*
+ * Create a datatype describing @c len items of both an index and an
+ * element array, starting at @c offset, using absolute addresses.
+ *
+ * Block lengths are int, so each array is split into blocks of at most
+ * INT_MAX items.
+ */
+static MPI_Datatype
+tensor_type(rock_indx_t *indx,
+            rock_elem_t *elem,
+            rock_uint_t offset,
+            rock_uint_t len)
+{
+    uint64_t num_blocks = ((uint64_t) len + INT_MAX - 1) / INT_MAX;
+
+    MPI_Datatype type;
+    MPI_Datatype *types = malloc(2 * num_blocks * sizeof(MPI_Datatype));
+    int *block_len = malloc(2 * num_blocks * sizeof(int));
+    MPI_Aint *displ = malloc(2 * num_blocks * sizeof(MPI_Aint));
+
+    for (uint64_t b = 0; b < num_blocks; b++) {
+        uint64_t first = offset + b * INT_MAX;
+        uint64_t rest = offset + (uint64_t) len - first;
+        int n = rest < INT_MAX ? (int) rest : INT_MAX;
+
+        types[2 * b] = ROCK_UINT_MPI;
+        types[2 * b + 1] = ROCK_ELEM_MPI;
+        block_len[2 * b] = n;
+        block_len[2 * b + 1] = n;
+        MPI_Get_address(&indx->v[first], &displ[2 * b]);
+        MPI_Get_address(&elem->v[first], &displ[2 * b + 1]);
+    }
+
+    MPI_Type_create_struct((int) (2 * num_blocks), block_len, displ, types,
+            &type);
+    MPI_Type_commit(&type);
+
+    free(types);
+    free(block_len);
+    free(displ);
+
+    return type;
+}
+
+/*
+ * Move the parts of a tensor between the master and all other
+ * processors, one message per processor.
+ *
+ * The master passes the whole arrays and moves part p from/to
+ * offset[p], the others pass their local arrays.
+ */
+static void
+tensor_transfer(rock_indx_t *indx,
+                rock_elem_t *elem,
+                rock_dist_t *dist,
+                bool scatter)
+{
+    rock_mesh_t *mesh = dist->mesh;
+    bool master = mesh->rank == ROCK_MASTER;
+    bool send = master == scatter;
+
+    rock_uint_t first = master ? 0 : mesh->rank;
+    rock_uint_t last = master ? mesh->np : mesh->rank + 1;
+
+    MPI_Request *reqs = malloc((last - first) * sizeof(MPI_Request));
+    MPI_Datatype *types = malloc((last - first) * sizeof(MPI_Datatype));
+    int num_reqs = 0;
+
+    for (rock_uint_t p = first; p < last; p++) {
+        if (p == ROCK_MASTER || dist->count[p] == 0) {
+            continue;
+        }
+
+        rock_uint_t offset = master ? dist->offset[p] : 0;
+        int peer = master ? p : ROCK_MASTER;
+
+        types[num_reqs] = tensor_type(indx, elem, offset, dist->count[p]);
+
+        if (send) {
+            MPI_Isend(MPI_BOTTOM, 1, types[num_reqs], peer,
+                    ROCK_TAG_TENSOR, mesh->comm, &reqs[num_reqs]);
+        } else {
+            MPI_Irecv(MPI_BOTTOM, 1, types[num_reqs], peer,
+                    ROCK_TAG_TENSOR, mesh->comm, &reqs[num_reqs]);
+        }
+        num_reqs++;
+    }
+
+    MPI_Waitall(num_reqs, reqs, MPI_STATUSES_IGNORE);
+
+    for (int i = 0; i < num_reqs; i++) {
+        MPI_Type_free(&types[i]);
+    }
+
+    free(reqs);
+    free(types);
+}
+
+void
+rock_tensor_scatter(rock_tensor_t **tensor, rock_dist_t *dist)
+{
+    double start = rock_prof_start();
+
+    rock_mesh_t *mesh = dist->mesh;
+    rock_uint_t len = dist->count[mesh->rank];
+
+    rock_indx_t *indx_recv = rock_indx_init(len);
+    rock_elem_t *elem_recv = rock_elem_init(len);
+
+    if (mesh->rank == ROCK_MASTER) {
+        rock_tensor_t *src = *tensor;
+        rock_uint_t offset = dist->offset[ROCK_MASTER];
+
+        memcpy(indx_recv->v, &src->indx->v[offset], len * sizeof(rock_uint_t));
+        memcpy(elem_recv->v, &src->elem->v[offset],
+                len * sizeof(*elem_recv->v));
+
+        tensor_transfer(src->indx, src->elem, dist, true);
+
+        rock_indx_free(src->indx);
+        rock_elem_free(src->elem);
+    } else {
+        *tensor = calloc(1, sizeof(rock_tensor_t));
+        (*tensor)->desc = calloc(1, sizeof(rock_desc_t));
+
+        tensor_transfer(indx_recv, elem_recv, dist, true);
+    }
+
+    MPI_Bcast((*tensor)->desc, sizeof(rock_desc_t), MPI_BYTE,
+            ROCK_MASTER, mesh->comm);
+
+    (*tensor)->indx = indx_recv;
+    (*tensor)->elem = elem_recv;
+    (*tensor)->sorted_dim = ROCK_UINT_MAX;
+
+    /* A single message per processor carries both arrays. */
+    uint64_t bytes, msgs;
+    dist_root_traffic(dist, DIST_ITEM_SIZE, &bytes, &msgs);
+    rock_prof_stop(ROCK_PROF_TENSOR_SCATTER, start, bytes, msgs);
+}
+
+void
+rock_tensor_gather(rock_tensor_t **tensor, rock_dist_t *dist)
+{
+    double start = rock_prof_start();
+
+    rock_mesh_t *mesh = dist->mesh;
+    rock_tensor_t *local = *tensor;
+
+    if (mesh->rank == ROCK_MASTER) {
+        rock_indx_t *indx_recv = rock_indx_init(dist->sum);
+        rock_elem_t *elem_recv = rock_elem_init(dist->sum);
+        rock_uint_t offset = dist->offset[ROCK_MASTER];
+
+        memcpy(&indx_recv->v[offset], local->indx->v,
+                local->indx->len * sizeof(rock_uint_t));
+        memcpy(&elem_recv->v[offset], local->elem->v,
+                local->elem->len * sizeof(*elem_recv->v));
+
+        tensor_transfer(indx_recv, elem_recv, dist, false);
+
+        rock_indx_free(local->indx);
+        rock_elem_free(local->elem);
+        local->indx = indx_recv;
+        local->elem = elem_recv;
+        local->sorted_dim = ROCK_UINT_MAX;
+    } else {
+        tensor_transfer(local->indx, local->elem, dist, false);
+
+        rock_tensor_free(local);
+        *tensor = NULL;
+    }
+
+    /* A single message per processor carries both arrays. */
+    uint64_t bytes, msgs;
+    dist_root_traffic(dist, DIST_ITEM_SIZE, &bytes, &msgs);
+    rock_prof_stop(ROCK_PROF_TENSOR_GATHER, start, bytes, msgs);
+}
+
+rock_uint_t
+rock_part_num_from_mpart(rock_mpart_t *mpart,
+                         rock_indx_t *indx,
+                         rock_uint_t i)
+{
+    rock_uint_t part_num = 0;
+    rock_uint_t stride = 1;
+
+    for (rock_uint_t j = 0; j < mpart->order; j++) {
+        rock_part_t *part = mpart->dim_part[j];
+        rock_uint_t dim_indx =
+                rock_indx_extract(mpart->desc, indx, i, mpart->dim_num[j]);
+
+        part_num += stride * rock_part_find(part, dim_indx);
+        stride *= part->num_parts;
+    }
+
+    return part_num;
+}
+
+int
+rock_mesh_shape(rock_desc_t *desc,
+                rock_uint_t np,
+                rock_uint_t *dim_size)
+{
+    for (rock_uint_t i = 0; i < desc->order; i++) {
+        dim_size[i] = 1;
+    }
+
+    /* Prime factors of np, largest first. */
+    rock_uint_t factors[sizeof(rock_uint_t) * CHAR_BIT];
+    rock_uint_t num_factors = 0;
+    rock_uint_t rest = np;
+    for (rock_uint_t f = 2; f <= rest / f; f++) {
+        while (rest % f == 0) {
+            factors[num_factors++] = f;
+            rest /= f;
+        }
+    }
+    if (rest > 1) {
+        factors[num_factors++] = rest;
+    }
+
+    /*
+     * Hand each factor to the dimension with the largest block per
+     * processor that can still be split, to keep blocks as cubical as
+     * possible and thereby the communication volume low.
+     */
+    for (rock_uint_t k = num_factors; k-- > 0;) {
+        rock_uint_t best = ROCK_UINT_MAX;
+
+        for (rock_uint_t i = 0; i < desc->order; i++) {
+            if ((uint64_t) dim_size[i] * factors[k] > desc->dim_size[i]) {
+                continue;
+            }
+            if (best == ROCK_UINT_MAX || (uint64_t) desc->dim_size[i] *
+                    dim_size[best] > (uint64_t) desc->dim_size[best] *
+                    dim_size[i]) {
+                best = i;
+            }
+        }
+
+        if (best == ROCK_UINT_MAX) {
+            return ROCK_BAD_INPUT;
+        }
+
+        dim_size[best] *= factors[k];
+    }
+
+    return ROCK_OK;
+}
+
+rock_uint_t
+rock_get_largest_remaining_dim(rock_desc_t *desc, rock_mpart_t *mpart)
+{
+    rock_uint_t dim_num = ROCK_UINT_MAX;
+
+    for (rock_uint_t i = 0; i < desc->order; i++) {
+        bool already_partitioned = false;
+
+        /* Did we already partition this dimension? */
+        if (mpart->dim_num[i] == ROCK_UINT_MAX) {
+            already_partitioned = false;
+        } else {
+            for (rock_uint_t k = 0; k < mpart->order; k++) {
+                if (i == mpart->dim_num[k]) {
+                    already_partitioned = true;
+                }
+            }
+        }
+
+        if (!already_partitioned) {
+
+            /* We want the largest remaining. */
+            if (dim_num == ROCK_UINT_MAX) {
+                dim_num = i;
+            } else {
+                if (desc->dim_size[dim_num] < desc->dim_size[i]) {
+                    dim_num = i;
+                }
+            }
+        }
+    }
+
+    return dim_num;
+}
+
+int
+rock_mpart_desc_based(rock_desc_t *desc,
+                     rock_mpart_t *mpart,
+                     rock_uint_t num_prio_dims,
+                     rock_uint_t *prio_dims)
+{
+    for (rock_uint_t i = 0; i < mpart->order; i++) {
+
+        rock_uint_t dim_num;
+
+        /*
+         * Start partitioning specified dimensions, use largest remaining
+         * if not enough are specified (i.e. if mpart->order > num_prio_dims).
+         */
+        if (i < num_prio_dims) {
+            dim_num = prio_dims[i];
+        } else {
+            dim_num = rock_get_largest_remaining_dim(desc, mpart);
+        }
+
+        /* Create partition and store it in the mpartribution object. */
+        rock_part_desc_based(desc, mpart->dim_part[i], dim_num);
+
+        mpart->dim_num[i] = dim_num;
+    }
+
+    mpart->desc = desc;
+
+    return ROCK_OK;
+}
+
+int
+rock_mpart_indx_based(rock_freq_t *freq,
+                      rock_mpart_t *mpart,
+                      rock_uint_t num_prio_dims,
+                      rock_uint_t *prio_dims,
+                      double *imbalance)
+{
+    rock_desc_t *desc = freq->desc;
+
+    for (rock_uint_t i = 0; i < mpart->order; i++) {
+
+        rock_uint_t dim_num;
+
+        if (i < num_prio_dims) {
+            dim_num = prio_dims[i];
+        } else {
+            dim_num = rock_get_largest_remaining_dim(desc, mpart);
+        }
+
+        int status = rock_part_freq_based(freq, mpart->dim_part[i], dim_num);
+        if (status != ROCK_OK) {
+            return status;
+        }
+
+        mpart->dim_num[i] = dim_num;
+    }
+
+    mpart->desc = desc;
+
+    if (imbalance) {
+        *imbalance = rock_mpart_imbalance(mpart, freq->indx);
+    }
+
+    return ROCK_OK;
+}
+
+/*
+ * Count the number of items of an index array that belong to each part
+ * of a multi-partition.
+ */
+static void
+mpart_count(rock_mpart_t *mpart,
+            rock_indx_t *indx,
+            rock_uint_t num_parts,
+            rock_uint_t *count)
+{
+    #pragma omp parallel num_threads(rock_thread_count(indx->len))
+    {
+        rock_uint_t *local = calloc(num_parts, sizeof(rock_uint_t));
+
+        #pragma omp for
+        for (rock_uint_t i = 0; i < indx->len; i++) {
+            local[rock_part_num_from_mpart(mpart, indx, i)]++;
+        }
+
+        #pragma omp critical
+        for (rock_uint_t p = 0; p < num_parts; p++) {
+            count[p] += local[p];
+        }
+
+        free(local);
+    }
+}
+
+double
+rock_mpart_imbalance(rock_mpart_t *mpart, rock_indx_t *indx)
+{
+    rock_uint_t num_parts = 1;
+    for (rock_uint_t i = 0; i < mpart->order; i++) {
+        num_parts *= mpart->dim_part[i]->num_parts;
+    }
+
+    rock_uint_t *count = calloc(num_parts, sizeof(rock_uint_t));
+    mpart_count(mpart, indx, num_parts, count);
+
+    rock_uint_t max = 0;
+    for (rock_uint_t p = 0; p < num_parts; p++) {
+        max = (count[p] > max) ? count[p] : max;
+    }
+
+    free(count);
+
+    if (indx->len == 0) {
+        return 1.0;
+    }
+
+    return (double) max * num_parts / indx->len;
+}
+
+double
+rock_mpart_imbalance_dist(rock_mpart_t *mpart,
+                          rock_indx_t *indx,
+                          rock_mesh_t *mesh)
+{
+    rock_uint_t num_parts = 1;
+    for (rock_uint_t i = 0; i < mpart->order; i++) {
+        num_parts *= mpart->dim_part[i]->num_parts;
+    }
+
+    rock_uint_t *count = calloc(num_parts, sizeof(rock_uint_t));
+    mpart_count(mpart, indx, num_parts, count);
+
+    MPI_Allreduce(MPI_IN_PLACE, count, num_parts, ROCK_UINT_MPI, MPI_SUM,
+            mesh->comm);
+
+    rock_uint_t max = 0;
+    rock_uint_t sum = 0;
+    for (rock_uint_t p = 0; p < num_parts; p++) {
+        max = (count[p] > max) ? count[p] : max;
+        sum += count[p];
+    }
+
+    free(count);
+
+    if (sum == 0) {
+        return 1.0;
+    }
+
+    return (double) max * num_parts / sum;
+}
+
+rock_freq_t *
+rock_freq_dist_init(rock_desc_t *desc,
+                    rock_indx_t *indx,
+                    rock_mesh_t *mesh,
+                    rock_stat_t *stat)
+{
+    double start = rock_prof_start();
+    uint64_t bytes = 0;
+    uint64_t msgs = 0;
+
+    rock_freq_t *freq = rock_freq_init(desc, indx);
+
+    rock_uint_t chunk = dist_chunk_len();
+
+    /* MPI counts are int, reduce large dimensions segment by segment. */
+    for (rock_uint_t k = 0; k < desc->order; k++) {
+        for (rock_uint_t first = 0; first < desc->dim_size[k];
+                first += chunk) {
+            rock_uint_t len = desc->dim_size[k] - first;
+            len = (len < chunk) ? len : chunk;
+
+            MPI_Allreduce(MPI_IN_PLACE, &freq->dim_freq[k][first], len,
+                    ROCK_UINT_MPI, MPI_SUM, mesh->comm);
+
+            /* Counted as sending and receiving the segment once. */
+            bytes += 2 * len * sizeof(rock_uint_t);
+            msgs += 2;
+        }
+    }
+
+    if (stat) {
+        /* The total may not fit a rock_uint_t, reduce it separately. */
+        stat->nnz = indx->len;
+        MPI_Allreduce(MPI_IN_PLACE, &stat->nnz, 1, MPI_UINT64_T, MPI_SUM,
+                mesh->comm);
+        bytes += 2 * sizeof(uint64_t);
+        msgs += 2;
+
+        for (rock_uint_t k = 0; k < desc->order; k++) {
+            rock_uint_t *dim_freq = freq->dim_freq[k];
+            rock_uint_t min = 0;
+            rock_uint_t max = desc->dim_size[k] - 1;
+
+            while (min < desc->dim_size[k] && dim_freq[min] == 0) {
+                min++;
+            }
+            while (max > min && dim_freq[max] == 0) {
+                max--;
+            }
+
+            /* An empty tensor has an empty range (min > max). */
+            stat->dim_min[k] = min;
+            stat->dim_max[k] = (min < desc->dim_size[k]) ? max : 0;
+        }
+    }
+
+    rock_prof_stop(ROCK_PROF_FREQ_DIST, start, bytes, msgs);
+
+    return freq;
+}
+
+/*
+ * Move split points of a partition towards splitting the total weight
+ * evenly, see rock_part_freq_based.
+ */
+static void
+mpart_split_weighted(double *weight,
+                     rock_uint_t dim_size,
+                     rock_part_t *part,
+                     double damping)
+{
+    rock_uint_t num_parts = part->num_parts;
+
+    double total = 0;
+    for (rock_uint_t i = 0; i < dim_size; i++) {
+        total += weight[i];
+    }
+
+    rock_uint_t i = 0;
+    double sum = 0;
+
+    for (rock_uint_t k = 1; k < num_parts; k++) {
+        double target = total * k / num_parts;
+
+        while (i < dim_size && sum + weight[i] <= target) {
+            sum += weight[i++];
+        }
+
+        /* Include the straddling index if that gets us closer. */
+        if (i < dim_size && sum + weight[i] - target < target - sum) {
+            sum += weight[i++];
+        }
+
+        /* Move part of the way and leave room for one index per part. */
+        double old = part->offset[k];
+        rock_uint_t split = old + damping * ((double) i - old) + 0.5;
+        rock_uint_t first = part->offset[k-1] + 1;
+        rock_uint_t last = dim_size - (num_parts - k);
+
+        split = (split < first) ? first : split;
+        split = (split > last) ? last : split;
+
+        part->offset[k] = split;
+    }
+}
+
+/*
+ * Send every local item whose owner changed to its new owner according
+ * to a multi-partition using point-to-point messages, items staying
+ * put are copied locally. The local arrays are replaced.
+ */
+static void
+dist_migrate(rock_indx_t **indx,
+             rock_elem_t **elem,
+             rock_mpart_t *mpart,
+             rock_mesh_t *mesh,
+             uint64_t *bytes,
+             uint64_t *msgs)
+{
+    rock_uint_t np = mesh->np;
+    rock_uint_t *send_count = calloc(np, sizeof(rock_uint_t));
+    rock_uint_t *recv_count = calloc(np, sizeof(rock_uint_t));
+
+    dist_bucket(*indx, *elem, mpart, np, send_count, false);
+
+    MPI_Alltoall(send_count, 1, ROCK_UINT_MPI,
+            recv_count, 1, ROCK_UINT_MPI, mesh->comm);
+
+    rock_uint_t recv_len = 0;
+    for (rock_uint_t p = 0; p < np; p++) {
+        recv_len += recv_count[p];
+    }
+
+    rock_indx_t *indx_recv = rock_indx_init(recv_len);
+    rock_elem_t *elem_recv = rock_elem_init(recv_len);
+    MPI_Request *reqs = malloc(4 * np * sizeof(MPI_Request));
+    int num_reqs = 0;
+
+    rock_uint_t send_offset = 0;
+    rock_uint_t recv_offset = 0;
+
+    for (rock_uint_t p = 0; p < np; p++) {
+        if (p == mesh->rank) {
+            memcpy(&indx_recv->v[recv_offset], &(*indx)->v[send_offset],
+                    send_count[p] * sizeof(rock_uint_t));
+            memcpy(&elem_recv->v[recv_offset], &(*elem)->v[send_offset],
+                    send_count[p] * sizeof(*elem_recv->v));
+        } else {
+            if (recv_count[p] > 0) {
+                MPI_Irecv(&indx_recv->v[recv_offset], recv_count[p],
+                        ROCK_UINT_MPI, p, ROCK_TAG_INDX, mesh->comm,
+                        &reqs[num_reqs++]);
+                MPI_Irecv(&elem_recv->v[recv_offset], recv_count[p],
+                        ROCK_ELEM_MPI, p, ROCK_TAG_ELEM, mesh->comm,
+                        &reqs[num_reqs++]);
+            }
+            if (send_count[p] > 0) {
+                MPI_Isend(&(*indx)->v[send_offset], send_count[p],
+                        ROCK_UINT_MPI, p, ROCK_TAG_INDX, mesh->comm,
+                        &reqs[num_reqs++]);
+                MPI_Isend(&(*elem)->v[send_offset], send_count[p],
+                        ROCK_ELEM_MPI, p, ROCK_TAG_ELEM, mesh->comm,
+                        &reqs[num_reqs++]);
+            }
+
+            *bytes += (uint64_t) (send_count[p] + recv_count[p]) *
+                    DIST_ITEM_SIZE;
+        }
+
+        send_offset += send_count[p];
+        recv_offset += recv_count[p];
+    }
+
+    *msgs += num_reqs;
+
+    MPI_Waitall(num_reqs, reqs, MPI_STATUSES_IGNORE);
+
+    rock_indx_free(*indx);
+    rock_elem_free(*elem);
+    *indx = indx_recv;
+    *elem = elem_recv;
+
+    free(reqs);
+    free(send_count);
+    free(recv_count);
+}
+
+int
+rock_mpart_rebalance(rock_indx_t **indx,
+                     rock_elem_t **elem,
+                     double time,
+                     double damping,
+                     rock_mpart_t *mpart,
+                     rock_dist_t *dist)
+{
+    rock_mesh_t *mesh = dist->mesh;
+    rock_desc_t *desc = mpart->desc;
+
+    int valid = (*indx)->len == dist->count[mesh->rank] &&
+            (*elem)->len == (*indx)->len &&
+            damping > 0 && damping <= 1 && time >= 0;
+
+    /* Fail everywhere if any processor fails, the exchange is collective. */
+    MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_INT, MPI_LAND, mesh->comm);
+    if (!valid) {
+        return ROCK_BAD_INPUT;
+    }
+
+    double start = rock_prof_start();
+    uint64_t bytes = 0;
+    uint64_t msgs = 0;
+
+    /* The cost per item of each processor, the average if it has none. */
+    double total_time;
+    MPI_Allreduce(&time, &total_time, 1, MPI_DOUBLE, MPI_SUM, mesh->comm);
+
+    double cost = (dist->sum > 0) ? total_time / dist->sum : 0;
+    if ((*indx)->len > 0) {
+        cost = time / (*indx)->len;
+    }
+
+    /* Nothing measured, balance the number of items instead. */
+    if (total_time == 0) {
+        cost = 1;
+    }
+
+    rock_uint_t chunk = dist_chunk_len();
+
+    for (rock_uint_t m = 0; m < mpart->order; m++) {
+        rock_uint_t dim = mpart->dim_num[m];
+        rock_uint_t dim_size = desc->dim_size[dim];
+        double *weight = calloc(dim_size, sizeof(double));
+
+        for (rock_uint_t i = 0; i < (*indx)->len; i++) {
+            weight[rock_indx_extract(desc, *indx, i, dim)] += cost;
+        }
+
+        for (rock_uint_t first = 0; first < dim_size; first += chunk) {
+            rock_uint_t len = dim_size - first;
+            len = (len < chunk) ? len : chunk;
+
+            MPI_Allreduce(MPI_IN_PLACE, &weight[first], len, MPI_DOUBLE,
+                    MPI_SUM, mesh->comm);
+        }
+
+        mpart_split_weighted(weight, dim_size, mpart->dim_part[m], damping);
+
+        free(weight);
+    }
+
+    dist_migrate(indx, elem, mpart, mesh, &bytes, &msgs);
+
+    MPI_Allgather(&(*indx)->len, 1, ROCK_UINT_MPI,
+            dist->count, 1, ROCK_UINT_MPI, mesh->comm);
+    dist_update_offset(dist);
+
+    rock_prof_stop(ROCK_PROF_REBALANCE, start, bytes, msgs);
 
     return ROCK_OK;
 }
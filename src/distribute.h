@@ -7,8 +7,15 @@
 #define _DISTRIBUTE_H
 
 #include "core.h"
+#include "tensor.h"
 #include <mpi.h>
 
+/**
+ * The maximum number of items per message of chunked transfers (the
+ * default if not positive).
+ */
+extern int rock_chunk_len;
+
 /**
  * Processor mesh object.
  *
@@ -31,9 +38,40 @@ typedef struct rock_mesh_s
     /** The size of each dimension. */
     rock_uint_t dim_size[ROCK_MAX_MESH_ORDER];
 
-    /** The MPI communicator object. */
+    /** The coordinates of the processor in the mesh. */
+    rock_uint_t coord[ROCK_MAX_MESH_ORDER];
+
+    /** The MPI communicator object (with a Cartesian topology). */
     MPI_Comm comm;
 
+    /**
+     * Communicators of the processors along each dimension, i.e., of the
+     * processors sharing all coordinates except the one of dimension i
+     * (fibers).
+     */
+    MPI_Comm dim_comm[ROCK_MAX_MESH_ORDER];
+
+    /**
+     * Communicators of the processors sharing the coordinate of
+     * dimension i (slices).
+     */
+    MPI_Comm slice_comm[ROCK_MAX_MESH_ORDER];
+
+    /** Communicator of the processors sharing memory (i.e. a node). */
+    MPI_Comm node_comm;
+
+    /** The rank of the processor within @c node_comm. */
+    rock_uint_t node_rank;
+
+    /** The number of processors of the node. */
+    rock_uint_t node_size;
+
+    /** The number of threads of the processor (its share of the cores). */
+    rock_uint_t num_threads;
+
+    /** The cores of the processor's share (@c num_threads). */
+    rock_uint_t *cores;
+
 } rock_mesh_t;
 
 /**
@@ -85,25 +123,72 @@ typedef struct rock_dist_s
 
 } rock_dist_t;
 
+/**
+ * Statistics object.
+ *
+ * Summarizes the non-zero elements of a tensor distributed over a mesh.
+ */
+typedef struct rock_stat_s
+{
+    /** The total number of non-zero elements (may exceed a rock_uint_t). */
+    uint64_t nnz;
+
+    /** The smallest index used in each dimension. */
+    rock_uint_t dim_min[ROCK_MAX_ORDER];
+
+    /** The largest index used in each dimension. */
+    rock_uint_t dim_max[ROCK_MAX_ORDER];
+
+} rock_stat_t;
+
 /**
  * Initialize a processor mesh object.
  *
  * Represent a logical mesh of processors.
  *
- * You'll probably want the number of processors of the mesh object
- * to match the number of processors you run mpi with, e.g., using
- * mpirun -np num_procs.
+ * The number of processors of the mesh object must match the number
+ * of processors of @c comm, e.g., as set using mpirun -np num_procs.
+ *
+ * A Cartesian topology (allowing MPI to reorder ranks) is created for
+ * the mesh together with communicators for each of its fibers and
+ * slices. Ranks are numbered with dimension 0 varying fastest, which
+ * matches the part numbers of @c rock_part_num_from_mpart.
+ *
+ * The cores of each node are shared evenly by the processors of the
+ * node, such that, e.g., 4 processors x 16 threads don't oversubscribe
+ * a 64 core node. Only the cores the processor may run on count, e.g.,
+ * as restricted by a cpuset or the binding of the launcher. The share
+ * of the processor is stored in the mesh (@c num_threads). Assign it to
+ * @c rock_max_threads to cap every parallel region of the library by
+ * it (the mesh leaves the setting alone). See also @c rock_mesh_bind.
  *
  * @param [in] comm         MPI Comm object to associate mesh with.
  * @param [in] num_dims     The number of dimensions of the processor mesh.
  * @param [in] dim_size     The size of each dimension.
- * @return                  A pointer to the initialized mesh object.
+ * @return                  A pointer to the initialized mesh object, or
+ *                          @c NULL if the mesh doesn't match @c comm.
  */
 rock_mesh_t *
 rock_mesh_init(MPI_Comm comm,
                rock_uint_t num_dims,
                rock_uint_t *dim_size);
 
+/**
+ * Bind the processor to its share of the cores of its node.
+ *
+ * Restricts the processor (and threads created afterwards) to the
+ * cores of the mesh (@c cores), such that the threads of different
+ * processors don't compete for cores.
+ * Should be called before the first parallel region, as threads the
+ * OpenMP runtime already created may keep their old placement.
+ *
+ * @param [in] mesh
+ * @return                  ROCK_OK, or ROCK_ERR if not supported by
+ *                          the platform or refused by the system.
+ */
+int
+rock_mesh_bind(rock_mesh_t *mesh);
+
 /**
  * Initialize a multi-partition object.
  *
@@ -142,6 +227,122 @@ rock_dist_init(rock_indx_t *indx,
                rock_mpart_t *mpart,
                rock_mesh_t *mesh);
 
+/**
+ * Append a batch of new items to an already distributed tensor.
+ *
+ * Every processor may contribute a batch. The items of the batches are
+ * sent directly to their owners according to @c mpart (the one the
+ * tensor is distributed by), which append them to their local arrays.
+ * Only the batches move over the network, the counts and offsets of
+ * @c dist are updated in place.
+ *
+ * The multi-partition (including its descriptor) must be available at
+ * all processors. The number of items sent between any two processors
+ * must fit in an @c int.
+ *
+ * - All: batch buffers deallocated (set to @c NULL), local buffers
+ *   reallocated
+ *
+ * @param [in,out] indx     The local index array, grown by the new items.
+ * @param [in,out] elem     The local element array, grown by the new items.
+ * @param [in,out] new_indx The batch of indices of the processor, or
+ *                          @c NULL if the processor has none.
+ * @param [in,out] new_elem The batch of elements of the processor, or
+ *                          @c NULL if the processor has none.
+ * @param [in] mpart        The multi-partition the tensor is distributed by.
+ * @param [in,out] dist     The distribution the local arrays follow.
+ * @return                  ROCK_OK, or ROCK_BAD_INPUT if the local arrays
+ *                          don't match @c dist or the batch arrays don't
+ *                          match each other (nothing is changed).
+ */
+int
+rock_dist_append(rock_indx_t **indx,
+                 rock_elem_t **elem,
+                 rock_indx_t **new_indx,
+                 rock_elem_t **new_elem,
+                 rock_mpart_t *mpart,
+                 rock_dist_t *dist);
+
+/**
+ * Sample a tensor directly on the processors of a mesh.
+ *
+ * Every processor generates its own share of @c nnz distinct indices
+ * (and elements) in parallel, without the master ever holding the
+ * whole tensor. The linear positions of the tensor are split into one
+ * contiguous range per processor and each processor samples within its
+ * own range only, so no indices have to be compared between processors
+ * to be distinct. Ranges and shares differ by at most one in size.
+ *
+ * The result only depends on @c seed and the number of processors. Use
+ * @c rock_redistribute to distribute the tensor by a multi-partition.
+ *
+ * - All: buffers allocated
+ *
+ * @param [out] indx        The local index array of the processor.
+ * @param [out] elem        The local element array of the processor.
+ * @param [in] desc         The tensor descriptor (at every processor).
+ * @param [in] nnz          The total number of non-zero elements.
+ * @param [in] seed         The seed of the generator (same everywhere).
+ * @param [in] mesh         The mesh to sample the tensor on.
+ * @return                  Distribution object of the sampled tensor, or
+ *                          @c NULL if @c nnz is larger than the tensor.
+ */
+rock_dist_t *
+rock_dist_sample(rock_indx_t **indx,
+                 rock_elem_t **elem,
+                 rock_desc_t *desc,
+                 rock_uint_t nnz,
+                 uint64_t seed,
+                 rock_mesh_t *mesh);
+
+/**
+ * Initialize a distribution object describing local arrays.
+ *
+ * Every processor passes the length of its local arrays, which are
+ * gathered by all processors. Useful to describe arrays produced at
+ * every processor, e.g., before @c rock_redistribute.
+ *
+ * Collective over the mesh.
+ *
+ * @param [in] len          The length of the local arrays.
+ * @param [in] mesh         The mesh the arrays are distributed over.
+ * @return                  Initialized and populated distribution object.
+ */
+rock_dist_t *
+rock_dist_local(rock_uint_t len, rock_mesh_t *mesh);
+
+/**
+ * Redistribute an already distributed tensor according to a new
+ * multi-partition.
+ *
+ * Every processor computes the new owner of each of its local items and
+ * exchanges them directly with all other processors, without funneling
+ * the tensor through the master processor. This makes it cheap to move
+ * between, e.g., mode-specific layouts.
+ *
+ * The new multi-partition (including its descriptor) must be available
+ * at all processors and match the mesh. The number of items exchanged
+ * between any two processors must fit in an @c int.
+ *
+ * - All: buffers replaced
+ *
+ * @param [in,out] indx     The local index array, replaced by the new one.
+ * @param [in,out] elem     The local element array, replaced by the new one.
+ * @param [in] old_dist     The distribution the local arrays follow.
+ * @param [in] new_mpart    The multi-partition to redistribute according to.
+ * @param [in] mesh         The mesh the tensor is distributed over.
+ * @return                  Distribution object of the new layout, or
+ *                          @c NULL at all processors if the local arrays
+ *                          of any processor don't match @c old_dist
+ *                          (nothing is changed).
+ */
+rock_dist_t *
+rock_redistribute(rock_indx_t **indx,
+                  rock_elem_t **elem,
+                  rock_dist_t *old_dist,
+                  rock_mpart_t *new_mpart,
+                  rock_mesh_t *mesh);
+
 /**
  * Free a processor mesh object.
  *
@@ -261,6 +462,125 @@ rock_elem_scatter(rock_elem_t **elem, rock_dist_t *dist);
 void
 rock_elem_gather(rock_elem_t **elem, rock_dist_t *dist);
 
+/**
+ * Scatter an index array among a mesh of processors using a
+ * distribution object, compressing it on the wire.
+ *
+ * Like @c rock_indx_scatter, but the part of each processor is encoded
+ * using @c rock_codec_encode before being sent and decoded straight
+ * into the local index array. Parts are encoded in parallel. Pays off
+ * when the network is the bottleneck and the index array is sorted
+ * (parts of @c rock_dist_init keep the order of the index array).
+ *
+ * Falls back to @c rock_indx_scatter if the encoded array doesn't fit
+ * in an @c int (bytes).
+ *
+ * - Master: buffer deallocated
+ * - All: buffer allocated
+ *
+ * @param [in,out] indx     The index array to scatter from and to.
+ *                          Only master processor should supply this.
+ * @param [in] dist
+ */
+void
+rock_indx_scatter_compressed(rock_indx_t **indx, rock_dist_t *dist);
+
+/**
+ * Gather an index array among a mesh of processors using a
+ * distribution object, compressing it on the wire.
+ *
+ * See @c rock_indx_scatter_compressed for details.
+ *
+ * - Master: buffer allocated
+ * - All: buffer deallocated
+ *
+ * @param [in,out] indx     The index array to gather to and from.
+ *                          All processors in the comm group must supply this.
+ * @param [in] dist
+ */
+void
+rock_indx_gather_compressed(rock_indx_t **indx, rock_dist_t *dist);
+
+/**
+ * Scatter an index and an element array among a mesh of processors
+ * using a distribution object, in bounded-size chunks.
+ *
+ * Chunks of at most @c rock_chunk_len items are streamed using
+ * non-blocking point-to-point messages, with index and element chunks
+ * in flight at the same time and the next round of chunks posted before
+ * the previous one is completed. Since every message is bounded, parts
+ * larger than what an @c int can count are supported.
+ *
+ * - Master: buffers deallocated
+ * - All: buffers allocated
+ *
+ * @param [in,out] indx     The index array to scatter from and to.
+ *                          Only master processor should supply this.
+ * @param [in,out] elem     The element array to scatter from and to.
+ *                          Only master processor should supply this.
+ * @param [in] dist
+ */
+void
+rock_chunk_scatter(rock_indx_t **indx,
+                   rock_elem_t **elem,
+                   rock_dist_t *dist);
+
+/**
+ * Gather an index and an element array among a mesh of processors
+ * using a distribution object, in bounded-size chunks.
+ *
+ * See @c rock_chunk_scatter for details.
+ *
+ * - Master: buffers allocated
+ * - All: buffers deallocated
+ *
+ * @param [in,out] indx     The index array to gather to and from.
+ *                          All processors in the comm group must supply this.
+ * @param [in,out] elem     The element array to gather to and from.
+ *                          All processors in the comm group must supply this.
+ * @param [in] dist
+ */
+void
+rock_chunk_gather(rock_indx_t **indx,
+                  rock_elem_t **elem,
+                  rock_dist_t *dist);
+
+/**
+ * Scatter a tensor among a mesh of processors using a distribution
+ * object.
+ *
+ * Indices and elements of each processor are moved together in one
+ * message described by an MPI struct datatype pointing straight at both
+ * arrays, so nothing is packed and no barrier is needed. The descriptor
+ * is broadcast and every processor ends up with a tensor object holding
+ * its local part.
+ *
+ * - Master: index and element buffers deallocated
+ * - All: tensor allocated (except at master, which keeps its object)
+ *
+ * @param [in,out] tensor   The tensor to scatter from and to.
+ *                          Only master processor should supply this.
+ * @param [in] dist
+ */
+void
+rock_tensor_scatter(rock_tensor_t **tensor, rock_dist_t *dist);
+
+/**
+ * Gather a tensor among a mesh of processors using a distribution
+ * object.
+ *
+ * See @c rock_tensor_scatter for details.
+ *
+ * - Master: index and element buffers allocated
+ * - All: tensor deallocated (except at master, which keeps its object)
+ *
+ * @param [in,out] tensor   The tensor to gather to and from.
+ *                          All processors in the comm group must supply this.
+ * @param [in] dist
+ */
+void
+rock_tensor_gather(rock_tensor_t **tensor, rock_dist_t *dist);
+
 /**
  * Calculate what part of a multi-partition object a specific
  * multi-index corresponds to.
@@ -286,6 +606,31 @@ rock_part_num_from_mpart(rock_mpart_t *mpart,
                          rock_indx_t *indx,
                          rock_uint_t i);
 
+/**
+ * Factor a number of processors into a mesh shape matching a tensor.
+ *
+ * The resulting mesh has one dimension per tensor dimension (use 1 for
+ * unpartitioned dimensions when fewer are wanted). Prime factors of
+ * @c np are assigned, largest first, to the tensor dimension with the
+ * largest block per processor, which keeps the blocks of each processor
+ * close to cubical and thereby the communication volume low. No mesh
+ * dimension gets larger than its tensor dimension.
+ *
+ *     desc->dim_size   1000  1000  10
+ *     np               12
+ *     dim_size         3     4     1
+ *
+ * @param [in] desc         Tensor to shape the mesh after.
+ * @param [in] np           The number of processors.
+ * @param [out] dim_size    The size of each dimension (@c desc->order).
+ * @return                  ROCK_OK or ROCK_BAD_INPUT if the tensor is
+ *                          too small for @c np processors.
+ */
+int
+rock_mesh_shape(rock_desc_t *desc,
+                rock_uint_t np,
+                rock_uint_t *dim_size);
+
 /**
  * Create a multi-partition based on a tensor descriptor.
  *
@@ -307,4 +652,130 @@ rock_mpart_desc_based(rock_desc_t *desc,
                       rock_uint_t num_prio_dims,
                       rock_uint_t *prio_dims);
 
+/**
+ * Create a multi-partition based on index frequencies.
+ *
+ * Like @c rock_mpart_desc_based, but split points of each partitioned
+ * dimension are chosen using @c rock_part_freq_based, such that the
+ * number of non-zero elements is balanced instead of the tensor space.
+ *
+ * The achieved imbalance (see @c rock_mpart_imbalance) is reported
+ * using the index array referenced by @c freq.
+ *
+ * @param [in] freq             Frequencies to base partitions on.
+ * @param [in,out] mpart        An already initialized multi-partition object.
+ * @param [in] num_prio_dims    Number of dimensions in @c desc to partition,
+ *                              uses largest remaining if < @c mpart->order.
+ * @param [in] prio_dims        Indices of dimensions in @c desc to partition.
+ * @param [out] imbalance       The achieved imbalance factor, or @c NULL.
+ */
+int
+rock_mpart_indx_based(rock_freq_t *freq,
+                      rock_mpart_t *mpart,
+                      rock_uint_t num_prio_dims,
+                      rock_uint_t *prio_dims,
+                      double *imbalance);
+
+/**
+ * Calculate the imbalance factor of a multi-partition.
+ *
+ * The imbalance factor is the largest number of non-zero elements of
+ * any part divided by the average number of non-zero elements per part,
+ * where 1.0 means perfectly balanced.
+ *
+ * @param [in] mpart
+ * @param [in] indx         The index array to count parts of.
+ * @return                  The imbalance factor.
+ */
+double
+rock_mpart_imbalance(rock_mpart_t *mpart, rock_indx_t *indx);
+
+/**
+ * Rebalance a distributed tensor using measured per-processor times.
+ *
+ * Counting non-zero elements is only a proxy for the work of a
+ * processor, as the cost per element varies, e.g., with the cache
+ * behavior of its slices. Given the time every processor spent on its
+ * local items (e.g., in the last iteration of a kernel), each item is
+ * assigned the average cost per item of its processor. For every
+ * partitioned dimension, the costs are summed per index over all
+ * processors and the split points (@c dim_part[*]->offset) are moved
+ * towards splitting the total cost evenly.
+ *
+ * Split points move by @c damping times the distance to their target,
+ * use values below 1 to converge without oscillating when the cost per
+ * item depends on the layout. Only items whose owner changes are moved,
+ * using point-to-point messages between the processors concerned.
+ *
+ * Collective over the mesh. The multi-partition (including its
+ * descriptor) must be available at all processors. The number of items
+ * moved between any two processors must fit in an @c int.
+ *
+ * - All: buffers replaced
+ *
+ * @param [in,out] indx     The local index array, replaced by the new one.
+ * @param [in,out] elem     The local element array, replaced by the new one.
+ * @param [in] time         The time the processor spent on its items.
+ * @param [in] damping      The fraction (0 < damping <= 1) of the distance
+ *                          to the target to move split points by.
+ * @param [in,out] mpart    The multi-partition the tensor is distributed
+ *                          by, updated in place.
+ * @param [in,out] dist     The distribution the local arrays follow,
+ *                          updated in place.
+ * @return                  ROCK_OK, or ROCK_BAD_INPUT if the arguments
+ *                          are out of range or the local arrays don't
+ *                          match @c dist (nothing is changed).
+ */
+int
+rock_mpart_rebalance(rock_indx_t **indx,
+                     rock_elem_t **elem,
+                     double time,
+                     double damping,
+                     rock_mpart_t *mpart,
+                     rock_dist_t *dist);
+
+/**
+ * Calculate the imbalance factor of a multi-partition of a tensor
+ * distributed over a mesh.
+ *
+ * Like @c rock_mpart_imbalance, but the parts are counted over the
+ * local index arrays of all processors. Collective over the mesh.
+ *
+ * @param [in] mpart
+ * @param [in] indx         The local index array of the processor.
+ * @param [in] mesh         The mesh the tensor is distributed over.
+ * @return                  The imbalance factor.
+ */
+double
+rock_mpart_imbalance_dist(rock_mpart_t *mpart,
+                          rock_indx_t *indx,
+                          rock_mesh_t *mesh);
+
+/**
+ * Initialize and populate a frequency object of a distributed tensor.
+ *
+ * Each processor counts the indices of its local index array, the
+ * counts are then summed using @c MPI_Allreduce such that every
+ * processor ends up with the frequencies of the whole tensor. Large
+ * dimensions are reduced in segments of at most @c rock_chunk_len.
+ *
+ * The result can be passed to @c rock_mpart_indx_based at every
+ * processor, i.e., without the master ever holding the whole tensor.
+ * Note that @c freq->indx refers to the local index array only, use
+ * @c rock_mpart_imbalance_dist to get the imbalance of the result.
+ *
+ * Collective over the mesh.
+ *
+ * @param [in] desc         The tensor descriptor (at every processor).
+ * @param [in] indx         The local index array of the processor.
+ * @param [in] mesh         The mesh the tensor is distributed over.
+ * @param [out] stat        Global statistics of the tensor, or @c NULL.
+ * @return                  Initialized and populated frequency object.
+ */
+rock_freq_t *
+rock_freq_dist_init(rock_desc_t *desc,
+                    rock_indx_t *indx,
+                    rock_mesh_t *mesh,
+                    rock_stat_t *stat);
+
 #endif
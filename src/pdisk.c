@@ -0,0 +1,514 @@
+/**
+ * @file pdisk.c
+ * @author timoteus <mail@timoteus.se>
+ */
+
+#include "pdisk.h"
+#include "disk.h"
+#include "hdf5.h"
+#include "hdf5_hl.h"
+
+#define PDISK_MAX_FNAME 4096
+
+static void
+pdisk_fname(char *fname, char *prefix, rock_uint_t rank)
+{
+    snprintf(fname, PDISK_MAX_FNAME, "%s.%" PRIu64 ".h5", prefix,
+            (uint64_t) rank);
+}
+
+static int
+pdisk_write(hid_t file_id,
+            const char *name,
+            hid_t type,
+            rock_uint_t len,
+            const void *buf)
+{
+    hsize_t dims[] = {len};
+
+    if (H5LTmake_dataset(file_id, name, 1, dims, type, buf) < 0) {
+        return ROCK_ERR;
+    }
+
+    return ROCK_OK;
+}
+
+static int
+pdisk_len(hid_t file_id, const char *name, rock_uint_t *len)
+{
+    hsize_t dims[1];
+
+    if (H5LTget_dataset_info(file_id, name, dims, NULL, NULL) < 0) {
+        return ROCK_ERR;
+    }
+
+    *len = dims[0];
+
+    return ROCK_OK;
+}
+
+/*
+ * Read a one-dimensional dataset of unsigned integers into a buffer
+ * allocated to fit it.
+ */
+static int
+pdisk_read_uint(hid_t file_id,
+                const char *name,
+                rock_uint_t *len,
+                rock_uint_t **buf)
+{
+    if (pdisk_len(file_id, name, len) != ROCK_OK) {
+        return ROCK_ERR;
+    }
+
+    *buf = calloc(*len + 1, sizeof(rock_uint_t));
+
+    if (H5LTread_dataset(file_id, name, ROCK_UINT_H5T, *buf) < 0) {
+        return ROCK_ERR;
+    }
+
+    return ROCK_OK;
+}
+
+int
+rock_dist_save(rock_indx_t *indx,
+               rock_elem_t *elem,
+               rock_mpart_t *mpart,
+               rock_dist_t *dist,
+               char *prefix)
+{
+    rock_mesh_t *mesh = dist->mesh;
+    rock_desc_t *desc = mpart->desc;
+
+    int valid = indx->len == dist->count[mesh->rank] &&
+            elem->len == indx->len;
+
+    MPI_Allreduce(MPI_IN_PLACE, &valid, 1, MPI_INT, MPI_LAND, mesh->comm);
+    if (!valid) {
+        return ROCK_BAD_INPUT;
+    }
+
+    char fname[PDISK_MAX_FNAME];
+    pdisk_fname(fname, prefix, mesh->rank);
+
+    int status = ROCK_OK;
+    hid_t file_id = H5Fcreate(fname, H5F_ACC_TRUNC, H5P_DEFAULT, H5P_DEFAULT);
+
+    if (file_id < 0) {
+        status = ROCK_ERR;
+    } else {
+        int np = mesh->np;
+        int rank = mesh->rank;
+        rock_uint_t num_parts[ROCK_MAX_MESH_ORDER];
+
+        for (rock_uint_t m = 0; m < mpart->order; m++) {
+            num_parts[m] = mpart->dim_part[m]->num_parts;
+        }
+
+        status |= pdisk_write(file_id, "/indx", ROCK_UINT_H5T, indx->len,
+                indx->v);
+        status |= pdisk_write(file_id, "/elem", ROCK_ELEM_H5T, elem->len,
+                elem->v);
+        status |= pdisk_write(file_id, "/dim_size", ROCK_UINT_H5T,
+                desc->order, desc->dim_size);
+        status |= pdisk_write(file_id, "/dim_num", ROCK_UINT_H5T,
+                mpart->order, mpart->dim_num);
+        status |= pdisk_write(file_id, "/num_parts", ROCK_UINT_H5T,
+                mpart->order, num_parts);
+        status |= pdisk_write(file_id, "/count", ROCK_UINT_H5T, mesh->np,
+                dist->count);
+
+        for (rock_uint_t m = 0; m < mpart->order; m++) {
+            char name[64];
+            snprintf(name, sizeof(name), "/offset_%" PRIu64, (uint64_t) m);
+            status |= pdisk_write(file_id, name, ROCK_UINT_H5T,
+                    num_parts[m] + 1, mpart->dim_part[m]->offset);
+        }
+
+        if (H5LTset_attribute_int(file_id, "/", "np", &np, 1) < 0 ||
+                H5LTset_attribute_int(file_id, "/", "rank", &rank, 1) < 0) {
+            status = ROCK_ERR;
+        }
+
+        if (H5Fclose(file_id) < 0) {
+            status = ROCK_ERR;
+        }
+    }
+
+    /* Everyone fails if anyone fails. */
+    status = (status == ROCK_OK) ? ROCK_OK : ROCK_ERR;
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, mesh->comm);
+
+    return status;
+}
+
+/*
+ * Read the tensor descriptor, the multi-partition and the counts of
+ * a checkpoint file.
+ */
+static int
+pdisk_read_meta(char *fname,
+                rock_uint_t *np,
+                rock_desc_t **desc,
+                rock_mpart_t **mpart,
+                rock_uint_t **count)
+{
+    hid_t file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file_id < 0) {
+        return ROCK_ERR;
+    }
+
+    int status = ROCK_OK;
+    int saved_np = 0;
+    rock_uint_t order = 0, mpart_order = 0, num_parts_len = 0, count_len = 0;
+    rock_uint_t *dim_size = NULL, *dim_num = NULL, *num_parts = NULL;
+
+    status |= pdisk_read_uint(file_id, "/dim_size", &order, &dim_size);
+    status |= pdisk_read_uint(file_id, "/dim_num", &mpart_order, &dim_num);
+    status |= pdisk_read_uint(file_id, "/num_parts", &num_parts_len,
+            &num_parts);
+    status |= pdisk_read_uint(file_id, "/count", &count_len, count);
+
+    if (H5LTget_attribute_int(file_id, "/", "np", &saved_np) < 0 ||
+            saved_np <= 0 || (rock_uint_t) saved_np != count_len ||
+            order == 0 || order > ROCK_MAX_ORDER ||
+            mpart_order == 0 || mpart_order > ROCK_MAX_MESH_ORDER ||
+            num_parts_len != mpart_order) {
+        status = ROCK_ERR;
+    }
+
+    /* The partitioned dimensions index the descriptor. */
+    for (rock_uint_t m = 0; m < mpart_order && status == ROCK_OK; m++) {
+        if (dim_num[m] >= order) {
+            status = ROCK_ERR;
+        }
+    }
+
+    if (status == ROCK_OK) {
+        *np = saved_np;
+        *desc = rock_desc_init(order, dim_size);
+        *mpart = rock_mpart_init(mpart_order, num_parts);
+        (*mpart)->desc = *desc;
+
+        for (rock_uint_t m = 0; m < mpart_order && status == ROCK_OK; m++) {
+            char name[64];
+            rock_uint_t len;
+            rock_uint_t *offset = NULL;
+
+            snprintf(name, sizeof(name), "/offset_%" PRIu64, (uint64_t) m);
+            status |= pdisk_read_uint(file_id, name, &len, &offset);
+            if (status == ROCK_OK && len == num_parts[m] + 1) {
+                memcpy((*mpart)->dim_part[m]->offset, offset,
+                        len * sizeof(rock_uint_t));
+            } else {
+                status = ROCK_ERR;
+            }
+            (*mpart)->dim_num[m] = dim_num[m];
+
+            free(offset);
+        }
+    }
+
+    if (H5Fclose(file_id) < 0) {
+        status = ROCK_ERR;
+    }
+
+    free(dim_size);
+    free(dim_num);
+    free(num_parts);
+
+    return (status == ROCK_OK) ? ROCK_OK : ROCK_ERR;
+}
+
+/*
+ * Read the local arrays of a checkpoint file, appending them to the
+ * given arrays.
+ */
+static int
+pdisk_read_arrays(char *fname, rock_indx_t *indx, rock_elem_t *elem)
+{
+    hid_t file_id = H5Fopen(fname, H5F_ACC_RDONLY, H5P_DEFAULT);
+    if (file_id < 0) {
+        return ROCK_ERR;
+    }
+
+    int status = ROCK_OK;
+    rock_uint_t len, elem_len;
+
+    status |= pdisk_len(file_id, "/indx", &len);
+    status |= pdisk_len(file_id, "/elem", &elem_len);
+
+    if (status == ROCK_OK && len == elem_len) {
+        rock_uint_t old_len = indx->len;
+
+        indx->v = realloc(indx->v, (old_len + len + 1) * sizeof(rock_uint_t));
+        elem->v = realloc(elem->v,
+                (old_len + len + 1) * ROCK_ELEM_SIZE);
+
+        if (H5LTread_dataset(file_id, "/indx", ROCK_UINT_H5T,
+                    &indx->v[old_len]) < 0 ||
+                H5LTread_dataset(file_id, "/elem", ROCK_ELEM_H5T,
+                    &elem->v[old_len]) < 0) {
+            status = ROCK_ERR;
+        }
+
+        indx->len = old_len + len;
+        elem->len = old_len + len;
+    } else {
+        status = ROCK_ERR;
+    }
+
+    if (H5Fclose(file_id) < 0) {
+        status = ROCK_ERR;
+    }
+
+    return (status == ROCK_OK) ? ROCK_OK : ROCK_ERR;
+}
+
+rock_dist_t *
+rock_dist_load(rock_indx_t **indx,
+               rock_elem_t **elem,
+               rock_desc_t **desc,
+               rock_mpart_t **mpart,
+               rock_mesh_t *mesh,
+               char *prefix)
+{
+    char fname[PDISK_MAX_FNAME];
+    rock_uint_t old_np = 0;
+    rock_uint_t *count = NULL;
+
+    *desc = NULL;
+    *mpart = NULL;
+
+    /* Every file holds the metadata, read the one of rank 0. */
+    pdisk_fname(fname, prefix, 0);
+    int status = pdisk_read_meta(fname, &old_np, desc, mpart, &count);
+
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, mesh->comm);
+    if (status != ROCK_OK) {
+        if (*desc) {
+            rock_mpart_free(*mpart);
+            rock_desc_free(*desc);
+        }
+        free(count);
+        return NULL;
+    }
+
+    bool same = old_np == mesh->np && (*mpart)->order == mesh->order;
+    for (rock_uint_t m = 0; same && m < mesh->order; m++) {
+        same = (*mpart)->dim_part[m]->num_parts == mesh->dim_size[m];
+    }
+
+    /* Read own file, or share the files round-robin. */
+    *indx = rock_indx_init(0);
+    *elem = rock_elem_init(0);
+
+    rock_uint_t step = same ? old_np : mesh->np;
+    for (rock_uint_t f = mesh->rank; f < old_np; f += step) {
+        pdisk_fname(fname, prefix, f);
+        if (pdisk_read_arrays(fname, *indx, *elem) != ROCK_OK) {
+            status = ROCK_ERR;
+        }
+    }
+
+    if (same && (*indx)->len != count[mesh->rank]) {
+        status = ROCK_ERR;
+    }
+
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, mesh->comm);
+    free(count);
+
+    rock_dist_t *dist = NULL;
+
+    if (status == ROCK_OK) {
+        dist = rock_dist_local((*indx)->len, mesh);
+    }
+
+    if (status == ROCK_OK && !same) {
+        /* Partition the same dimensions first, balanced by nnz. */
+        rock_mpart_t *old_mpart = *mpart;
+        rock_uint_t num_prio_dims = (old_mpart->order < mesh->order) ?
+                old_mpart->order : mesh->order;
+
+        rock_freq_t *freq = rock_freq_dist_init(*desc, *indx, mesh, NULL);
+        *mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+        status = rock_mpart_indx_based(freq, *mpart, num_prio_dims,
+                old_mpart->dim_num, NULL);
+
+        rock_freq_free(freq);
+        rock_mpart_free(old_mpart);
+
+        if (status == ROCK_OK) {
+            rock_dist_t *old_dist = dist;
+            dist = rock_redistribute(indx, elem, old_dist, *mpart, mesh);
+            rock_dist_free(old_dist);
+        }
+    }
+
+    if (status != ROCK_OK) {
+        if (dist) {
+            rock_dist_free(dist);
+        }
+        rock_indx_free(*indx);
+        rock_elem_free(*elem);
+        rock_mpart_free(*mpart);
+        rock_desc_free(*desc);
+        *indx = NULL;
+        *elem = NULL;
+        *mpart = NULL;
+        *desc = NULL;
+        return NULL;
+    }
+
+    return dist;
+}
+
+/*
+ * Read the block of a one-dimensional dataset belonging to a processor,
+ * sharing the dataset evenly between all processors of the mesh.
+ */
+static int
+pdisk_read_block(char *fname,
+                 const char *name,
+                 hid_t type,
+                 size_t item_size,
+                 rock_mesh_t *mesh,
+                 rock_uint_t *len,
+                 void **buf)
+{
+    hid_t fapl_id = H5P_DEFAULT;
+    hid_t dxpl_id = H5P_DEFAULT;
+
+#ifdef H5_HAVE_PARALLEL
+    fapl_id = H5Pcreate(H5P_FILE_ACCESS);
+    H5Pset_fapl_mpio(fapl_id, mesh->comm, MPI_INFO_NULL);
+    dxpl_id = H5Pcreate(H5P_DATASET_XFER);
+    H5Pset_dxpl_mpio(dxpl_id, H5FD_MPIO_COLLECTIVE);
+#endif
+
+    /* The file may be saved using ROCK_SAVE_BITPACK. */
+    rock_filter_register();
+
+    int status = ROCK_OK;
+    hid_t file_id = H5Fopen(fname, H5F_ACC_RDONLY, fapl_id);
+    hid_t dset_id = (file_id < 0) ? -1 : H5Dopen2(file_id, name, H5P_DEFAULT);
+    hid_t space_id = (dset_id < 0) ? -1 : H5Dget_space(dset_id);
+    hsize_t dims[1] = {0};
+
+    *len = 0;
+    *buf = NULL;
+
+    if (space_id < 0 || H5Sget_simple_extent_ndims(space_id) != 1) {
+        status = ROCK_ERR;
+    } else {
+        H5Sget_simple_extent_dims(space_id, dims, NULL);
+
+        rock_uint_t np = mesh->np;
+        rock_uint_t p = mesh->rank;
+        hsize_t start[1] = {dims[0] / np * p + ((p < dims[0] % np) ?
+                p : dims[0] % np)};
+        hsize_t count[1] = {dims[0] / np + ((p < dims[0] % np) ? 1 : 0)};
+
+        hid_t mem_id = H5Screate_simple(1, count, NULL);
+        if (count[0] > 0) {
+            H5Sselect_hyperslab(space_id, H5S_SELECT_SET, start, NULL,
+                    count, NULL);
+        } else {
+            H5Sselect_none(space_id);
+            H5Sselect_none(mem_id);
+        }
+
+        *len = count[0];
+        *buf = malloc((count[0] + 1) * item_size);
+
+        /* Called by all, collective transfers require it. */
+        if (H5Dread(dset_id, type, mem_id, space_id, dxpl_id, *buf) < 0) {
+            status = ROCK_ERR;
+        }
+
+        H5Sclose(mem_id);
+    }
+
+    if (space_id >= 0) {
+        H5Sclose(space_id);
+    }
+    if (dset_id >= 0) {
+        H5Dclose(dset_id);
+    }
+    if (file_id < 0 || H5Fclose(file_id) < 0) {
+        status = ROCK_ERR;
+    }
+
+#ifdef H5_HAVE_PARALLEL
+    H5Pclose(fapl_id);
+    H5Pclose(dxpl_id);
+#endif
+
+    return status;
+}
+
+rock_dist_t *
+rock_dist_load_shared(rock_indx_t **indx,
+                      rock_elem_t **elem,
+                      rock_desc_t *desc,
+                      rock_mpart_t *mpart,
+                      rock_mesh_t *mesh,
+                      char *indx_fname,
+                      char *elem_fname)
+{
+    rock_uint_t indx_len, elem_len;
+    void *indx_buf, *elem_buf;
+
+    int status = ROCK_OK;
+    status |= pdisk_read_block(indx_fname, "/indx", ROCK_UINT_H5T,
+            sizeof(rock_uint_t), mesh, &indx_len, &indx_buf);
+    status |= pdisk_read_block(elem_fname, "/elem", ROCK_ELEM_H5T,
+            ROCK_ELEM_SIZE, mesh, &elem_len, &elem_buf);
+
+    if (indx_len != elem_len) {
+        status = ROCK_ERR;
+    }
+
+    status = (status == ROCK_OK) ? ROCK_OK : ROCK_ERR;
+    MPI_Allreduce(MPI_IN_PLACE, &status, 1, MPI_INT, MPI_MIN, mesh->comm);
+
+    if (status != ROCK_OK) {
+        free(indx_buf);
+        free(elem_buf);
+        *indx = NULL;
+        *elem = NULL;
+        return NULL;
+    }
+
+    /* Wrap the blocks read. */
+    *indx = rock_indx_init(0);
+    *elem = rock_elem_init(0);
+    free((*indx)->v);
+    free((*elem)->v);
+    (*indx)->v = indx_buf;
+    (*indx)->len = indx_len;
+    (*elem)->v = elem_buf;
+    (*elem)->len = elem_len;
+
+    if (mpart->desc == NULL) {
+        rock_freq_t *freq = rock_freq_dist_init(desc, *indx, mesh, NULL);
+        status = rock_mpart_indx_based(freq, mpart, 0, NULL, NULL);
+        rock_freq_free(freq);
+
+        if (status != ROCK_OK) {
+            rock_indx_free(*indx);
+            rock_elem_free(*elem);
+            *indx = NULL;
+            *elem = NULL;
+            return NULL;
+        }
+    }
+
+    /* Move the items to their owners. */
+    rock_dist_t *block_dist = rock_dist_local(indx_len, mesh);
+    rock_dist_t *dist = rock_redistribute(indx, elem, block_dist, mpart,
+            mesh);
+    rock_dist_free(block_dist);
+
+    return dist;
+}
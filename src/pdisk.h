@@ -0,0 +1,127 @@
+/**
+ * @file pdisk.h
+ * @author timoteus <mail@timoteus.se>
+ *
+ * Checkpoint and restart of distributed tensors. Every processor saves
+ * its local index and element arrays to a file of its own, named
+ * <prefix>.<rank>.h5, without funneling the tensor through the master
+ * processor. Each file also holds what is needed to restart:
+ *
+ *     /indx, /elem         The local arrays of the processor.
+ *     /dim_size            The dimension sizes of the tensor.
+ *     /dim_num             The partitioned dimensions of the mpart.
+ *     /num_parts           The number of parts of each of them.
+ *     /offset_<m>          The split points of partitioned dimension m.
+ *     /count               The number of items of every processor.
+ *     np, rank             The number of processors and the rank
+ *                          (attributes of the root group).
+ *
+ * Tensors saved to a single pair of files by @c rock_indx_save and
+ * @c rock_elem_save can also be loaded directly into a distributed
+ * layout, every processor reading a contiguous block of the files.
+ */
+
+#ifndef _PDISK_H
+#define _PDISK_H
+
+#include "core.h"
+#include "distribute.h"
+
+/**
+ * Save a distributed tensor (checkpoint).
+ *
+ * Collective over the mesh of @c dist, every processor writes its own
+ * file.
+ *
+ * @param [in] indx         The local index array of the processor.
+ * @param [in] elem         The local element array of the processor.
+ * @param [in] mpart        The multi-partition the tensor is distributed
+ *                          by (including its descriptor).
+ * @param [in] dist         The distribution the local arrays follow.
+ * @param [in] prefix       The prefix of the file names.
+ * @return                  ROCK_OK, ROCK_BAD_INPUT if the local arrays
+ *                          don't match @c dist, or ROCK_ERR if any
+ *                          processor failed to write its file.
+ */
+int
+rock_dist_save(rock_indx_t *indx,
+               rock_elem_t *elem,
+               rock_mpart_t *mpart,
+               rock_dist_t *dist,
+               char *prefix);
+
+/**
+ * Load a distributed tensor saved by @c rock_dist_save (restart).
+ *
+ * If the tensor was saved by the same number of processors using a
+ * multi-partition matching @c mesh, every processor reads its own file
+ * and the saved multi-partition and distribution are restored.
+ *
+ * Otherwise, the files are shared round-robin by the processors and a
+ * new multi-partition matching @c mesh is created from the distributed
+ * frequencies of the tensor (see @c rock_freq_dist_init and
+ * @c rock_mpart_indx_based), partitioning the same dimensions first.
+ * The tensor is then moved directly between processors using
+ * @c rock_redistribute, i.e., without @c rock_dist_init at the master.
+ *
+ * Collective over the mesh.
+ *
+ * - All: buffers and objects allocated
+ *
+ * @param [out] indx        The local index array of the processor.
+ * @param [out] elem        The local element array of the processor.
+ * @param [out] desc        The tensor descriptor.
+ * @param [out] mpart       The multi-partition the tensor is distributed
+ *                          by (referring to @c desc).
+ * @param [in] mesh         The mesh to distribute the tensor over.
+ * @param [in] prefix       The prefix of the file names.
+ * @return                  Distribution object of the local arrays, or
+ *                          @c NULL if any processor failed to read.
+ */
+rock_dist_t *
+rock_dist_load(rock_indx_t **indx,
+               rock_elem_t **elem,
+               rock_desc_t **desc,
+               rock_mpart_t **mpart,
+               rock_mesh_t *mesh,
+               char *prefix);
+
+/**
+ * Load a tensor saved by @c rock_indx_save and @c rock_elem_save
+ * directly into a distributed layout.
+ *
+ * Every processor reads a contiguous block (hyperslab) of the files,
+ * collectively through MPI-IO if HDF5 was built with parallel support
+ * and by independent reads otherwise. The items are then moved to
+ * their owners according to @c mpart. The master never holds the
+ * whole tensor.
+ *
+ * If @c mpart is not populated yet (has no descriptor), it is
+ * populated from the distributed frequencies of the loaded indices,
+ * see @c rock_mpart_indx_based.
+ *
+ * Collective over the mesh.
+ *
+ * - All: buffers allocated
+ *
+ * @param [out] indx        The local index array of the processor.
+ * @param [out] elem        The local element array of the processor.
+ * @param [in] desc         The tensor descriptor.
+ * @param [in,out] mpart    The multi-partition to distribute by,
+ *                          available at all processors.
+ * @param [in] mesh         The mesh to distribute the tensor over.
+ * @param [in] indx_fname   The file saved by @c rock_indx_save.
+ * @param [in] elem_fname   The file saved by @c rock_elem_save.
+ * @return                  Distribution object of the local arrays, or
+ *                          @c NULL if any processor failed to read.
+ */
+rock_dist_t *
+rock_dist_load_shared(rock_indx_t **indx,
+                      rock_elem_t **elem,
+                      rock_desc_t *desc,
+                      rock_mpart_t *mpart,
+                      rock_mesh_t *mesh,
+                      char *indx_fname,
+                      char *elem_fname);
+
+#endif
@@ -0,0 +1,401 @@
+/**
+ * @file plan.c
+ * @author timoteus <mail@timoteus.se>
+ */
+
+#include "plan.h"
+#include "profile.h"
+#include "sort.h"
+
+/*
+ * Find the partitioned dimension of a multi-partition that corresponds
+ * to a tensor dimension, ROCK_UINT_MAX if not partitioned.
+ */
+static rock_uint_t
+plan_mpart_dim(rock_mpart_t *mpart, rock_uint_t dim)
+{
+    for (rock_uint_t m = 0; m < mpart->order; m++) {
+        if (mpart->dim_num[m] == dim) {
+            return m;
+        }
+    }
+
+    return ROCK_UINT_MAX;
+}
+
+/*
+ * The distance between the ranks of two processors whose coordinates
+ * differ by one in mesh dimension m.
+ */
+static rock_uint_t
+plan_stride(rock_mpart_t *mpart, rock_uint_t m)
+{
+    rock_uint_t stride = 1;
+
+    for (rock_uint_t i = 0; i < m; i++) {
+        stride *= mpart->dim_part[i]->num_parts;
+    }
+
+    return stride;
+}
+
+/*
+ * Calculate the processor owning a row of a dimension.
+ *
+ * The rows of part k of partitioned mesh dimension m are split in
+ * contiguous blocks over the processors with coordinate k (in order of
+ * rank). The rows of other dimensions are split over all processors.
+ */
+static rock_uint_t
+plan_row_owner(rock_desc_t *desc,
+               rock_mpart_t *mpart,
+               rock_uint_t np,
+               rock_uint_t dim,
+               rock_uint_t row)
+{
+    rock_uint_t m = plan_mpart_dim(mpart, dim);
+
+    if (m == ROCK_UINT_MAX) {
+        return (uint64_t) row * np / desc->dim_size[dim];
+    }
+
+    rock_part_t *part = mpart->dim_part[m];
+    rock_uint_t k = rock_part_find(part, row);
+    rock_uint_t first = part->offset[k];
+    rock_uint_t len = part->offset[k+1] - first;
+    rock_uint_t num_procs = np / part->num_parts;
+    rock_uint_t stride = plan_stride(mpart, m);
+
+    /* The block of the row, i.e., the b-th processor with coordinate k. */
+    rock_uint_t b = (uint64_t) (row - first) * num_procs / len;
+
+    return (b / stride) * stride * part->num_parts + k * stride + b % stride;
+}
+
+/*
+ * Calculate the range of rows of a dimension owned by this processor,
+ * see plan_row_owner.
+ */
+static void
+plan_own_range(rock_desc_t *desc,
+               rock_mpart_t *mpart,
+               rock_mesh_t *mesh,
+               rock_uint_t dim,
+               rock_uint_t *offset,
+               rock_uint_t *len)
+{
+    rock_uint_t m = plan_mpart_dim(mpart, dim);
+    rock_uint_t first, num_rows, num_procs, b;
+
+    if (m == ROCK_UINT_MAX) {
+        first = 0;
+        num_rows = desc->dim_size[dim];
+        num_procs = mesh->np;
+        b = mesh->rank;
+    } else {
+        rock_part_t *part = mpart->dim_part[m];
+        rock_uint_t k = mesh->coord[m];
+        rock_uint_t stride = plan_stride(mpart, m);
+
+        first = part->offset[k];
+        num_rows = part->offset[k+1] - first;
+        num_procs = mesh->np / part->num_parts;
+        b = mesh->rank % stride + stride *
+                (mesh->rank / (stride * part->num_parts));
+    }
+
+    /* Rows r with floor(r * num_procs / num_rows) == b. */
+    rock_uint_t begin = ((uint64_t) b * num_rows + num_procs - 1) / num_procs;
+    rock_uint_t end =
+            ((uint64_t) (b + 1) * num_rows + num_procs - 1) / num_procs;
+
+    *offset = first + begin;
+    *len = end - begin;
+}
+
+/*
+ * Collect the distinct indices of a dimension of an index array in
+ * increasing order using a one-dimensional sort.
+ */
+static rock_uint_t *
+plan_uniq(rock_desc_t *desc,
+          rock_indx_t *indx,
+          rock_uint_t dim,
+          rock_uint_t *num_uniq)
+{
+    rock_indx_t *vals = rock_indx_init(indx->len);
+
+    #pragma omp parallel for num_threads(rock_thread_count(indx->len))
+    for (rock_uint_t i = 0; i < indx->len; i++) {
+        vals->v[i] = rock_indx_extract(desc, indx, i, dim);
+    }
+
+    rock_uint_t dim_size[] = {desc->dim_size[dim]};
+    rock_uint_t dims[] = {0};
+    rock_desc_t *vals_desc = rock_desc_init(1, dim_size);
+
+    rock_indx_sort(vals_desc, 1, dims, NULL, vals);
+
+    rock_uint_t n = 0;
+    for (rock_uint_t i = 0; i < vals->len; i++) {
+        if (i == 0 || vals->v[i] != vals->v[n-1]) {
+            vals->v[n++] = vals->v[i];
+        }
+    }
+
+    rock_uint_t *uniq = malloc(n * sizeof(rock_uint_t));
+    memcpy(uniq, vals->v, n * sizeof(rock_uint_t));
+    *num_uniq = n;
+
+    rock_desc_free(vals_desc);
+    rock_indx_free(vals);
+
+    return uniq;
+}
+
+static inline rock_uint_t
+plan_total(int *count, int *displ, rock_uint_t np)
+{
+    return displ[np-1] + count[np-1];
+}
+
+/*
+ * Add the rows and messages exchanged with other processors in one
+ * all-to-all exchange, see profile.h.
+ */
+static void
+plan_traffic(int *send_count,
+             int *recv_count,
+             rock_mesh_t *mesh,
+             uint64_t *rows,
+             uint64_t *msgs)
+{
+    for (rock_uint_t p = 0; p < mesh->np; p++) {
+        if (p != mesh->rank) {
+            *rows += send_count[p] + recv_count[p];
+            *msgs += (send_count[p] > 0) + (recv_count[p] > 0);
+        }
+    }
+}
+
+rock_comm_plan_t *
+rock_comm_plan_init(rock_desc_t *desc,
+                    rock_indx_t *indx,
+                    rock_mpart_t *mpart,
+                    rock_mesh_t *mesh,
+                    rock_uint_t num_cols)
+{
+    double start = rock_prof_start();
+    uint64_t rows = 0;
+    uint64_t msgs = 0;
+
+    rock_comm_plan_t *plan = calloc(1, sizeof(rock_comm_plan_t));
+    rock_uint_t np = mesh->np;
+    rock_uint_t max_rows = 0;
+
+    for (rock_uint_t d = 0; d < desc->order; d++) {
+        plan_own_range(desc, mpart, mesh, d,
+                &plan->own_offset[d], &plan->own_len[d]);
+
+        rock_uint_t num_uniq;
+        rock_uint_t *uniq = plan_uniq(desc, indx, d, &num_uniq);
+
+        /* Group the distinct indices by owner (stable, rows increasing). */
+        rock_uint_t *owner = malloc(num_uniq * sizeof(rock_uint_t));
+        int *recv_count = calloc(np, sizeof(int));
+        int *recv_displ = calloc(np, sizeof(int));
+
+        for (rock_uint_t i = 0; i < num_uniq; i++) {
+            owner[i] = plan_row_owner(desc, mpart, np, d, uniq[i]);
+            recv_count[owner[i]]++;
+        }
+        for (rock_uint_t p = 1; p < np; p++) {
+            recv_displ[p] = recv_displ[p-1] + recv_count[p-1];
+        }
+
+        rock_uint_t *recv_pos = malloc(num_uniq * sizeof(rock_uint_t));
+        rock_uint_t *request = malloc(num_uniq * sizeof(rock_uint_t));
+        int *next = malloc(np * sizeof(int));
+        memcpy(next, recv_displ, np * sizeof(int));
+
+        for (rock_uint_t i = 0; i < num_uniq; i++) {
+            int pos = next[owner[i]]++;
+            recv_pos[pos] = i;
+            request[pos] = uniq[i];
+        }
+
+        /* Tell the owners what rows are requested from them. */
+        int *send_count = calloc(np, sizeof(int));
+        int *send_displ = calloc(np, sizeof(int));
+
+        MPI_Alltoall(recv_count, 1, MPI_INT, send_count, 1, MPI_INT,
+                mesh->comm);
+        for (rock_uint_t p = 1; p < np; p++) {
+            send_displ[p] = send_displ[p-1] + send_count[p-1];
+        }
+
+        rock_uint_t num_send = plan_total(send_count, send_displ, np);
+        rock_uint_t *send_rows = malloc(num_send * sizeof(rock_uint_t));
+
+        MPI_Alltoallv(request, recv_count, recv_displ, ROCK_UINT_MPI,
+                send_rows, send_count, send_displ, ROCK_UINT_MPI, mesh->comm);
+
+        for (rock_uint_t i = 0; i < num_send; i++) {
+            send_rows[i] -= plan->own_offset[d];
+        }
+
+        plan_traffic(send_count, recv_count, mesh, &rows, &msgs);
+
+        max_rows = (num_send > max_rows) ? num_send : max_rows;
+        max_rows = (num_uniq > max_rows) ? num_uniq : max_rows;
+
+        plan->num_uniq[d] = num_uniq;
+        plan->uniq[d] = uniq;
+        plan->recv_count[d] = recv_count;
+        plan->recv_displ[d] = recv_displ;
+        plan->recv_pos[d] = recv_pos;
+        plan->send_count[d] = send_count;
+        plan->send_displ[d] = send_displ;
+        plan->send_rows[d] = send_rows;
+
+        free(owner);
+        free(request);
+        free(next);
+    }
+
+    plan->send_buf = rock_elem_init(max_rows * num_cols);
+    plan->recv_buf = rock_elem_init(max_rows * num_cols);
+
+    MPI_Type_contiguous(num_cols, ROCK_ELEM_MPI, &plan->row_type);
+    MPI_Type_commit(&plan->row_type);
+
+    plan->mesh = mesh;
+    plan->order = desc->order;
+    plan->num_cols = num_cols;
+
+    /* Row numbers are requested, not rows. */
+    rock_prof_stop(ROCK_PROF_COMM_PLAN_INIT, start,
+            rows * sizeof(rock_uint_t), msgs);
+
+    return plan;
+}
+
+void
+rock_comm_plan_free(rock_comm_plan_t *plan)
+{
+    for (rock_uint_t d = 0; d < plan->order; d++) {
+        free(plan->uniq[d]);
+        free(plan->recv_count[d]);
+        free(plan->recv_displ[d]);
+        free(plan->recv_pos[d]);
+        free(plan->send_count[d]);
+        free(plan->send_displ[d]);
+        free(plan->send_rows[d]);
+    }
+
+    rock_elem_free(plan->send_buf);
+    rock_elem_free(plan->recv_buf);
+    MPI_Type_free(&plan->row_type);
+
+    free(plan);
+}
+
+int
+rock_comm_plan_exchange(rock_comm_plan_t *plan,
+                        rock_uint_t dim,
+                        rock_elem_t *owned,
+                        rock_elem_t *needed)
+{
+    if (dim >= plan->order) {
+        return ROCK_BAD_INPUT;
+    }
+
+    double start = rock_prof_start();
+
+    rock_uint_t np = plan->mesh->np;
+    rock_uint_t cols = plan->num_cols;
+    size_t row_size = cols * sizeof(*owned->v);
+
+    rock_uint_t num_send =
+            plan_total(plan->send_count[dim], plan->send_displ[dim], np);
+    rock_uint_t num_recv =
+            plan_total(plan->recv_count[dim], plan->recv_displ[dim], np);
+
+    /* Pack requested rows. */
+    #pragma omp parallel for num_threads(rock_thread_count(num_send * cols))
+    for (rock_uint_t i = 0; i < num_send; i++) {
+        memcpy(&plan->send_buf->v[i * cols],
+                &owned->v[plan->send_rows[dim][i] * cols], row_size);
+    }
+
+    MPI_Alltoallv(plan->send_buf->v, plan->send_count[dim],
+            plan->send_displ[dim], plan->row_type,
+            plan->recv_buf->v, plan->recv_count[dim],
+            plan->recv_displ[dim], plan->row_type, plan->mesh->comm);
+
+    /* Unpack rows in the order of the distinct indices. */
+    #pragma omp parallel for num_threads(rock_thread_count(num_recv * cols))
+    for (rock_uint_t i = 0; i < num_recv; i++) {
+        memcpy(&needed->v[plan->recv_pos[dim][i] * cols],
+                &plan->recv_buf->v[i * cols], row_size);
+    }
+
+    uint64_t rows = 0;
+    uint64_t msgs = 0;
+    plan_traffic(plan->send_count[dim], plan->recv_count[dim], plan->mesh,
+            &rows, &msgs);
+    rock_prof_stop(ROCK_PROF_COMM_PLAN_EXCHANGE, start, rows * row_size, msgs);
+
+    return ROCK_OK;
+}
+
+int
+rock_comm_plan_reduce(rock_comm_plan_t *plan,
+                      rock_uint_t dim,
+                      rock_elem_t *needed,
+                      rock_elem_t *owned)
+{
+    if (dim >= plan->order) {
+        return ROCK_BAD_INPUT;
+    }
+
+    double start = rock_prof_start();
+
+    rock_uint_t np = plan->mesh->np;
+    rock_uint_t cols = plan->num_cols;
+    size_t row_size = cols * sizeof(*owned->v);
+
+    rock_uint_t num_send =
+            plan_total(plan->send_count[dim], plan->send_displ[dim], np);
+    rock_uint_t num_recv =
+            plan_total(plan->recv_count[dim], plan->recv_displ[dim], np);
+
+    /* Pack partial rows grouped by owner. */
+    #pragma omp parallel for num_threads(rock_thread_count(num_recv * cols))
+    for (rock_uint_t i = 0; i < num_recv; i++) {
+        memcpy(&plan->recv_buf->v[i * cols],
+                &needed->v[plan->recv_pos[dim][i] * cols], row_size);
+    }
+
+    /* Same exchange as rock_comm_plan_exchange, in reverse. */
+    MPI_Alltoallv(plan->recv_buf->v, plan->recv_count[dim],
+            plan->recv_displ[dim], plan->row_type,
+            plan->send_buf->v, plan->send_count[dim],
+            plan->send_displ[dim], plan->row_type, plan->mesh->comm);
+
+    /* Rows may arrive from several processors, sum them in order. */
+    for (rock_uint_t i = 0; i < num_send; i++) {
+        rock_uint_t row = plan->send_rows[dim][i];
+        for (rock_uint_t c = 0; c < cols; c++) {
+            owned->v[row * cols + c] += plan->send_buf->v[i * cols + c];
+        }
+    }
+
+    uint64_t rows = 0;
+    uint64_t msgs = 0;
+    plan_traffic(plan->send_count[dim], plan->recv_count[dim], plan->mesh,
+            &rows, &msgs);
+    rock_prof_stop(ROCK_PROF_COMM_PLAN_REDUCE, start, rows * row_size, msgs);
+
+    return ROCK_OK;
+}
@@ -0,0 +1,157 @@
+/**
+ * @file plan.h
+ * @author timoteus <mail@timoteus.se>
+ *
+ * Kernels such as MTTKRP running on a distributed tensor need, for each
+ * dimension, the rows of a factor matrix matching the indices of their
+ * local non-zero elements. The rows are owned by (distributed over) the
+ * processors of the mesh:
+ *
+ *   - The rows of a dimension partitioned by @c rock_mpart_t are owned
+ *     by the processors holding the corresponding part, each owning a
+ *     contiguous block of the part's rows.
+ *   - The rows of a dimension not partitioned are owned by all
+ *     processors, each owning a contiguous block of rows.
+ *
+ * A communication plan (@c rock_comm_plan_t) lists, per dimension, the
+ * distinct local indices together with what rows to send to and
+ * receive from each processor. The plan is computed once and reused
+ * every iteration:
+ *
+ *         owned rows                         needed rows
+ *     +---------------+                  +---------------+
+ *     | own_offset    |  --- exchange -> | uniq[0]       |
+ *     | ...           |                  | uniq[1]       |
+ *     | own_len rows  |  <--- reduce --- | ...           |
+ *     +---------------+                  +---------------+
+ */
+
+#ifndef _PLAN_H
+#define _PLAN_H
+
+#include "core.h"
+#include "distribute.h"
+
+/**
+ * Communication plan object.
+ *
+ * Represents the exchange of factor matrix rows needed by the local
+ * non-zero elements of each processor.
+ */
+typedef struct rock_comm_plan_s
+{
+    /** Reference to mesh object (not owned). */
+    rock_mesh_t *mesh;
+
+    /** The number of dimensions of the tensor. */
+    rock_uint_t order;
+
+    /** The number of columns of the factor matrices. */
+    rock_uint_t num_cols;
+
+    /** The first row owned by the processor (one for each dimension). */
+    rock_uint_t own_offset[ROCK_MAX_ORDER];
+
+    /** The number of rows owned by the processor. */
+    rock_uint_t own_len[ROCK_MAX_ORDER];
+
+    /** The number of distinct local indices. */
+    rock_uint_t num_uniq[ROCK_MAX_ORDER];
+
+    /** The distinct local indices in increasing order. */
+    rock_uint_t *uniq[ROCK_MAX_ORDER];
+
+    /** The number of rows received from each processor. */
+    int *recv_count[ROCK_MAX_ORDER];
+
+    /** The offset of those rows in the receive buffer. */
+    int *recv_displ[ROCK_MAX_ORDER];
+
+    /** The position in @c uniq of each received row. */
+    rock_uint_t *recv_pos[ROCK_MAX_ORDER];
+
+    /** The number of rows sent to each processor. */
+    int *send_count[ROCK_MAX_ORDER];
+
+    /** The offset of those rows in the send buffer. */
+    int *send_displ[ROCK_MAX_ORDER];
+
+    /** The owned row (relative to @c own_offset) of each sent row. */
+    rock_uint_t *send_rows[ROCK_MAX_ORDER];
+
+    /** Reusable send buffer (large enough for any dimension). */
+    rock_elem_t *send_buf;
+
+    /** Reusable receive buffer (large enough for any dimension). */
+    rock_elem_t *recv_buf;
+
+    /** A row of a factor matrix. */
+    MPI_Datatype row_type;
+
+} rock_comm_plan_t;
+
+/**
+ * Initialize and populate a communication plan object.
+ *
+ * Collective over the mesh. The multi-partition (including its
+ * descriptor) must be available at all processors.
+ *
+ * @param [in] desc         A tensor descriptor object.
+ * @param [in] indx         The local index array of the processor.
+ * @param [in] mpart        The multi-partition the tensor is distributed by.
+ * @param [in] mesh         The mesh the tensor is distributed over.
+ * @param [in] num_cols     The number of columns of the factor matrices.
+ * @return                  Initialized and populated plan object.
+ */
+rock_comm_plan_t *
+rock_comm_plan_init(rock_desc_t *desc,
+                    rock_indx_t *indx,
+                    rock_mpart_t *mpart,
+                    rock_mesh_t *mesh,
+                    rock_uint_t num_cols);
+
+/**
+ * Free a communication plan object.
+ *
+ * Associated objects should be free'd separately.
+ *
+ * @param [in] plan
+ */
+void
+rock_comm_plan_free(rock_comm_plan_t *plan);
+
+/**
+ * Fetch the rows of a factor matrix needed by the local indices.
+ *
+ * Matrices are stored row by row, @c num_cols elements per row.
+ *
+ * @param [in] plan
+ * @param [in] dim          The dimension (factor matrix) to exchange.
+ * @param [in] owned        The owned rows (@c own_len rows).
+ * @param [out] needed      The rows of the local indices (@c num_uniq
+ *                          rows, in the order of @c uniq).
+ */
+int
+rock_comm_plan_exchange(rock_comm_plan_t *plan,
+                        rock_uint_t dim,
+                        rock_elem_t *owned,
+                        rock_elem_t *needed);
+
+/**
+ * Sum partial rows of the local indices into the owned rows.
+ *
+ * The reverse of @c rock_comm_plan_exchange, e.g., used to combine the
+ * partial results of a distributed MTTKRP.
+ *
+ * @param [in] plan
+ * @param [in] dim          The dimension (factor matrix) to reduce.
+ * @param [in] needed       The partial rows of the local indices.
+ * @param [in,out] owned    The owned rows to add the partial rows to.
+ */
+int
+rock_comm_plan_reduce(rock_comm_plan_t *plan,
+                      rock_uint_t dim,
+                      rock_elem_t *needed,
+                      rock_elem_t *owned);
+
+#endif
@@ -0,0 +1,208 @@
+/**
+ * @file profile.c
+ * @author timoteus <mail@timoteus.se>
+ */
+
+#include "profile.h"
+
+int rock_profiling = 0;
+
+static rock_prof_t prof[ROCK_PROF_NUM_OPS];
+
+static const char *prof_names[ROCK_PROF_NUM_OPS] = {
+    "rock_dist_init",
+    "rock_redistribute",
+    "rock_freq_dist_init",
+    "rock_indx_scatter",
+    "rock_indx_gather",
+    "rock_elem_scatter",
+    "rock_elem_gather",
+    "rock_indx_scatter_compressed",
+    "rock_indx_gather_compressed",
+    "rock_chunk_scatter",
+    "rock_chunk_gather",
+    "rock_tensor_scatter",
+    "rock_tensor_gather",
+    "rock_comm_plan_init",
+    "rock_comm_plan_exchange",
+    "rock_comm_plan_reduce",
+    "rock_dist_append",
+    "rock_mpart_rebalance"
+};
+
+/* The fields of a record, sent as doubles. */
+#define PROF_NUM_FIELDS 5
+
+double
+rock_prof_start()
+{
+    return rock_profiling ? MPI_Wtime() : 0.0;
+}
+
+void
+rock_prof_stop(int op, double start, uint64_t bytes, uint64_t msgs)
+{
+    if (!rock_profiling || op < 0 || op >= ROCK_PROF_NUM_OPS) {
+        return;
+    }
+
+    prof[op].calls++;
+    prof[op].time += MPI_Wtime() - start;
+    prof[op].bytes += bytes;
+    prof[op].msgs += msgs;
+}
+
+void
+rock_prof_barrier(int op, MPI_Comm comm)
+{
+    if (!rock_profiling || op < 0 || op >= ROCK_PROF_NUM_OPS) {
+        MPI_Barrier(comm);
+        return;
+    }
+
+    double start = MPI_Wtime();
+    MPI_Barrier(comm);
+    prof[op].wait += MPI_Wtime() - start;
+}
+
+rock_prof_t *
+rock_prof_get(int op)
+{
+    if (op < 0 || op >= ROCK_PROF_NUM_OPS) {
+        return NULL;
+    }
+
+    return &prof[op];
+}
+
+const char *
+rock_prof_name(int op)
+{
+    if (op < 0 || op >= ROCK_PROF_NUM_OPS) {
+        return NULL;
+    }
+
+    return prof_names[op];
+}
+
+void
+rock_prof_reset()
+{
+    memset(prof, 0, sizeof(prof));
+}
+
+static void
+prof_write_table(FILE *stream, double *all, int np)
+{
+    fprintf(stream, "%-30s %8s %10s %10s %10s %6s %10s %14s %10s\n",
+            "operation", "calls", "min [s]", "avg [s]", "max [s]",
+            "imbal", "wait [s]", "bytes", "msgs");
+
+    for (int op = 0; op < ROCK_PROF_NUM_OPS; op++) {
+        double calls = 0, min = INFINITY, max = 0, sum = 0, wait = 0;
+        double bytes = 0, msgs = 0;
+
+        for (int p = 0; p < np; p++) {
+            double *rec = &all[(p * ROCK_PROF_NUM_OPS + op) * PROF_NUM_FIELDS];
+            calls = (rec[0] > calls) ? rec[0] : calls;
+            min = (rec[1] < min) ? rec[1] : min;
+            max = (rec[1] > max) ? rec[1] : max;
+            sum += rec[1];
+            wait += rec[2];
+            bytes += rec[3];
+            msgs += rec[4];
+        }
+
+        if (calls == 0) {
+            continue;
+        }
+
+        double avg = sum / np;
+        fprintf(stream, "%-30s %8.0f %10.4f %10.4f %10.4f %6.2f %10.4f "
+                "%14.0f %10.0f\n", prof_names[op], calls, min, avg, max,
+                (avg > 0) ? max / avg : 1.0, wait / np, bytes, msgs);
+    }
+}
+
+static void
+prof_write_json(FILE *stream, double *all, int np)
+{
+    static const char *fields[] = {"calls", "time", "wait", "bytes", "msgs"};
+    bool first_op = true;
+
+    fprintf(stream, "{\"np\": %d, \"ops\": [", np);
+
+    for (int op = 0; op < ROCK_PROF_NUM_OPS; op++) {
+        double calls = 0;
+        for (int p = 0; p < np; p++) {
+            calls += all[(p * ROCK_PROF_NUM_OPS + op) * PROF_NUM_FIELDS];
+        }
+
+        if (calls == 0) {
+            continue;
+        }
+
+        fprintf(stream, "%s\n  {\"name\": \"%s\"", first_op ? "" : ",",
+                prof_names[op]);
+        first_op = false;
+
+        /* One value per processor for each field. */
+        for (int f = 0; f < PROF_NUM_FIELDS; f++) {
+            fprintf(stream, ", \"%s\": [", fields[f]);
+            for (int p = 0; p < np; p++) {
+                double val = all[(p * ROCK_PROF_NUM_OPS + op) *
+                        PROF_NUM_FIELDS + f];
+                fprintf(stream, (f == 1 || f == 2) ? "%s%.9f" : "%s%.0f",
+                        (p == 0) ? "" : ", ", val);
+            }
+            fprintf(stream, "]");
+        }
+
+        fprintf(stream, "}");
+    }
+
+    fprintf(stream, "\n]}\n");
+}
+
+int
+rock_prof_report(MPI_Comm comm, FILE *stream, int format)
+{
+    if (format != ROCK_PROF_TABLE && format != ROCK_PROF_JSON) {
+        return ROCK_BAD_INPUT;
+    }
+
+    int np, rank;
+    MPI_Comm_size(comm, &np);
+    MPI_Comm_rank(comm, &rank);
+
+    double local[ROCK_PROF_NUM_OPS * PROF_NUM_FIELDS];
+    for (int op = 0; op < ROCK_PROF_NUM_OPS; op++) {
+        double *rec = &local[op * PROF_NUM_FIELDS];
+        rec[0] = prof[op].calls;
+        rec[1] = prof[op].time;
+        rec[2] = prof[op].wait;
+        rec[3] = prof[op].bytes;
+        rec[4] = prof[op].msgs;
+    }
+
+    double *all = NULL;
+    if (rank == ROCK_MASTER) {
+        all = malloc(np * sizeof(local));
+    }
+
+    MPI_Gather(local, ROCK_PROF_NUM_OPS * PROF_NUM_FIELDS, MPI_DOUBLE,
+            all, ROCK_PROF_NUM_OPS * PROF_NUM_FIELDS, MPI_DOUBLE,
+            ROCK_MASTER, comm);
+
+    if (rank == ROCK_MASTER) {
+        if (format == ROCK_PROF_TABLE) {
+            prof_write_table(stream, all, np);
+        } else {
+            prof_write_json(stream, all, np);
+        }
+        fflush(stream);
+        free(all);
+    }
+
+    return ROCK_OK;
+}
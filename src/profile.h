@@ -0,0 +1,151 @@
+/**
+ * @file profile.h
+ * @author timoteus <mail@timoteus.se>
+ *
+ * Instrumentation of the distribution layer. When @c rock_profiling is
+ * switched on, every instrumented collective records its number of
+ * calls, the time spent in it, the time spent waiting for other
+ * processors in barriers, and the number of bytes and messages the
+ * processor sent or received (data kept locally is not counted).
+ *
+ * Records are kept per processor and reduced to a summary table or a
+ * JSON trace using @c rock_prof_report, e.g.:
+ *
+ *     rock_profiling = 1;
+ *     ...
+ *     rock_prof_report(MPI_COMM_WORLD, stdout, ROCK_PROF_TABLE);
+ */
+
+#ifndef _PROFILE_H
+#define _PROFILE_H
+
+#include "core.h"
+#include <mpi.h>
+
+/** Switch recording on (non-zero) or off (zero, the default). */
+extern int rock_profiling;
+
+/* Instrumented operations. */
+#define ROCK_PROF_DIST_INIT 0
+#define ROCK_PROF_REDISTRIBUTE 1
+#define ROCK_PROF_FREQ_DIST 2
+#define ROCK_PROF_INDX_SCATTER 3
+#define ROCK_PROF_INDX_GATHER 4
+#define ROCK_PROF_ELEM_SCATTER 5
+#define ROCK_PROF_ELEM_GATHER 6
+#define ROCK_PROF_INDX_SCATTER_COMPRESSED 7
+#define ROCK_PROF_INDX_GATHER_COMPRESSED 8
+#define ROCK_PROF_CHUNK_SCATTER 9
+#define ROCK_PROF_CHUNK_GATHER 10
+#define ROCK_PROF_TENSOR_SCATTER 11
+#define ROCK_PROF_TENSOR_GATHER 12
+#define ROCK_PROF_COMM_PLAN_INIT 13
+#define ROCK_PROF_COMM_PLAN_EXCHANGE 14
+#define ROCK_PROF_COMM_PLAN_REDUCE 15
+#define ROCK_PROF_DIST_APPEND 16
+#define ROCK_PROF_REBALANCE 17
+#define ROCK_PROF_NUM_OPS 18
+
+/* Report formats. */
+#define ROCK_PROF_TABLE 0
+#define ROCK_PROF_JSON 1
+
+/**
+ * Profile record object.
+ *
+ * Represents what one processor spent in one operation.
+ */
+typedef struct rock_prof_s
+{
+    /** The number of calls. */
+    uint64_t calls;
+
+    /** The total time in seconds (including @c wait). */
+    double time;
+
+    /** The time in seconds spent waiting in barriers. */
+    double wait;
+
+    /** The number of bytes sent or received. */
+    uint64_t bytes;
+
+    /** The number of messages sent or received. */
+    uint64_t msgs;
+
+} rock_prof_t;
+
+/**
+ * Start timing an operation.
+ *
+ * @return                  The start time, pass to @c rock_prof_stop.
+ */
+double
+rock_prof_start();
+
+/**
+ * Stop timing an operation and record it.
+ *
+ * Does nothing unless @c rock_profiling is switched on.
+ *
+ * @param [in] op           The operation, e.g., @c ROCK_PROF_DIST_INIT.
+ * @param [in] start        The time returned by @c rock_prof_start.
+ * @param [in] bytes        The number of bytes sent or received.
+ * @param [in] msgs         The number of messages sent or received.
+ */
+void
+rock_prof_stop(int op, double start, uint64_t bytes, uint64_t msgs);
+
+/**
+ * Synchronize processors, recording the time spent waiting.
+ *
+ * Same as @c MPI_Barrier, the time is added to the @c wait of @c op
+ * when @c rock_profiling is switched on.
+ *
+ * @param [in] op           The operation the barrier is part of.
+ * @param [in] comm         The communicator to synchronize.
+ */
+void
+rock_prof_barrier(int op, MPI_Comm comm);
+
+/**
+ * Get the record of an operation of this processor.
+ *
+ * @param [in] op
+ * @return                  The record, or @c NULL if @c op is unknown.
+ */
+rock_prof_t *
+rock_prof_get(int op);
+
+/**
+ * Get the name of an operation.
+ *
+ * @param [in] op
+ * @return                  The name of the rock routine, or @c NULL.
+ */
+const char *
+rock_prof_name(int op);
+
+/**
+ * Clear the records of this processor.
+ */
+void
+rock_prof_reset();
+
+/**
+ * Reduce the records of all processors and write a report.
+ *
+ * Collective over @c comm, only the master processor writes. The table
+ * lists, for every operation called at any processor, the calls, the
+ * min/avg/max time over processors together with the imbalance
+ * (max / avg), the average wait and the total bytes and messages. The
+ * JSON trace contains the records of every processor.
+ *
+ * @param [in] comm         The communicator to reduce over.
+ * @param [in] stream       The stream to write to, e.g., @c stdout.
+ * @param [in] format       @c ROCK_PROF_TABLE or @c ROCK_PROF_JSON.
+ * @return                  ROCK_OK or ROCK_BAD_INPUT.
+ */
+int
+rock_prof_report(MPI_Comm comm, FILE *stream, int format);
+
+#endif
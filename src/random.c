@@ -31,6 +31,17 @@ rock_double_random()
     return (double) rand() / RAND_MAX;
 }
 
+uint64_t
+rock_counter_random(uint64_t key, uint64_t counter)
+{
+    uint64_t z = key + (counter + 1) * 0x9e3779b97f4a7c15;
+
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111eb;
+
+    return z ^ (z >> 31);
+}
+
 /*
  * Use a custom algorithm based on the Fisher-Yates shuffle to shuffle
  * a yet not represented array full of integers between 0 and range - 1.
@@ -117,6 +128,7 @@ rock_uint_shuffle_take(rock_uint_t *a,
 static inline void
 rock_val_to_indx(rock_desc_t *desc, rock_indx_t *indx)
 {
+    #pragma omp parallel for num_threads(rock_thread_count(indx->len))
     for (rock_uint_t i = 0; i < indx->len; i++) {
         rock_uint_t v = indx->v[i];
 
@@ -215,6 +227,64 @@ rock_indx_sample(rock_desc_t *desc, rock_indx_t *indx)
     return rock_indx_sample_sort_discard(desc, indx);
 }
 
+int
+rock_indx_sample_range(rock_desc_t *desc,
+                       rock_indx_t *indx,
+                       rock_uint_t first,
+                       rock_uint_t range,
+                       uint64_t seed)
+{
+    /* Are we able to sample indices for this range? */
+    if (indx->len > range || first + range > desc->total_size ||
+            first + range < first) {
+        return ROCK_BAD_INPUT;
+    }
+
+    if (indx->len == 0) {
+        return ROCK_OK;
+    }
+
+    /* Sort positions relative to first using a one-dimensional tensor. */
+    rock_uint_t dims[] = {0};
+    rock_desc_t *range_desc = rock_desc_init(1, &range);
+
+    /* Different ranges use different streams. */
+    uint64_t key = rock_counter_random(seed, first);
+    uint64_t counter = 0;
+
+    /* Until distinct, sample the missing tail and discard duplicates. */
+    rock_uint_t num_distinct = 0;
+    while (num_distinct < indx->len) {
+        rock_uint_t len = indx->len - num_distinct;
+        rock_uint_t *v = &indx->v[num_distinct];
+
+        #pragma omp parallel for num_threads(rock_thread_count(len))
+        for (rock_uint_t i = 0; i < len; i++) {
+            v[i] = rock_counter_random(key, counter + i) % range;
+        }
+        counter += len;
+
+        rock_indx_sort(range_desc, 1, dims, NULL, indx);
+
+        num_distinct = 0;
+        for (rock_uint_t i = 0; i < indx->len; i++) {
+            if (i == 0 || indx->v[i] != indx->v[num_distinct-1]) {
+                indx->v[num_distinct++] = indx->v[i];
+            }
+        }
+    }
+
+    for (rock_uint_t i = 0; i < indx->len; i++) {
+        indx->v[i] += first;
+    }
+
+    rock_val_to_indx(desc, indx);
+
+    rock_desc_free(range_desc);
+
+    return ROCK_OK;
+}
+
 void
 rock_elem_sample(rock_desc_t *desc, rock_elem_t *elem)
 {
@@ -223,6 +293,17 @@ rock_elem_sample(rock_desc_t *desc, rock_elem_t *elem)
     }
 }
 
+void
+rock_elem_sample_counter(rock_elem_t *elem, uint64_t seed, uint64_t counter)
+{
+    #pragma omp parallel for num_threads(rock_thread_count(elem->len))
+    for (rock_uint_t i = 0; i < elem->len; i++) {
+        /* The 53 high bits give a double in [0, 1). */
+        elem->v[i] = (rock_counter_random(seed, counter + i) >> 11) *
+                (1.0 / 9007199254740992.0);
+    }
+}
+
 void
 rock_perm_sample(rock_perm_t *perm)
 {
@@ -241,3 +322,17 @@ rock_perm_shuffle(rock_perm_t *perm)
         rock_uint_swap(&perm->v[k], &perm->v[i]);
     }
 }
+
+void
+rock_lmap_sample(rock_lmap_t *lmap)
+{
+    for (rock_uint_t i = 0; i < lmap->desc->order; i++) {
+        rock_perm_t perm = {lmap->desc->dim_size[i], lmap->dim_map[i]};
+
+        rock_perm_sample(&perm);
+
+        for (rock_uint_t k = 0; k < perm.len; k++) {
+            lmap->dim_inv[i][perm.v[k]] = k;
+        }
+    }
+}
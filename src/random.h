@@ -25,6 +25,21 @@ rock_uint_random(rock_uint_t range);
 double
 rock_double_random();
 
+/**
+ * Generate a pseudo-random number from a key and a counter.
+ *
+ * Counter-based (stateless) generator using the SplitMix64 finalizer:
+ * the same key and counter always produce the same number, such that
+ * numbers can be generated in parallel and on different processors
+ * without sharing any state.
+ *
+ * @param key               Selects the stream of numbers, e.g., a seed.
+ * @param counter           The position in the stream.
+ * @return                  A pseudo-random 64-bit number.
+ */
+uint64_t
+rock_counter_random(uint64_t key, uint64_t counter);
+
 /**
  * Generate a pseudo-random index array based on a tensor descriptor.
  *
@@ -70,6 +85,31 @@ rock_indx_sample_shuffle_take(rock_desc_t *desc, rock_indx_t *indx);
 int
 rock_indx_sample_sort_discard(rock_desc_t *desc, rock_indx_t *indx);
 
+/**
+ * Generate a pseudo-random index array within a range of the tensor.
+ *
+ * Like @c rock_indx_sample, but the linear positions of the indices
+ * (dimension 0 varying fastest) are within [first, first + range) and
+ * numbers are taken from @c rock_counter_random. The result only
+ * depends on the arguments, not on the number of threads.
+ *
+ * Used to sample disjoint shares of a tensor on different processors,
+ * see @c rock_dist_sample. The indices are sorted by linear position.
+ *
+ * @param [in] desc         A tensor descriptor object.
+ * @param [in,out] indx     The index array to sample indices for.
+ * @param [in] first        The first linear position of the range.
+ * @param [in] range        The number of linear positions of the range.
+ * @param [in] seed         The seed of the generator.
+ * @return                  ROCK_OK or ROCK_BAD_INPUT.
+ */
+int
+rock_indx_sample_range(rock_desc_t *desc,
+                       rock_indx_t *indx,
+                       rock_uint_t first,
+                       rock_uint_t range,
+                       uint64_t seed);
+
 /**
  * Generate a pseudo-random element array based on a tensor descriptor.
  *
@@ -79,6 +119,19 @@ rock_indx_sample_sort_discard(rock_desc_t *desc, rock_indx_t *indx);
 void
 rock_elem_sample(rock_desc_t *desc, rock_elem_t *elem);
 
+/**
+ * Generate a pseudo-random element array using @c rock_counter_random.
+ *
+ * Element i is generated from @c counter + i, such that consecutive
+ * pieces of one large array can be generated independently.
+ *
+ * @param [in,out] elem     The element array to sample elements for.
+ * @param [in] seed         The seed of the generator.
+ * @param [in] counter      The counter of the first element.
+ */
+void
+rock_elem_sample_counter(rock_elem_t *elem, uint64_t seed, uint64_t counter);
+
 /**
  * Sample a random permutation.
  *
@@ -95,4 +148,14 @@ rock_perm_sample(rock_perm_t *perm);
 void
 rock_perm_shuffle(rock_perm_t *perm);
 
+/**
+ * Sample a random label map.
+ *
+ * Every dimension is relabeled using a random permutation.
+ *
+ * @param [in,out] lmap
+ */
+void
+rock_lmap_sample(rock_lmap_t *lmap);
+
 #endif
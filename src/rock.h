@@ -14,6 +14,11 @@
 #include "sort.h"
 #include "disk.h"
 #include "distribute.h"
+#include "plan.h"
+#include "codec.h"
+#include "profile.h"
+#include "pdisk.h"
+#include "text.h"
 #include "tensor.h"
 
 #endif
@@ -9,6 +9,29 @@
 /* Use default values if not manually overridden. */
 int rock_radix_bits = ROCK_USE_DEFAULT;
 int rock_num_threads = ROCK_USE_DEFAULT;
+int rock_max_threads = ROCK_USE_DEFAULT;
+
+int
+rock_thread_count(rock_uint_t len)
+{
+    /* Allow manual override. */
+    if (rock_num_threads != ROCK_USE_DEFAULT) {
+        return rock_num_threads;
+    }
+
+    /* Use single thread below threshold. */
+    if (len <= ROCK_PARALLEL_THRESHOLD) {
+        return 1;
+    }
+
+    int max_threads = omp_get_max_threads();
+
+    if (rock_max_threads > 0 && rock_max_threads < max_threads) {
+        return rock_max_threads;
+    }
+
+    return max_threads;
+}
 
 static inline void
 indx_sort_thread(rock_desc_t *desc,
@@ -158,7 +181,8 @@ indx_sort(rock_desc_t *desc,
         *swapped = false;
     }
 
-    #pragma omp parallel shared(indx, indx_alt, perm, perm_alt, bins)
+    #pragma omp parallel shared(indx, indx_alt, perm, perm_alt, bins) \
+            num_threads(rock_thread_count(indx->len))
     {
         /* Parallel setup. */
 
@@ -247,15 +271,5 @@ rock_indx_sort_alt(rock_desc_t *desc,
         rock_radix_bits = ROCK_DEFAULT_RADIX_BITS;
     }
 
-    /* Use single thread below threshold. */
-    if (indx->len <= ROCK_PARALLEL_THRESHOLD) {
-        omp_set_num_threads(1);
-    }
-
-    /* Allow manual override. */
-    if (rock_num_threads != ROCK_USE_DEFAULT) {
-        omp_set_num_threads(rock_num_threads);
-    }
-
     indx_sort(desc, num_dims, dims, perm, perm_alt, indx, indx_alt, swapped);
 }
@@ -14,6 +14,27 @@ extern int rock_num_threads;
 /** The number of bits to maximally process each pass of radix sort. */
 extern int rock_radix_bits;
 
+/**
+ * The largest number of threads to use for parallel regions, e.g., the
+ * share of the cores of a node of each processor (@c num_threads of a
+ * mesh, see @c rock_mesh_init).
+ */
+extern int rock_max_threads;
+
+/**
+ * Get the number of threads to use for a parallel region.
+ *
+ * A single thread is used below @c ROCK_PARALLEL_THRESHOLD items
+ * unless manually overridden using @c rock_num_threads. Above it, as
+ * many threads as the OpenMP runtime offers (e.g., OMP_NUM_THREADS),
+ * but at most @c rock_max_threads if set.
+ *
+ * @param [in] len          The number of items processed by the region.
+ * @return                  The number of threads to use.
+ */
+int
+rock_thread_count(rock_uint_t len);
+
 /**
  * Sorts an index array of packed multi-indices according to one or
  * more dimensions.
@@ -9,6 +9,7 @@
 #include "disk.h"
 #include "random.h"
 #include "print.h"
+#include <sys/mman.h>
 
 rock_tensor_t *
 rock_tensor_init(rock_uint_t order,
@@ -20,6 +21,7 @@ rock_tensor_init(rock_uint_t order,
     tensor->desc = rock_desc_init(order, dim_size);
     tensor->indx = rock_indx_init(num_elem);
     tensor->elem = rock_elem_init(num_elem);
+    tensor->sorted_dim = ROCK_UINT_MAX;
 
     return tensor;
 }
@@ -28,11 +30,39 @@ void
 rock_tensor_free(rock_tensor_t *tensor)
 {
     rock_desc_free(tensor->desc);
-    rock_indx_free(tensor->indx);
-    rock_elem_free(tensor->elem);
+
+    if (tensor->map) {
+        free(tensor->indx);
+        free(tensor->elem);
+        munmap(tensor->map, tensor->map_len);
+    } else {
+        rock_indx_free(tensor->indx);
+        rock_elem_free(tensor->elem);
+    }
+
     free(tensor);
 }
 
+void
+rock_tensor_detach(rock_tensor_t *tensor)
+{
+    if (tensor->map == NULL) {
+        return;
+    }
+
+    rock_indx_t *indx = rock_indx_copy(tensor->indx);
+    rock_elem_t *elem = rock_elem_copy(tensor->elem);
+
+    free(tensor->indx);
+    free(tensor->elem);
+    munmap(tensor->map, tensor->map_len);
+
+    tensor->indx = indx;
+    tensor->elem = elem;
+    tensor->map = NULL;
+    tensor->map_len = 0;
+}
+
 void
 rock_tensor_print(rock_tensor_t *tensor,
                   char *name,
@@ -57,6 +87,7 @@ rock_tensor_sample(rock_tensor_t *tensor)
 {
     rock_indx_sample(tensor->desc, tensor->indx);
     rock_elem_sample(tensor->desc, tensor->elem);
+    tensor->sorted_dim = ROCK_UINT_MAX;
 }
 
 void
@@ -67,6 +98,7 @@ rock_tensor_shuffle(rock_tensor_t *tensor)
     rock_perm_sample(perm);
     rock_indx_permute(tensor->indx, perm);
     rock_elem_permute(tensor->elem, perm);
+    tensor->sorted_dim = ROCK_UINT_MAX;
 
     rock_perm_free(perm);
 }
@@ -80,6 +112,7 @@ rock_tensor_sort(rock_tensor_t *tensor, rock_uint_t dimension)
     perm = rock_perm_init(tensor->indx->len);
     rock_indx_sort(tensor->desc, 1, (rock_uint_t *)dims, perm, tensor->indx);
     rock_elem_permute(tensor->elem, perm);
+    tensor->sorted_dim = dimension;
 
     rock_perm_free(perm);
 }
@@ -41,6 +41,23 @@ typedef struct rock_tensor_s
      */
     rock_elem_t *elem;
 
+    /**
+     * The dimension the tensor is sorted by.
+     *
+     * Set by @c rock_tensor_sort and @c ROCK_UINT_MAX if the order
+     * of the non-zero elements is unknown.
+     */
+    rock_uint_t sorted_dim;
+
+    /**
+     * The memory mapped file the arrays point into, NULL if they are
+     * allocated (see @c rock_tensor_mmap).
+     */
+    void *map;
+
+    /** The length of the mapping in bytes. */
+    size_t map_len;
+
 } rock_tensor_t;
 
 /**
@@ -63,13 +80,26 @@ rock_tensor_init(rock_uint_t order,
 /**
  * Free a tensor object.
  *
- * This routine will also free the indx and elem arrays.
+ * This routine will also free the indx and elem arrays, or unmap them
+ * if they are memory mapped.
  *
  * @param [in] tensor
  */
 void
 rock_tensor_free(rock_tensor_t *tensor);
 
+/**
+ * Detach a tensor from its memory mapped file.
+ *
+ * Copies the index and element arrays into allocated ones and unmaps
+ * the file, such that the arrays can be handed to routines freeing or
+ * reallocating them. Does nothing if the arrays are already allocated.
+ *
+ * @param [in] tensor
+ */
+void
+rock_tensor_detach(rock_tensor_t *tensor);
+
 /**
  * Print the tensor's non-zero elements and their respective indices
  * using a specified name, width, and precision.
@@ -0,0 +1,848 @@
+/**
+ * @file text.c
+ * @author timoteus <mail@timoteus.se>
+ */
+
+#include "text.h"
+#include "sort.h"
+#include <locale.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+/* The number of lines formatted by each thread at a time. */
+#define TEXT_BLOCK_LEN 65536
+
+/* The longest number parsed by the slow path. */
+#define TEXT_MAX_NUMBER 128
+
+/* The longest formatted line: coordinates, value and separators. */
+#define TEXT_MAX_LINE(order) ((order) * 21 + 32)
+
+/* Significant digits needed to load a value back exactly. */
+#ifdef ROCK_ELEM_FLOAT
+    #define TEXT_SHORT_DIGITS 6
+    #define TEXT_EXACT_DIGITS 9
+#else
+    #define TEXT_SHORT_DIGITS 15
+    #define TEXT_EXACT_DIGITS 17
+#endif
+
+/* Powers of ten exactly representable by a double. */
+static const double text_pow10[] = {
+    1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+    1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22
+};
+
+/*
+ * How the lines of a text file are laid out.
+ */
+typedef struct text_format_s
+{
+    /* Lines starting with this character are skipped. */
+    char comment;
+
+    /* Field separator in addition to blanks (0 for none). */
+    char delim;
+
+    /* The coordinate of the first index of a dimension. */
+    rock_uint_t base;
+
+    /* Whether lines end with a value (1 otherwise). */
+    bool value;
+
+    /*
+     * Whether an element (i, j) implies the element (j, i) of the same
+     * value (1) or the negated value (-1), as opposed to nothing (0).
+     */
+    int symmetry;
+
+} text_format_t;
+
+static const text_format_t text_tns = {'#', 0, 1, true, 0};
+
+/*
+ * A memory mapped text file.
+ */
+typedef struct text_file_s
+{
+    const char *data;
+    size_t size;
+
+} text_file_t;
+
+static int
+text_map(char *fname, text_file_t *file)
+{
+    int fd = open(fname, O_RDONLY);
+    if (fd < 0) {
+        return ROCK_ERR;
+    }
+
+    struct stat st;
+    int status = ROCK_OK;
+
+    file->data = NULL;
+    file->size = 0;
+
+    if (fstat(fd, &st) != 0) {
+        status = ROCK_ERR;
+    } else if (st.st_size > 0) {
+        void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+
+        if (map == MAP_FAILED) {
+            status = ROCK_ERR;
+        } else {
+            file->data = map;
+            file->size = st.st_size;
+        }
+    }
+
+    close(fd);
+
+    return status;
+}
+
+static void
+text_unmap(text_file_t *file)
+{
+    if (file->data) {
+        munmap((void *) file->data, file->size);
+    }
+}
+
+static inline bool
+text_is_blank(char c)
+{
+    return c == ' ' || c == '\t' || c == '\r';
+}
+
+static inline bool
+text_is_digit(char c)
+{
+    return c >= '0' && c <= '9';
+}
+
+static inline const char *
+text_skip_blank(const char *p, const char *end)
+{
+    while (p < end && text_is_blank(*p)) {
+        p++;
+    }
+
+    return p;
+}
+
+/*
+ * Skip the separator between two fields.
+ */
+static inline const char *
+text_next_field(const char *p, const char *end, char delim)
+{
+    p = text_skip_blank(p, end);
+    if (delim && p < end && *p == delim) {
+        p = text_skip_blank(p + 1, end);
+    }
+
+    return p;
+}
+
+/*
+ * Parse an unsigned integer, returning the end of it or NULL.
+ */
+static inline const char *
+text_parse_uint(const char *p, const char *end, uint64_t *val)
+{
+    uint64_t v = 0;
+    const char *start = p;
+
+    while (p < end && text_is_digit(*p)) {
+        uint64_t d = *p - '0';
+
+        if (v > (UINT64_MAX - d) / 10) {
+            return NULL;
+        }
+        v = v * 10 + d;
+        p++;
+    }
+
+    *val = v;
+
+    return (p > start) ? p : NULL;
+}
+
+/*
+ * Parse a decimal number without scanning it twice, returning the end
+ * of it or NULL.
+ *
+ * Numbers of at most 15 significant digits and a small exponent (most
+ * of them) are exact products or quotients of two doubles. Others are
+ * handed to strtod, using the decimal point of the current locale.
+ */
+static const char *
+text_parse_double(const char *p, const char *end, double *val)
+{
+    const char *start = p;
+    bool neg = false;
+    bool any = false;
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exp10 = 0;
+
+    if (p < end && (*p == '-' || *p == '+')) {
+        neg = *p == '-';
+        p++;
+    }
+
+    for (; p < end && text_is_digit(*p); p++) {
+        any = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*p - '0');
+            digits += mantissa > 0;
+        } else {
+            exp10++;
+        }
+    }
+
+    if (p < end && *p == '.') {
+        for (p++; p < end && text_is_digit(*p); p++) {
+            any = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*p - '0');
+                digits += mantissa > 0;
+                exp10--;
+            }
+        }
+    }
+
+    if (!any) {
+        return NULL;
+    }
+
+    /* The exponent is optional, "1e" is 1 followed by garbage. */
+    if (p < end && (*p == 'e' || *p == 'E')) {
+        const char *q = p + 1;
+        bool exp_neg = false;
+        int exp = 0;
+
+        if (q < end && (*q == '-' || *q == '+')) {
+            exp_neg = *q == '-';
+            q++;
+        }
+        if (q < end && text_is_digit(*q)) {
+            for (; q < end && text_is_digit(*q); q++) {
+                exp = (exp < 100000) ? exp * 10 + (*q - '0') : exp;
+            }
+            exp10 += exp_neg ? -exp : exp;
+            p = q;
+        }
+    }
+
+    if (mantissa == 0) {
+        *val = neg ? -0.0 : 0.0;
+    } else if (mantissa < (1ull << 53) && exp10 >= -22 && exp10 <= 22) {
+        double v = (double) mantissa;
+        v = (exp10 < 0) ? v / text_pow10[-exp10] : v * text_pow10[exp10];
+        *val = neg ? -v : v;
+    } else {
+        char buf[TEXT_MAX_NUMBER];
+        size_t len = p - start;
+        char point = localeconv()->decimal_point[0];
+
+        if (len >= TEXT_MAX_NUMBER) {
+            return NULL;
+        }
+        memcpy(buf, start, len);
+        buf[len] = '\0';
+        for (size_t i = 0; i < len; i++) {
+            buf[i] = (buf[i] == '.') ? point : buf[i];
+        }
+
+        *val = strtod(buf, NULL);
+    }
+
+    return p;
+}
+
+/*
+ * The first character of a line holding data, NULL if the line is
+ * blank or a comment.
+ */
+static inline const char *
+text_data_line(const char *p, const char *end, const text_format_t *fmt)
+{
+    p = text_skip_blank(p, end);
+
+    if (p == end || *p == fmt->comment) {
+        return NULL;
+    }
+
+    return p;
+}
+
+/*
+ * Parse the coordinates (relative to the base) and the value of a data
+ * line.
+ */
+static bool
+text_parse_line(const char *p,
+                const char *end,
+                const text_format_t *fmt,
+                rock_uint_t order,
+                uint64_t *coord,
+                double *val)
+{
+    for (rock_uint_t k = 0; k < order; k++) {
+        if (k > 0) {
+            p = text_next_field(p, end, fmt->delim);
+        }
+
+        p = text_parse_uint(p, end, &coord[k]);
+        if (p == NULL || coord[k] < fmt->base) {
+            return false;
+        }
+        coord[k] -= fmt->base;
+    }
+
+    *val = 1.0;
+    if (fmt->value) {
+        p = text_next_field(p, end, fmt->delim);
+        p = text_parse_double(p, end, val);
+        if (p == NULL) {
+            return false;
+        }
+    }
+
+    /* Nothing may follow. */
+    return text_skip_blank(p, end) == end;
+}
+
+/*
+ * The end of the line starting at p.
+ */
+static inline const char *
+text_line_end(const char *p, const char *end)
+{
+    const char *nl = memchr(p, '\n', end - p);
+
+    return nl ? nl : end;
+}
+
+/*
+ * Split text into ranges of whole lines.
+ */
+static void
+text_split(const char *data, size_t size, int num_ranges, size_t *bounds)
+{
+    bounds[0] = 0;
+    bounds[num_ranges] = size;
+
+    for (int t = 1; t < num_ranges; t++) {
+        size_t pos = size / num_ranges * t;
+
+        if (pos < bounds[t-1]) {
+            pos = bounds[t-1];
+        } else if (pos > 0 && data[pos-1] != '\n') {
+            pos = text_line_end(&data[pos], &data[size]) - data;
+            pos += pos < size;
+        }
+
+        bounds[t] = pos;
+    }
+}
+
+/*
+ * The number of fields of the first data line, 0 if there is none.
+ */
+static rock_uint_t
+text_count_fields(const char *p, const char *end, const text_format_t *fmt)
+{
+    while (p < end) {
+        const char *line_end = text_line_end(p, end);
+        const char *q = text_data_line(p, line_end, fmt);
+
+        if (q) {
+            rock_uint_t num_fields = 0;
+            double val;
+
+            while (q < line_end && (q = text_parse_double(q, line_end, &val))) {
+                num_fields++;
+                q = text_next_field(q, line_end, fmt->delim);
+            }
+
+            return num_fields;
+        }
+
+        p = line_end + 1;
+    }
+
+    return 0;
+}
+
+/*
+ * Load a tensor from text, one non-zero element per data line.
+ *
+ * The first pass counts the data lines of each range (and finds the
+ * largest coordinates if the dimension sizes aren't given), the second
+ * one parses and packs them straight into the tensor. Symmetric
+ * formats add the mirrored element of every off-diagonal line.
+ */
+static rock_tensor_t *
+text_load(const char *data,
+          size_t size,
+          const text_format_t *fmt,
+          rock_uint_t order,
+          rock_uint_t *dim_size,
+          uint64_t *num_lines)
+{
+    bool discover = dim_size == NULL;
+    bool parse = discover || fmt->symmetry != 0;
+
+    if (order == 0 || order > ROCK_MAX_ORDER) {
+        return NULL;
+    }
+
+    int num_ranges = rock_thread_count((size > ROCK_UINT_MAX) ?
+            ROCK_UINT_MAX : size);
+    size_t *bounds = malloc((num_ranges + 1) * sizeof(size_t));
+    rock_uint_t *offset = calloc(num_ranges + 1, sizeof(rock_uint_t));
+    uint64_t *max = calloc((size_t) num_ranges * order, sizeof(uint64_t));
+    uint64_t lines = 0;
+    int error = 0;
+
+    text_split(data, size, num_ranges, bounds);
+
+    #pragma omp parallel for num_threads(num_ranges) schedule(static, 1) \
+            reduction(|:error) reduction(+:lines)
+    for (int t = 0; t < num_ranges; t++) {
+        const char *p = data + bounds[t];
+        const char *range_end = data + bounds[t+1];
+        uint64_t *range_max = &max[(size_t) t * order];
+        uint64_t coord[ROCK_MAX_ORDER];
+        rock_uint_t count = 0;
+        double val;
+
+        while (p < range_end) {
+            const char *line_end = text_line_end(p, range_end);
+            const char *q = text_data_line(p, line_end, fmt);
+
+            if (q) {
+                count++;
+                lines++;
+                if (parse) {
+                    if (!text_parse_line(q, line_end, fmt, order, coord,
+                                &val)) {
+                        error = 1;
+                        break;
+                    }
+                    for (rock_uint_t k = 0; k < order; k++) {
+                        range_max[k] = (coord[k] > range_max[k]) ?
+                                coord[k] : range_max[k];
+                    }
+                    count += fmt->symmetry && coord[0] != coord[1];
+                }
+            }
+
+            p = line_end + 1;
+        }
+
+        offset[t+1] = count;
+    }
+
+    rock_uint_t sizes[ROCK_MAX_ORDER];
+    for (rock_uint_t k = 0; k < order; k++) {
+        uint64_t largest = 0;
+
+        for (int t = 0; t < num_ranges; t++) {
+            largest = (max[(size_t) t * order + k] > largest) ?
+                    max[(size_t) t * order + k] : largest;
+        }
+
+        sizes[k] = discover ? largest + 1 : dim_size[k];
+        if (largest >= ROCK_UINT_MAX || sizes[k] == 0) {
+            error = 1;
+        }
+    }
+
+    for (int t = 0; t < num_ranges; t++) {
+        offset[t+1] += offset[t];
+    }
+
+    rock_tensor_t *tensor = NULL;
+
+    if (!error) {
+        tensor = rock_tensor_init(order, sizes, offset[num_ranges]);
+
+        /* The packed indices must fit. */
+        rock_desc_t *desc = tensor->desc;
+        if (desc->bit_offset[order-1] + desc->bit_width[order-1] >
+                sizeof(rock_uint_t) * CHAR_BIT) {
+            error = 1;
+        }
+    }
+
+    if (!error) {
+        rock_desc_t *desc = tensor->desc;
+        rock_uint_t *indx_v = tensor->indx->v;
+
+        #pragma omp parallel for num_threads(num_ranges) schedule(static, 1) \
+                reduction(|:error)
+        for (int t = 0; t < num_ranges; t++) {
+            const char *p = data + bounds[t];
+            const char *range_end = data + bounds[t+1];
+            uint64_t coord[ROCK_MAX_ORDER];
+            rock_uint_t i = offset[t];
+            double val;
+
+            while (p < range_end) {
+                const char *line_end = text_line_end(p, range_end);
+                const char *q = text_data_line(p, line_end, fmt);
+
+                if (q) {
+                    if (!text_parse_line(q, line_end, fmt, order, coord,
+                                &val)) {
+                        error = 1;
+                        break;
+                    }
+
+                    rock_uint_t packed = 0;
+                    for (rock_uint_t k = 0; k < order; k++) {
+                        if (coord[k] >= desc->dim_size[k]) {
+                            error = 1;
+                        }
+                        packed |= (rock_uint_t) coord[k] << desc->bit_offset[k];
+                    }
+
+                    indx_v[i] = packed;
+                    tensor->elem->v[i] = val;
+                    i++;
+
+                    if (fmt->symmetry && coord[0] != coord[1]) {
+                        if (coord[0] >= desc->dim_size[1] ||
+                                coord[1] >= desc->dim_size[0]) {
+                            error = 1;
+                        }
+                        indx_v[i] = (rock_uint_t) coord[1] |
+                                (rock_uint_t) coord[0] << desc->bit_offset[1];
+                        tensor->elem->v[i] = fmt->symmetry * val;
+                        i++;
+                    }
+                }
+
+                p = line_end + 1;
+            }
+        }
+    }
+
+    if (error && tensor) {
+        rock_tensor_free(tensor);
+        tensor = NULL;
+    }
+
+    free(bounds);
+    free(offset);
+    free(max);
+
+    if (num_lines) {
+        *num_lines = lines;
+    }
+
+    return tensor;
+}
+
+rock_tensor_t *
+rock_tns_load(char *fname, rock_uint_t order, rock_uint_t *dim_size)
+{
+    text_file_t file;
+
+    if (text_map(fname, &file) != ROCK_OK) {
+        return NULL;
+    }
+
+    if (order == 0) {
+        rock_uint_t num_fields = text_count_fields(file.data,
+                file.data + file.size, &text_tns);
+        order = (num_fields > 1) ? num_fields - 1 : 0;
+    }
+
+    rock_tensor_t *tensor = text_load(file.data, file.size, &text_tns,
+            order, dim_size, NULL);
+
+    text_unmap(&file);
+
+    return tensor;
+}
+
+/*
+ * Copy the next blank separated word of a line in lower case,
+ * returning the end of it.
+ */
+static const char *
+text_word(const char *p, const char *end, char *word, size_t size)
+{
+    size_t len = 0;
+
+    p = text_skip_blank(p, end);
+    for (; p < end && !text_is_blank(*p); p++) {
+        if (len + 1 < size) {
+            word[len++] = (*p >= 'A' && *p <= 'Z') ? *p - 'A' + 'a' : *p;
+        }
+    }
+    word[len] = '\0';
+
+    return p;
+}
+
+rock_tensor_t *
+rock_mm_load(char *fname)
+{
+    text_file_t file;
+
+    if (text_map(fname, &file) != ROCK_OK) {
+        return NULL;
+    }
+
+    const char *p = file.data;
+    const char *end = file.data + file.size;
+    const char *line_end = text_line_end(p, end);
+    char banner[32], object[32], format[32], field[32], symmetry[32];
+    text_format_t fmt = {'%', 0, 1, true, 0};
+    bool valid = true;
+
+    /* %%MatrixMarket matrix coordinate <field> <symmetry> */
+    p = text_word(p, line_end, banner, sizeof(banner));
+    p = text_word(p, line_end, object, sizeof(object));
+    p = text_word(p, line_end, format, sizeof(format));
+    p = text_word(p, line_end, field, sizeof(field));
+    p = text_word(p, line_end, symmetry, sizeof(symmetry));
+
+    valid = strcmp(banner, "%%matrixmarket") == 0 &&
+            strcmp(object, "matrix") == 0 &&
+            strcmp(format, "coordinate") == 0;
+
+    if (strcmp(field, "pattern") == 0) {
+        fmt.value = false;
+    } else if (strcmp(field, "real") != 0 && strcmp(field, "integer") != 0) {
+        valid = false;
+    }
+
+    if (strcmp(symmetry, "symmetric") == 0) {
+        fmt.symmetry = 1;
+    } else if (strcmp(symmetry, "skew-symmetric") == 0) {
+        fmt.symmetry = -1;
+    } else if (strcmp(symmetry, "general") != 0) {
+        valid = false;
+    }
+
+    /* The size line follows the comments: rows, columns, entries. */
+    uint64_t rows = 0, cols = 0, nnz = 0;
+    const char *data = end;
+
+    for (p = line_end + (line_end < end); valid && p < end; ) {
+        const char *q;
+
+        line_end = text_line_end(p, end);
+        q = text_data_line(p, line_end, &fmt);
+
+        if (q) {
+            q = text_parse_uint(q, line_end, &rows);
+            q = q ? text_parse_uint(text_next_field(q, line_end, 0),
+                    line_end, &cols) : NULL;
+            q = q ? text_parse_uint(text_next_field(q, line_end, 0),
+                    line_end, &nnz) : NULL;
+
+            valid = q && text_skip_blank(q, line_end) == line_end &&
+                    rows > 0 && cols > 0 &&
+                    rows < ROCK_UINT_MAX && cols < ROCK_UINT_MAX;
+            data = line_end + (line_end < end);
+            break;
+        }
+
+        p = line_end + 1;
+    }
+
+    rock_tensor_t *tensor = NULL;
+
+    if (valid && data <= end) {
+        rock_uint_t dim_size[] = {rows, cols};
+        uint64_t num_lines;
+
+        tensor = text_load(data, end - data, &fmt, 2, dim_size, &num_lines);
+
+        if (tensor && num_lines != nnz) {
+            rock_tensor_free(tensor);
+            tensor = NULL;
+        }
+    }
+
+    text_unmap(&file);
+
+    return tensor;
+}
+
+rock_tensor_t *
+rock_csv_load(char *fname,
+              char delim,
+              rock_uint_t base,
+              rock_uint_t order,
+              rock_uint_t *dim_size)
+{
+    text_file_t file;
+
+    if (text_map(fname, &file) != ROCK_OK) {
+        return NULL;
+    }
+
+    text_format_t fmt = {'#', delim, base, true, 0};
+    const char *data = file.data;
+    const char *end = file.data + file.size;
+
+    /* Skip a header, i.e., a first data line not starting by a number. */
+    for (const char *p = data; p < end; ) {
+        const char *line_end = text_line_end(p, end);
+        const char *q = text_data_line(p, line_end, &fmt);
+        double val;
+
+        if (q) {
+            if (text_parse_double(q, line_end, &val) == NULL) {
+                data = line_end + (line_end < end);
+            }
+            break;
+        }
+
+        p = line_end + 1;
+    }
+
+    /* The last column holds the values, unless all are coordinates. */
+    rock_uint_t num_fields = text_count_fields(data, end, &fmt);
+    if (order == 0) {
+        order = (num_fields > 1) ? num_fields - 1 : 0;
+    }
+    fmt.value = num_fields != order;
+
+    rock_tensor_t *tensor = text_load(data, end - data, &fmt, order,
+            dim_size, NULL);
+
+    text_unmap(&file);
+
+    return tensor;
+}
+
+/*
+ * Format an unsigned integer, returning the end of it.
+ */
+static inline char *
+text_format_uint(char *p, uint64_t val)
+{
+    char digits[20];
+    int n = 0;
+
+    do {
+        digits[n++] = '0' + val % 10;
+        val /= 10;
+    } while (val);
+
+    while (n > 0) {
+        *p++ = digits[--n];
+    }
+
+    return p;
+}
+
+/*
+ * Format a value using as few digits as needed to parse it back
+ * exactly, with a '.' as decimal point regardless of the locale.
+ */
+static char *
+text_format_double(char *p, double val, char point)
+{
+    double back;
+    int len = sprintf(p, "%.*g", TEXT_SHORT_DIGITS, val);
+
+    for (int i = 0; i < len; i++) {
+        p[i] = (p[i] == point) ? '.' : p[i];
+    }
+
+#ifdef ROCK_ELEM_FLOAT
+    if (!text_parse_double(p, p + len, &back) || (float) back != (float) val) {
+#else
+    if (!text_parse_double(p, p + len, &back) || back != val) {
+#endif
+        len = sprintf(p, "%.*g", TEXT_EXACT_DIGITS, val);
+        for (int i = 0; i < len; i++) {
+            p[i] = (p[i] == point) ? '.' : p[i];
+        }
+    }
+
+    return p + len;
+}
+
+int
+rock_tns_save(rock_tensor_t *tensor, char *fname)
+{
+    rock_desc_t *desc = tensor->desc;
+    rock_uint_t len = tensor->indx->len;
+    rock_uint_t order = desc->order;
+
+    FILE *file = fopen(fname, "w");
+    if (file == NULL) {
+        return ROCK_ERR;
+    }
+
+    int num_threads = rock_thread_count(len);
+    size_t buf_size = (size_t) TEXT_BLOCK_LEN * TEXT_MAX_LINE(order);
+    char **buf = malloc(num_threads * sizeof(char *));
+    size_t *buf_len = calloc(num_threads, sizeof(size_t));
+    char point = localeconv()->decimal_point[0];
+    int status = ROCK_OK;
+
+    for (int t = 0; t < num_threads; t++) {
+        buf[t] = malloc(buf_size);
+    }
+
+    /* Every round formats one block per thread, then writes them. */
+    for (uint64_t first = 0; first < len;
+            first += (uint64_t) num_threads * TEXT_BLOCK_LEN) {
+        #pragma omp parallel for num_threads(num_threads) schedule(static, 1)
+        for (int t = 0; t < num_threads; t++) {
+            uint64_t begin = first + (uint64_t) t * TEXT_BLOCK_LEN;
+            uint64_t stop = begin + TEXT_BLOCK_LEN;
+            char *p = buf[t];
+
+            for (uint64_t i = begin; i < len && i < stop; i++) {
+                rock_uint_t v = tensor->indx->v[i];
+
+                for (rock_uint_t k = 0; k < order; k++) {
+                    rock_uint_t c = (v & desc->bit_mask[k]) >>
+                            desc->bit_offset[k];
+
+                    p = text_format_uint(p, (uint64_t) c + 1);
+                    *p++ = ' ';
+                }
+                p = text_format_double(p, tensor->elem->v[i], point);
+                *p++ = '\n';
+            }
+
+            buf_len[t] = p - buf[t];
+        }
+
+        for (int t = 0; t < num_threads; t++) {
+            if (fwrite(buf[t], 1, buf_len[t], file) != buf_len[t]) {
+                status = ROCK_ERR;
+            }
+        }
+    }
+
+    for (int t = 0; t < num_threads; t++) {
+        free(buf[t]);
+    }
+    free(buf);
+    free(buf_len);
+
+    if (fclose(file) != 0) {
+        status = ROCK_ERR;
+    }
+
+    return status;
+}
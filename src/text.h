@@ -0,0 +1,104 @@
+/**
+ * @file text.h
+ * @author timoteus <mail@timoteus.se>
+ *
+ * Import and export of tensors stored as text, one non-zero element
+ * per line, e.g., the FROSTT format (.tns), MatrixMarket coordinate
+ * files (.mtx), or comma separated values (.csv):
+ *
+ *     # comment
+ *     1 1 3 0.5
+ *     2 4 1 -1.25e-3
+ *
+ * i.e., the (one-based) coordinates followed by the value, separated
+ * by blanks. The file is memory mapped and split into one range of
+ * lines per thread. Numbers are parsed by the library (independent of
+ * the locale) and packed into the index array as they are parsed.
+ */
+
+#ifndef _TEXT_H
+#define _TEXT_H
+
+#include "core.h"
+#include "tensor.h"
+
+/**
+ * Load a tensor from a FROSTT (.tns) file.
+ *
+ * If the dimension sizes aren't given, they are discovered as the
+ * largest coordinate of each dimension, which takes an extra pass over
+ * the file.
+ *
+ * @param [in] fname
+ * @param [in] order        The order of the tensor, or 0 to count the
+ *                          columns of the first line.
+ * @param [in] dim_size     The dimension sizes (order), or NULL to
+ *                          discover them.
+ * @return                  Initialized and populated tensor object, or
+ *                          NULL if the file can't be read, a line can't
+ *                          be parsed, a coordinate is out of range, or
+ *                          the indices don't fit in @c rock_uint_t.
+ */
+rock_tensor_t *
+rock_tns_load(char *fname, rock_uint_t order, rock_uint_t *dim_size);
+
+/**
+ * Load a sparse matrix from a MatrixMarket coordinate file (.mtx).
+ *
+ * Supports real, integer and pattern (values of 1) matrices, either
+ * general, symmetric or skew-symmetric. Only one triangle of the
+ * latter two is stored in the file, the other one is added while
+ * loading. The dimension sizes are those of the size line.
+ *
+ * @param [in] fname
+ * @return                  Initialized and populated tensor object of
+ *                          order 2, or NULL if the file can't be read,
+ *                          isn't supported, or doesn't match its size
+ *                          line.
+ */
+rock_tensor_t *
+rock_mm_load(char *fname);
+
+/**
+ * Load a tensor from a file of comma (or otherwise) separated values.
+ *
+ * Every line holds the coordinates of an element followed by its
+ * value. Without values (as many columns as the order), all elements
+ * are 1. A first line not starting with a number (a header) is
+ * skipped, as are lines starting with '#'. Quoted fields aren't
+ * supported.
+ *
+ * @param [in] fname
+ * @param [in] delim        The separator, e.g., ',' or ';' (blanks
+ *                          around it are skipped as well).
+ * @param [in] base         The coordinate of the first index of a
+ *                          dimension, e.g., 0 or 1.
+ * @param [in] order        The order of the tensor, or 0 to count the
+ *                          columns of the first line (the last of which
+ *                          holds the values).
+ * @param [in] dim_size     The dimension sizes (order), or NULL to
+ *                          discover them in a first pass.
+ * @return                  Initialized and populated tensor object, or
+ *                          NULL as @c rock_tns_load.
+ */
+rock_tensor_t *
+rock_csv_load(char *fname,
+              char delim,
+              rock_uint_t base,
+              rock_uint_t order,
+              rock_uint_t *dim_size);
+
+/**
+ * Save a tensor to a FROSTT (.tns) file.
+ *
+ * Lines are formatted in parallel. Values are written with enough
+ * digits to be loaded back exactly.
+ *
+ * @param [in] tensor
+ * @param [in] fname
+ * @return                  ROCK_OK or ROCK_ERR.
+ */
+int
+rock_tns_save(rock_tensor_t *tensor, char *fname);
+
+#endif
@@ -0,0 +1,166 @@
+/**
+ * @file test_codec.c
+ * @author timoteus <mail@timoteus.se>
+ */
+
+#include "core.h"
+#include "codec.h"
+#include "random.h"
+#include "sort.h"
+
+/*
+ * Encode and decode values, return the encoded size.
+ */
+size_t
+roundtrip(rock_uint_t *v, rock_uint_t len)
+{
+    size_t size = rock_codec_size(v, len);
+    uint8_t *buf = malloc(size + 1);
+    rock_uint_t *dec = malloc((len + 1) * sizeof(rock_uint_t));
+
+    assert(size <= len * ROCK_CODEC_MAX_BYTES);
+    assert(rock_codec_encode(v, len, buf) == size);
+    assert(rock_codec_decode(buf, len, dec) == size);
+    assert(memcmp(v, dec, len * sizeof(rock_uint_t)) == 0);
+
+    free(buf);
+    free(dec);
+
+    return size;
+}
+
+/*
+ * Unit test of rock_codec_encode() and rock_codec_decode().
+ */
+void
+test_rock_codec()
+{
+    /* The example of codec.h. */
+    rock_uint_t example[] = {100, 103, 101, 300};
+    uint8_t expected[] = {0xc8, 0x01, 0x06, 0x03, 0x8e, 0x03};
+    uint8_t buf[sizeof(expected)];
+
+    assert(rock_codec_encode(example, 4, buf) == sizeof(expected));
+    assert(memcmp(buf, expected, sizeof(expected)) == 0);
+
+    /* Extremes, including the largest possible jumps. */
+    rock_uint_t extremes[] = {0, ROCK_UINT_MAX, 0, 1, ROCK_UINT_MAX - 1, 5};
+    assert(roundtrip(extremes, 6) <= 6 * ROCK_CODEC_MAX_BYTES);
+    assert(roundtrip(NULL, 0) == 0);
+
+    /* Sorted indices compress, unsorted ones still round-trip. */
+    rock_uint_t order = 3;
+    rock_uint_t nnz = 1e5;
+    rock_uint_t dim_size[] = {256, 16, 1024};
+    rock_uint_t dims[] = {2, 1, 0};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+    rock_indx_t *indx = rock_indx_init(nnz);
+
+    rock_indx_sample(desc, indx);
+    roundtrip(indx->v, indx->len);
+
+    rock_indx_sort(desc, order, dims, NULL, indx);
+    assert(roundtrip(indx->v, indx->len) <
+            indx->len * sizeof(rock_uint_t) / 2);
+
+    rock_indx_free(indx);
+    rock_desc_free(desc);
+}
+
+/*
+ * Pack and unpack values, return the packed size.
+ */
+size_t
+roundtrip_packed(rock_uint_t *v, rock_uint_t len)
+{
+    size_t size = rock_codec_pack_size(v, len);
+    uint8_t *buf = malloc(size + 1);
+    rock_uint_t *dec = malloc((len + 1) * sizeof(rock_uint_t));
+
+    assert(rock_codec_pack(v, len, buf) == size);
+    assert(rock_codec_unpack(buf, size, len, dec) == size);
+    assert(memcmp(v, dec, len * sizeof(rock_uint_t)) == 0);
+
+    /* Truncated input is detected. */
+    if (len > 0) {
+        assert(rock_codec_unpack(buf, size - 1, len, dec) == 0);
+    }
+
+    free(buf);
+    free(dec);
+
+    return size;
+}
+
+/*
+ * Unit test of rock_codec_pack() and rock_codec_unpack().
+ */
+void
+test_rock_codec_pack()
+{
+    /* The example of codec.h, nine bits each. */
+    rock_uint_t example[] = {100, 103, 101, 300};
+    assert(rock_codec_pack_size(example, 4) == 2 + (4 * 9 + 7) / 8);
+    roundtrip_packed(example, 4);
+
+    /* Corrupt headers are detected. */
+    uint8_t corrupt[16] = {0};
+    rock_uint_t dec[4];
+    corrupt[0] = sizeof(rock_uint_t) * CHAR_BIT + 1;
+    assert(rock_codec_unpack(corrupt, sizeof(corrupt), 4, dec) == 0);
+    corrupt[0] = 1;
+    corrupt[1] = 5;
+    assert(rock_codec_unpack(corrupt, sizeof(corrupt), 4, dec) == 0);
+    corrupt[1] = 1;
+    corrupt[3] = 4;
+    assert(rock_codec_unpack(corrupt, sizeof(corrupt), 4, dec) == 0);
+    /* Extremes, the largest possible jump needs the full width. */
+    rock_uint_t extremes[] = {0, ROCK_UINT_MAX, 0, 1, ROCK_UINT_MAX - 1, 5};
+    assert(roundtrip_packed(extremes, 6) <= 2 + 6 * sizeof(rock_uint_t));
+    rock_uint_t jumps[] = {ROCK_UINT_MAX / 2 + 1, 0};
+    assert(roundtrip_packed(jumps, 2) == 2 + 2 * sizeof(rock_uint_t));
+
+    /* A single jump is an exception. */
+    rock_uint_t steps[ROCK_CODEC_BLOCK_LEN];
+    for (rock_uint_t i = 0; i < ROCK_CODEC_BLOCK_LEN; i++) {
+        steps[i] = i + ((i < 100) ? 0 : 1000000);
+    }
+    assert(roundtrip_packed(steps, ROCK_CODEC_BLOCK_LEN) <
+            2 + ROCK_CODEC_BLOCK_LEN * 2 / 8 + 1 + ROCK_CODEC_MAX_BYTES);
+    assert(roundtrip_packed(NULL, 0) == 0);
+
+    /* Constant runs take two bytes per block. */
+    rock_uint_t *same = calloc(3 * ROCK_CODEC_BLOCK_LEN + 5,
+            sizeof(rock_uint_t));
+    assert(roundtrip_packed(same, 3 * ROCK_CODEC_BLOCK_LEN + 5) == 8);
+    free(same);
+
+    /* Sorted indices pack tighter than varints. */
+    rock_uint_t order = 3;
+    rock_uint_t nnz = 1e5 + 3;
+    rock_uint_t dim_size[] = {256, 16, 1024};
+    rock_uint_t dims[] = {2, 1, 0};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+    rock_indx_t *indx = rock_indx_init(nnz);
+
+    rock_indx_sample(desc, indx);
+    roundtrip_packed(indx->v, indx->len);
+
+    rock_indx_sort(desc, order, dims, NULL, indx);
+    assert(roundtrip_packed(indx->v, indx->len) <=
+            rock_codec_size(indx->v, indx->len));
+
+    rock_indx_free(indx);
+    rock_desc_free(desc);
+}
+
+int
+main()
+{
+    srand(time(NULL));
+
+    test_rock_codec();
+    test_rock_codec_pack();
+
+    return ROCK_OK;
+}
@@ -131,6 +131,121 @@ test_rock_freq(rock_desc_t *desc, rock_indx_t *indx)
     rock_freq_free(freq);
 }
 
+/**
+ * Unit test of rock_part_freq_based().
+ */
+void
+test_rock_part_freq_based()
+{
+    rock_uint_t order = 2;
+    rock_uint_t dim_size[] = {8, 4};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    /* Heavily skewed towards the first indices of dimension 0. */
+    rock_uint_t dim_0[] = {0, 0, 0, 0, 1, 1, 2, 3, 4, 5, 6, 7};
+    rock_uint_t nnz = sizeof(dim_0) / sizeof(rock_uint_t);
+    rock_indx_t *indx = rock_indx_init(nnz);
+    for (rock_uint_t i = 0; i < nnz; i++) {
+        rock_indx_insert(desc, indx, i, 0, dim_0[i]);
+        rock_indx_insert(desc, indx, i, 1, i % dim_size[1]);
+    }
+
+    rock_freq_t *freq = rock_freq_init(desc, indx);
+    rock_part_t *part = rock_part_init(3);
+
+    assert(rock_part_freq_based(freq, part, 0) == ROCK_OK);
+
+    /* Four non-zeros per part. */
+    assert(part->offset[0] == 0);
+    assert(part->offset[1] == 1);
+    assert(part->offset[2] == 4);
+    assert(part->offset[3] == 8);
+
+    /* Every part gets at least one index, even without any non-zeros. */
+    rock_part_t *part_many = rock_part_init(4);
+    assert(rock_part_freq_based(freq, part_many, 1) == ROCK_OK);
+    for (rock_uint_t k = 0; k < part_many->num_parts; k++) {
+        assert(part_many->offset[k] < part_many->offset[k+1]);
+    }
+
+    rock_part_t *part_err = rock_part_init(5);
+    assert(rock_part_freq_based(freq, part_err, 1) == ROCK_BAD_INPUT);
+    assert(rock_part_freq_based(freq, part_err, 2) == ROCK_BAD_INPUT);
+
+    rock_part_free(part);
+    rock_part_free(part_many);
+    rock_part_free(part_err);
+    rock_freq_free(freq);
+    rock_indx_free(indx);
+    rock_desc_free(desc);
+}
+
+/**
+ * Unit test of rock_lmap_init(), rock_lmap_free(), rock_lmap_freq_based(),
+ * rock_indx_relabel(), rock_indx_relabel_inv().
+ */
+void
+test_rock_lmap()
+{
+    rock_uint_t order = 2;
+    rock_uint_t dim_size[] = {12, 6};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    /* Non-zeros crowd the first three indices of dimension 0. */
+    rock_uint_t nnz = 60;
+    rock_indx_t *indx = rock_indx_init(nnz);
+    for (rock_uint_t i = 0; i < nnz; i++) {
+        rock_indx_insert(desc, indx, i, 0, (i < 48) ? i % 3 : i % 12);
+        rock_indx_insert(desc, indx, i, 1, i % 6);
+    }
+    rock_indx_t *indx_orig = rock_indx_copy(indx);
+
+    rock_freq_t *freq = rock_freq_init(desc, indx);
+    rock_lmap_t *lmap = rock_lmap_init(desc);
+
+    rock_uint_t dim_num_parts[] = {3, 1};
+    assert(rock_lmap_freq_based(lmap, freq, dim_num_parts) == ROCK_OK);
+
+    /* Maps are bijections and inverses of each other. */
+    for (rock_uint_t i = 0; i < order; i++) {
+        for (rock_uint_t k = 0; k < dim_size[i]; k++) {
+            assert(lmap->dim_map[i][k] < dim_size[i]);
+            assert(lmap->dim_inv[i][lmap->dim_map[i][k]] == k);
+        }
+    }
+
+    /* The three hot indices end up in different parts. */
+    rock_part_t *part = rock_part_init(3);
+    rock_part_desc_based(desc, part, 0);
+    bool hit[3] = {false, false, false};
+    for (rock_uint_t k = 0; k < 3; k++) {
+        for (rock_uint_t p = 0; p < 3; p++) {
+            rock_uint_t new = lmap->dim_map[0][k];
+            if (new >= part->offset[p] && new < part->offset[p+1]) {
+                assert(!hit[p]);
+                hit[p] = true;
+            }
+        }
+    }
+
+    rock_indx_relabel(lmap, indx);
+    assert(!rock_indx_eq(indx, indx_orig));
+    for (rock_uint_t i = 0; i < nnz; i++) {
+        assert(rock_indx_extract(desc, indx, i, 0) ==
+                lmap->dim_map[0][rock_indx_extract(desc, indx_orig, i, 0)]);
+    }
+
+    rock_indx_relabel_inv(lmap, indx);
+    assert(rock_indx_eq(indx, indx_orig));
+
+    rock_part_free(part);
+    rock_lmap_free(lmap);
+    rock_freq_free(freq);
+    rock_indx_free(indx);
+    rock_indx_free(indx_orig);
+    rock_desc_free(desc);
+}
+
 /**
  * Unit test of rock_view_init(), rock_view_free().
  */
@@ -168,6 +283,8 @@ main()
 
     test_rock_part(desc, indx, 4);
     test_rock_freq(desc, indx);
+    test_rock_part_freq_based();
+    test_rock_lmap();
     test_rock_view(desc, indx, 2);
 
     rock_desc_free(desc);
@@ -7,6 +7,8 @@
 #include "sort.h"
 #include "random.h"
 #include "disk.h"
+#include "tensor.h"
+#include "hdf5_hl.h"
 
 /**
  * Unit test of rock_indx_save() and rock_indx_load().
@@ -42,12 +44,389 @@ test_rock_indx_save_load()
     rock_indx_free(indx_loaded);
 }
 
+/**
+ * Unit test of rock_tensor_save() and rock_tensor_load().
+ */
+void
+test_rock_tensor_save_load()
+{
+    char *fname = "test_rock_tensor_save_load.hdf5";
+
+    rock_uint_t order = 3;
+    rock_uint_t dim_size[] = {20, 500, 1000};
+    rock_uint_t nnz = 500;
+
+    rock_tensor_t *tensor = rock_tensor_init(order, dim_size, nnz);
+    rock_tensor_sample(tensor);
+    assert(tensor->sorted_dim == ROCK_UINT_MAX);
+    rock_tensor_sort(tensor, 1);
+    assert(tensor->sorted_dim == 1);
+
+    rock_part_t *part = rock_part_init(4);
+    for (rock_uint_t k = 0; k <= part->num_parts; k++) {
+        part->offset[k] = k * nnz / part->num_parts;
+    }
+
+    /* Everything is restored from the file alone. */
+    assert(rock_tensor_save(tensor, part, fname) == ROCK_OK);
+
+    rock_part_t *part_loaded = NULL;
+    rock_tensor_t *loaded = rock_tensor_load(&part_loaded, fname);
+
+    assert(loaded != NULL);
+    assert(loaded->desc->order == order);
+    for (rock_uint_t i = 0; i < order; i++) {
+        assert(loaded->desc->dim_size[i] == dim_size[i]);
+        assert(loaded->desc->bit_offset[i] == tensor->desc->bit_offset[i]);
+    }
+    assert(loaded->sorted_dim == 1);
+    assert(rock_indx_eq(loaded->indx, tensor->indx));
+    assert(rock_elem_eq(loaded->elem, tensor->elem));
+
+    assert(part_loaded != NULL);
+    assert(part_loaded->num_parts == part->num_parts);
+    for (rock_uint_t k = 0; k <= part->num_parts; k++) {
+        assert(part_loaded->offset[k] == part->offset[k]);
+    }
+
+    rock_tensor_free(loaded);
+    rock_part_free(part_loaded);
+
+    /* Offsets must split the elements, not the indices of a dimension. */
+    part->offset[part->num_parts] = dim_size[2];
+    assert(rock_tensor_save(tensor, part, fname) == ROCK_BAD_INPUT);
+    part->offset[part->num_parts] = nnz;
+    part->offset[1] = part->offset[2] + 1;
+    assert(rock_tensor_save(tensor, part, fname) == ROCK_BAD_INPUT);
+
+    /* Unsorted and without partition. */
+    rock_tensor_shuffle(tensor);
+    assert(rock_tensor_save(tensor, NULL, fname) == ROCK_OK);
+
+    loaded = rock_tensor_load(&part_loaded, fname);
+    assert(loaded != NULL);
+    assert(loaded->sorted_dim == ROCK_UINT_MAX);
+    assert(part_loaded == NULL);
+    assert(rock_indx_eq(loaded->indx, tensor->indx));
+
+    assert(rock_tensor_load(NULL, "test_rock_tensor_missing.hdf5") == NULL);
+
+    rock_tensor_free(loaded);
+    rock_tensor_free(tensor);
+    rock_part_free(part);
+}
+
+/*
+ * The size of a file in bytes.
+ */
+long
+file_size(char *fname)
+{
+    FILE *f = fopen(fname, "rb");
+    fseek(f, 0, SEEK_END);
+    long size = ftell(f);
+    fclose(f);
+
+    return size;
+}
+
+/**
+ * Unit test of chunked and compressed storage (rock_save_mode).
+ */
+void
+test_rock_save_mode()
+{
+    char *fname = "test_rock_save_mode.hdf5";
+    int modes[] = {ROCK_SAVE_PLAIN, ROCK_SAVE_DEFLATE, ROCK_SAVE_BITPACK};
+    long size[3];
+
+    rock_uint_t order = 3;
+    rock_uint_t dim_size[] = {100, 10, 1000};
+    rock_uint_t dims[] = {2, 1, 0};
+    rock_uint_t nnz = 50000;
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    rock_indx_t *indx = rock_indx_init(nnz);
+    rock_elem_t *elem = rock_elem_init(nnz);
+    rock_indx_sample(desc, indx);
+    rock_elem_sample(desc, elem);
+    rock_indx_sort(desc, order, dims, NULL, indx);
+
+    /* Several chunks, the last one partial. */
+    rock_save_chunk_len = 12345;
+
+    for (int m = 0; m < 3; m++) {
+        rock_save_mode = modes[m];
+
+        rock_indx_t *indx_loaded = rock_indx_init(nnz);
+        assert(rock_indx_save(indx, fname) == ROCK_OK);
+        size[m] = file_size(fname);
+        assert(rock_indx_load(indx_loaded, fname) == ROCK_OK);
+        assert(rock_indx_eq(indx, indx_loaded));
+        rock_indx_free(indx_loaded);
+
+        rock_elem_t *elem_loaded = rock_elem_init(nnz);
+        assert(rock_elem_save(elem, fname) == ROCK_OK);
+        assert(rock_elem_load(elem_loaded, fname) == ROCK_OK);
+        assert(rock_elem_eq(elem, elem_loaded));
+        rock_elem_free(elem_loaded);
+    }
+
+    /* Sorted indices compress, bit-packing the most. */
+    assert(size[1] < size[0]);
+    assert(size[2] < size[1]);
+
+    /* Empty arrays. */
+    rock_indx_t *empty = rock_indx_init(0);
+    assert(rock_indx_save(empty, fname) == ROCK_OK);
+    assert(rock_indx_load(empty, fname) == ROCK_OK);
+    rock_indx_free(empty);
+
+    rock_save_mode = ROCK_USE_DEFAULT;
+    rock_save_chunk_len = ROCK_USE_DEFAULT;
+
+    rock_desc_free(desc);
+    rock_indx_free(indx);
+    rock_elem_free(elem);
+}
+
+/**
+ * Unit test of rock_iter_init(), rock_iter_next() and rock_iter_free().
+ */
+void
+test_rock_iter()
+{
+    char *fname = "test_rock_iter.hdf5";
+
+    rock_uint_t order = 3;
+    rock_uint_t dim_size[] = {20, 500, 1000};
+    rock_uint_t nnz = 10007;
+    rock_uint_t block_len = 999;
+
+    rock_tensor_t *tensor = rock_tensor_init(order, dim_size, nnz);
+    rock_tensor_sample(tensor);
+
+    /* Blocks straddle the chunks. */
+    rock_save_mode = ROCK_SAVE_BITPACK;
+    rock_save_chunk_len = 1000;
+    assert(rock_tensor_save(tensor, NULL, fname) == ROCK_OK);
+    rock_save_mode = ROCK_USE_DEFAULT;
+    rock_save_chunk_len = ROCK_USE_DEFAULT;
+
+    /* Count frequencies a block at a time. */
+    rock_freq_t *freq = rock_freq_init(tensor->desc, tensor->indx);
+    rock_uint_t *dim_freq = calloc(dim_size[1], sizeof(rock_uint_t));
+    rock_uint_t num_blocks = 0;
+
+    rock_iter_t *iter = rock_iter_init(fname, fname, block_len);
+    assert(iter != NULL);
+    assert(iter->len == nnz);
+
+    while (rock_iter_next(iter)) {
+        assert(iter->offset == num_blocks * block_len);
+        assert(iter->indx->len <= block_len);
+        assert(iter->elem->len == iter->indx->len);
+
+        for (rock_uint_t i = 0; i < iter->indx->len; i++) {
+            rock_uint_t j = iter->offset + i;
+
+            assert(iter->indx->v[i] == tensor->indx->v[j]);
+            assert(iter->elem->v[i] == tensor->elem->v[j]);
+            dim_freq[rock_indx_extract(tensor->desc, iter->indx, i, 1)]++;
+        }
+        num_blocks++;
+    }
+
+    assert(iter->status == ROCK_OK);
+    assert(num_blocks == (nnz + block_len - 1) / block_len);
+    assert(!rock_iter_next(iter));
+    for (rock_uint_t k = 0; k < dim_size[1]; k++) {
+        assert(dim_freq[k] == freq->dim_freq[1][k]);
+    }
+    rock_iter_free(iter);
+
+    /* Indices only, stopping early. */
+    iter = rock_iter_init(fname, NULL, nnz);
+    assert(iter->elem == NULL);
+    assert(rock_iter_next(iter));
+    assert(rock_indx_eq(iter->indx, tensor->indx));
+    rock_iter_free(iter);
+
+    assert(rock_iter_init("test_rock_iter_missing.hdf5", NULL, 10) == NULL);
+
+    free(dim_freq);
+    rock_freq_free(freq);
+    rock_tensor_free(tensor);
+}
+
+/**
+ * Unit test of rock_indx_load_range(), rock_elem_load_range() and
+ * rock_tensor_load_part().
+ */
+void
+test_rock_load_range()
+{
+    char *fname = "test_rock_load_range.hdf5";
+
+    rock_uint_t order = 3;
+    rock_uint_t dim_size[] = {20, 500, 1000};
+    rock_uint_t nnz = 5000;
+
+    rock_tensor_t *tensor = rock_tensor_init(order, dim_size, nnz);
+    rock_tensor_sample(tensor);
+    rock_tensor_sort(tensor, 0);
+
+    /* Split the sorted tensor into parts of uneven length. */
+    rock_part_t *part = rock_part_init(3);
+    part->offset[1] = 1000;
+    part->offset[2] = 3500;
+    part->offset[3] = nnz;
+
+    rock_save_mode = ROCK_SAVE_DEFLATE;
+    rock_save_chunk_len = 700;
+    assert(rock_tensor_save(tensor, part, fname) == ROCK_OK);
+    rock_save_mode = ROCK_USE_DEFAULT;
+    rock_save_chunk_len = ROCK_USE_DEFAULT;
+
+    /* Ranges. */
+    rock_indx_t *indx = rock_indx_init(123);
+    rock_elem_t *elem = rock_elem_init(123);
+    assert(rock_indx_load_range(indx, fname, 2345) == ROCK_OK);
+    assert(rock_elem_load_range(elem, fname, 2345) == ROCK_OK);
+    for (rock_uint_t i = 0; i < indx->len; i++) {
+        assert(indx->v[i] == tensor->indx->v[2345 + i]);
+        assert(elem->v[i] == tensor->elem->v[2345 + i]);
+    }
+
+    assert(rock_indx_load_range(indx, fname, nnz - 123) == ROCK_OK);
+    assert(rock_indx_load_range(indx, fname, nnz - 122) == ROCK_BAD_INPUT);
+
+    /* Parts. */
+    for (rock_uint_t k = 0; k < part->num_parts; k++) {
+        rock_tensor_t *loaded = rock_tensor_load_part(fname, k);
+
+        assert(loaded != NULL);
+        assert(loaded->sorted_dim == 0);
+        assert(loaded->desc->order == order);
+        assert(loaded->indx->len == part->offset[k + 1] - part->offset[k]);
+        for (rock_uint_t i = 0; i < loaded->indx->len; i++) {
+            assert(loaded->indx->v[i] ==
+                    tensor->indx->v[part->offset[k] + i]);
+            assert(loaded->elem->v[i] ==
+                    tensor->elem->v[part->offset[k] + i]);
+        }
+
+        rock_tensor_free(loaded);
+    }
+    assert(rock_tensor_load_part(fname, part->num_parts) == NULL);
+    assert(rock_tensor_load_part(fname, part->num_parts + 1) == NULL);
+    assert(rock_tensor_load_part(fname, ROCK_UINT_MAX) == NULL);
+
+    /* No partition saved. */
+    assert(rock_tensor_save(tensor, NULL, fname) == ROCK_OK);
+    assert(rock_tensor_load_part(fname, 0) == NULL);
+
+    /* Offsets not splitting the elements, e.g., indices of a dimension. */
+    rock_uint_t dim_offset[] = {0, 10, dim_size[0]};
+    hsize_t dims[] = {3};
+    hid_t file_id = H5Fopen(fname, H5F_ACC_RDWR, H5P_DEFAULT);
+    H5LTmake_dataset(file_id, "/part_offset", 1, dims, ROCK_UINT_H5T,
+            dim_offset);
+    H5Fclose(file_id);
+    assert(rock_tensor_load_part(fname, 0) == NULL);
+    rock_part_t *bad_part = NULL;
+    assert(rock_tensor_load(&bad_part, fname) == NULL);
+
+    rock_indx_free(indx);
+    rock_elem_free(elem);
+    rock_part_free(part);
+    rock_tensor_free(tensor);
+}
+
+/**
+ * Unit test of rock_tensor_save_native() and rock_tensor_mmap().
+ */
+void
+test_rock_tensor_mmap()
+{
+    char *fname = "test_rock_tensor_mmap.bin";
+
+    rock_uint_t order = 4;
+    rock_uint_t dim_size[] = {20, 500, 4, 1000};
+    rock_uint_t nnz = 5000;
+
+    rock_tensor_t *tensor = rock_tensor_init(order, dim_size, nnz);
+    rock_tensor_sample(tensor);
+    rock_tensor_sort(tensor, 2);
+    assert(rock_tensor_save_native(tensor, fname) == ROCK_OK);
+
+    rock_tensor_t *mapped = rock_tensor_mmap(fname);
+    assert(mapped != NULL);
+    assert(mapped->map != NULL);
+    assert(mapped->sorted_dim == 2);
+    assert(mapped->desc->order == order);
+    for (rock_uint_t i = 0; i < order; i++) {
+        assert(mapped->desc->dim_size[i] == dim_size[i]);
+    }
+
+    /* The arrays point into the aligned mapping. */
+    assert((char *) mapped->indx->v - (char *) mapped->map ==
+            ROCK_NATIVE_ALIGN);
+    assert(((char *) mapped->elem->v - (char *) mapped->map) %
+            ROCK_NATIVE_ALIGN == 0);
+    assert(rock_indx_eq(mapped->indx, tensor->indx));
+    assert(rock_elem_eq(mapped->elem, tensor->elem));
+
+    /* Private mapping, sorting leaves the file untouched. */
+    rock_tensor_sort(mapped, 0);
+    rock_tensor_free(mapped);
+
+    mapped = rock_tensor_mmap(fname);
+    assert(rock_indx_eq(mapped->indx, tensor->indx));
+
+    /* Detached arrays are allocated like any others. */
+    rock_tensor_detach(mapped);
+    assert(mapped->map == NULL);
+    assert(rock_indx_eq(mapped->indx, tensor->indx));
+    assert(rock_elem_eq(mapped->elem, tensor->elem));
+    mapped->indx->v = realloc(mapped->indx->v, 2 * nnz * sizeof(rock_uint_t));
+    rock_tensor_detach(mapped);
+    rock_tensor_free(mapped);
+
+    /* Lengths overflowing the mapping are rejected (after magic, sizes). */
+    uint64_t huge = UINT64_MAX / 2;
+    FILE *file = fopen(fname, "r+b");
+    fseek(file, 24, SEEK_SET);
+    fwrite(&huge, sizeof(huge), 1, file);
+    fclose(file);
+    assert(rock_tensor_mmap(fname) == NULL);
+
+    /* Empty tensors and files of other formats. */
+    rock_tensor_t *empty = rock_tensor_init(order, dim_size, 0);
+    assert(rock_tensor_save_native(empty, fname) == ROCK_OK);
+    mapped = rock_tensor_mmap(fname);
+    assert(mapped != NULL && mapped->indx->len == 0);
+    rock_tensor_free(mapped);
+    rock_tensor_free(empty);
+
+    assert(rock_tensor_save(tensor, NULL, fname) == ROCK_OK);
+    assert(rock_tensor_mmap(fname) == NULL);
+    assert(rock_tensor_mmap("test_rock_tensor_mmap_missing.bin") == NULL);
+
+    rock_tensor_free(tensor);
+}
+
 int
 main()
 {
     srand(time(NULL));
 
     test_rock_indx_save_load();
+    test_rock_tensor_save_load();
+    test_rock_save_mode();
+    test_rock_iter();
+    test_rock_load_range();
+    test_rock_tensor_mmap();
 
     return ROCK_OK;
 }
@@ -8,6 +8,152 @@
 #include "sort.h"
 #include "print.h"
 #include "random.h"
+#include <unistd.h>
+
+/*
+ * Unit test of rock_mesh_init() and rock_mesh_free().
+ */
+int
+test_mesh()
+{
+    rock_uint_t proc_order = 3;
+    rock_uint_t proc_dims[] = {2, 4, 2};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    assert(mesh != NULL);
+    assert(mesh->np == 16);
+
+    /* Dimension 0 varies fastest. */
+    assert(mesh->rank == mesh->coord[0] +
+            proc_dims[0] * (mesh->coord[1] + proc_dims[1] * mesh->coord[2]));
+
+    for (rock_uint_t i = 0; i < proc_order; i++) {
+        int size;
+        rock_uint_t min, max;
+
+        /* Fibers span the whole dimension. */
+        MPI_Comm_size(mesh->dim_comm[i], &size);
+        assert((rock_uint_t) size == proc_dims[i]);
+        MPI_Allreduce(&mesh->coord[i], &max, 1, ROCK_UINT_MPI, MPI_MAX,
+                mesh->dim_comm[i]);
+        assert(max == proc_dims[i] - 1);
+
+        /* Slices share the coordinate of their dimension. */
+        MPI_Comm_size(mesh->slice_comm[i], &size);
+        assert((rock_uint_t) size == mesh->np / proc_dims[i]);
+        MPI_Allreduce(&mesh->coord[i], &min, 1, ROCK_UINT_MPI, MPI_MIN,
+                mesh->slice_comm[i]);
+        MPI_Allreduce(&mesh->coord[i], &max, 1, ROCK_UINT_MPI, MPI_MAX,
+                mesh->slice_comm[i]);
+        assert(min == mesh->coord[i] && max == mesh->coord[i]);
+    }
+
+    /* The processors of a node share its cores. */
+    int node_size;
+    rock_uint_t node_threads;
+    MPI_Comm_size(mesh->node_comm, &node_size);
+    MPI_Allreduce(&mesh->num_threads, &node_threads, 1, ROCK_UINT_MPI,
+            MPI_SUM, mesh->node_comm);
+
+    long num_cores = sysconf(_SC_NPROCESSORS_ONLN);
+    assert(mesh->node_size == (rock_uint_t) node_size);
+    assert(mesh->node_rank < mesh->node_size);
+    assert(mesh->num_threads >= 1);
+    assert(node_threads <= ((num_cores > node_size) ? num_cores : node_size));
+    for (rock_uint_t i = 1; i < mesh->num_threads; i++) {
+        assert(mesh->cores[i] > mesh->cores[i-1]);
+    }
+    assert(rock_mesh_bind(mesh) == ROCK_OK);
+
+    /* Capping threads by the share is up to the caller. */
+    assert(rock_max_threads == ROCK_USE_DEFAULT);
+    rock_max_threads = mesh->num_threads;
+    assert(rock_thread_count(2 * ROCK_PARALLEL_THRESHOLD) <=
+            (int) mesh->num_threads);
+
+    /* Other meshes leave the setting alone. */
+    rock_mesh_t *other = rock_mesh_init(MPI_COMM_WORLD, proc_order,
+            proc_dims);
+    rock_mesh_free(other);
+    assert(rock_max_threads == (int) mesh->num_threads);
+    rock_max_threads = ROCK_USE_DEFAULT;
+
+    rock_mesh_free(mesh);
+
+    /* Mesh must match the number of processors. */
+    rock_uint_t bad_dims[] = {2, 4, 3};
+    assert(rock_mesh_init(MPI_COMM_WORLD, proc_order, bad_dims) == NULL);
+
+    return ROCK_OK;
+}
+
+/*
+ * Unit test of rock_dist_init().
+ */
+int
+test_dist_init()
+{
+    rock_indx_t *indx = NULL;
+    rock_elem_t *elem = NULL;
+    rock_indx_t *indx_sample = NULL;
+    rock_elem_t *elem_sample = NULL;
+    rock_desc_t *desc = NULL;
+    rock_mpart_t *mpart = NULL;
+
+    rock_uint_t proc_order = 3;
+    rock_uint_t proc_dims[] = {2, 4, 2};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    if (mesh->rank == ROCK_MASTER) {
+        rock_uint_t order = 3;
+        rock_uint_t nnz = 2e5;
+        rock_uint_t dim_size[] = {300, 2, 25000};
+        desc = rock_desc_init(order, dim_size);
+
+        mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+        rock_mpart_desc_based(desc, mpart, 0, NULL);
+
+        elem_sample = rock_elem_init(nnz);
+        indx_sample = rock_indx_init(nnz);
+        rock_elem_sample(desc, elem_sample);
+        rock_indx_sample(desc, indx_sample);
+
+        elem = rock_elem_copy(elem_sample);
+        indx = rock_indx_copy(indx_sample);
+    }
+
+    rock_dist_t *dist = rock_dist_init(indx, elem, mpart, mesh);
+
+    assert(dist->offset[0] == 0);
+
+    if (mesh->rank == ROCK_MASTER) {
+        assert(dist->sum == indx->len);
+
+        /* Every item must be located in the range of its processor. */
+        for (rock_uint_t p = 0; p < mesh->np; p++) {
+            for (rock_uint_t i = dist->offset[p]; i < dist->offset[p+1]; i++) {
+                assert(rock_part_num_from_mpart(mpart, indx, i) == p);
+            }
+        }
+
+        /* Grouping is stable, the first item of the sample leads its group. */
+        rock_uint_t p = rock_part_num_from_mpart(mpart, indx_sample, 0);
+        assert(indx->v[dist->offset[p]] == indx_sample->v[0]);
+        assert(elem->v[dist->offset[p]] == elem_sample->v[0]);
+
+        rock_desc_free(desc);
+        rock_mpart_free(mpart);
+        rock_indx_free(indx);
+        rock_elem_free(elem);
+        rock_indx_free(indx_sample);
+        rock_elem_free(elem_sample);
+    }
+
+    rock_mesh_free(mesh);
+    rock_dist_free(dist);
+
+    return ROCK_OK;
+}
 
 /*
  * Unit test of rock_indx_scatter(), rock_elem_scatter(),
@@ -119,13 +265,816 @@ test_scatter_gather()
     return ROCK_OK;
 }
 
+/*
+ * Unit test of rock_redistribute().
+ */
+int
+test_redistribute()
+{
+    rock_indx_t *indx = NULL;
+    rock_elem_t *elem = NULL;
+    rock_indx_t *indx_sample = NULL;
+    rock_elem_t *elem_sample = NULL;
+    rock_mpart_t *mpart = NULL;
+
+    rock_uint_t proc_order = 3;
+    rock_uint_t proc_dims[] = {2, 4, 2};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    /* Every processor needs the descriptor to redistribute. */
+    rock_uint_t order = 3;
+    rock_uint_t nnz = 2e5;
+    rock_uint_t dim_size[] = {300, 20, 25000};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    if (mesh->rank == ROCK_MASTER) {
+        mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+        rock_uint_t part_dims[] = {1};
+        rock_mpart_desc_based(desc, mpart, 1, part_dims);
+
+        elem_sample = rock_elem_init(nnz);
+        indx_sample = rock_indx_init(nnz);
+        rock_elem_sample(desc, elem_sample);
+        rock_indx_sample(desc, indx_sample);
+
+        elem = rock_elem_copy(elem_sample);
+        indx = rock_indx_copy(indx_sample);
+    }
+
+    rock_dist_t *dist = rock_dist_init(indx, elem, mpart, mesh);
+    rock_indx_scatter(&indx, dist);
+    rock_elem_scatter(&elem, dist);
+
+    /* Switch to a layout with a different dimension priority. */
+    rock_mpart_t *new_mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+    rock_uint_t new_part_dims[] = {2, 0, 1};
+    rock_mpart_desc_based(desc, new_mpart, 3, new_part_dims);
+
+    /* A mismatch at a single processor is rejected everywhere. */
+    rock_uint_t last = mesh->np - 1;
+    if (mesh->rank == last) {
+        dist->count[last]++;
+    }
+    assert(rock_redistribute(&indx, &elem, dist, new_mpart, mesh) == NULL);
+    if (mesh->rank == last) {
+        dist->count[last]--;
+    }
+
+    rock_dist_t *new_dist = rock_redistribute(&indx, &elem, dist,
+            new_mpart, mesh);
+
+    assert(new_dist != NULL);
+    assert(new_dist->sum == nnz);
+    assert(indx->len == new_dist->count[mesh->rank]);
+    for (rock_uint_t i = 0; i < indx->len; i++) {
+        assert(rock_part_num_from_mpart(new_mpart, indx, i) == mesh->rank);
+    }
+
+    /* Nothing may be lost on the way. */
+    rock_indx_gather(&indx, new_dist);
+    rock_elem_gather(&elem, new_dist);
+
+    if (mesh->rank == ROCK_MASTER) {
+        rock_uint_t dims[] = {0, 1, 2};
+        rock_perm_t *perm_sort = rock_perm_init(nnz);
+
+        rock_indx_sort(desc, 3, dims, perm_sort, indx_sample);
+        rock_elem_permute(elem_sample, perm_sort);
+        rock_indx_sort(desc, 3, dims, perm_sort, indx);
+        rock_elem_permute(elem, perm_sort);
+
+        assert(rock_indx_eq(indx, indx_sample));
+        assert(rock_elem_eq(elem, elem_sample));
+
+        rock_perm_free(perm_sort);
+        rock_mpart_free(mpart);
+        rock_indx_free(indx);
+        rock_elem_free(elem);
+        rock_indx_free(indx_sample);
+        rock_elem_free(elem_sample);
+    }
+
+    rock_desc_free(desc);
+    rock_mpart_free(new_mpart);
+    rock_mesh_free(mesh);
+    rock_dist_free(dist);
+    rock_dist_free(new_dist);
+
+    return ROCK_OK;
+}
+
+/*
+ * Unit test of rock_chunk_scatter() and rock_chunk_gather().
+ */
+int
+test_chunk_scatter_gather()
+{
+    rock_indx_t *indx = NULL;
+    rock_elem_t *elem = NULL;
+    rock_indx_t *indx_sample = NULL;
+    rock_elem_t *elem_sample = NULL;
+    rock_mpart_t *mpart = NULL;
+
+    rock_uint_t proc_order = 3;
+    rock_uint_t proc_dims[] = {2, 4, 2};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    rock_uint_t order = 3;
+    rock_uint_t nnz = 2e5;
+    rock_uint_t dim_size[] = {300, 20, 25000};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    if (mesh->rank == ROCK_MASTER) {
+        mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+        rock_mpart_desc_based(desc, mpart, 0, NULL);
+
+        elem_sample = rock_elem_init(nnz);
+        indx_sample = rock_indx_init(nnz);
+        rock_elem_sample(desc, elem_sample);
+        rock_indx_sample(desc, indx_sample);
+
+        elem = rock_elem_copy(elem_sample);
+        indx = rock_indx_copy(indx_sample);
+    }
+
+    rock_dist_t *dist = rock_dist_init(indx, elem, mpart, mesh);
+
+    /* Keep the grouped arrays for comparison. */
+    if (mesh->rank == ROCK_MASTER) {
+        rock_indx_free(indx_sample);
+        rock_elem_free(elem_sample);
+        indx_sample = rock_indx_copy(indx);
+        elem_sample = rock_elem_copy(elem);
+    }
+
+    /* Force several rounds of chunks per processor. */
+    rock_chunk_len = 1000;
+
+    rock_chunk_scatter(&indx, &elem, dist);
+
+    assert(indx->len == dist->count[mesh->rank]);
+    assert(elem->len == dist->count[mesh->rank]);
+
+    rock_chunk_gather(&indx, &elem, dist);
+
+    rock_chunk_len = ROCK_USE_DEFAULT;
+
+    if (mesh->rank == ROCK_MASTER) {
+        /* Chunks keep their order, no sorting needed. */
+        assert(rock_indx_eq(indx, indx_sample));
+        assert(rock_elem_eq(elem, elem_sample));
+
+        rock_mpart_free(mpart);
+        rock_indx_free(indx);
+        rock_elem_free(elem);
+        rock_indx_free(indx_sample);
+        rock_elem_free(elem_sample);
+    } else {
+        assert(indx == NULL);
+        assert(elem == NULL);
+    }
+
+    rock_desc_free(desc);
+    rock_mesh_free(mesh);
+    rock_dist_free(dist);
+
+    return ROCK_OK;
+}
+
+/*
+ * Unit test of rock_tensor_scatter() and rock_tensor_gather().
+ */
+int
+test_tensor_scatter_gather()
+{
+    rock_tensor_t *tensor = NULL;
+    rock_indx_t *indx_sample = NULL;
+    rock_elem_t *elem_sample = NULL;
+    rock_mpart_t *mpart = NULL;
+
+    rock_uint_t proc_order = 3;
+    rock_uint_t proc_dims[] = {2, 4, 2};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    rock_uint_t order = 3;
+    rock_uint_t nnz = 2e5;
+    rock_uint_t dim_size[] = {300, 20, 25000};
+
+    if (mesh->rank == ROCK_MASTER) {
+        tensor = rock_tensor_init(order, dim_size, nnz);
+        rock_tensor_sample(tensor);
+
+        mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+        rock_mpart_desc_based(tensor->desc, mpart, 0, NULL);
+    }
+
+    rock_dist_t *dist = rock_dist_init(tensor ? tensor->indx : NULL,
+            tensor ? tensor->elem : NULL, mpart, mesh);
+
+    if (mesh->rank == ROCK_MASTER) {
+        indx_sample = rock_indx_copy(tensor->indx);
+        elem_sample = rock_elem_copy(tensor->elem);
+    }
+
+    rock_tensor_scatter(&tensor, dist);
+
+    assert(tensor != NULL);
+    assert(tensor->desc->order == order);
+    assert(tensor->desc->dim_size[2] == dim_size[2]);
+    assert(tensor->indx->len == dist->count[mesh->rank]);
+    assert(tensor->elem->len == dist->count[mesh->rank]);
+
+    rock_tensor_gather(&tensor, dist);
+
+    if (mesh->rank == ROCK_MASTER) {
+        assert(rock_indx_eq(tensor->indx, indx_sample));
+        assert(rock_elem_eq(tensor->elem, elem_sample));
+
+        rock_tensor_free(tensor);
+        rock_mpart_free(mpart);
+        rock_indx_free(indx_sample);
+        rock_elem_free(elem_sample);
+    } else {
+        assert(tensor == NULL);
+    }
+
+    rock_mesh_free(mesh);
+    rock_dist_free(dist);
+
+    return ROCK_OK;
+}
+
+/*
+ * Unit test of rock_mpart_indx_based() and rock_mpart_imbalance().
+ */
+int
+test_mpart_indx_based()
+{
+    rock_uint_t proc_order = 3;
+    rock_uint_t proc_dims[] = {2, 4, 2};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    if (mesh->rank == ROCK_MASTER) {
+        rock_uint_t order = 3;
+        rock_uint_t nnz = 1e5;
+        rock_uint_t dim_size[] = {300, 20, 25000};
+        rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+        /* Skew the tensor towards low indices in every dimension. */
+        rock_indx_t *indx = rock_indx_init(nnz);
+        for (rock_uint_t i = 0; i < nnz; i++) {
+            for (rock_uint_t k = 0; k < order; k++) {
+                double x = rock_double_random();
+                rock_uint_t val = x * x * x * (dim_size[k] - 1);
+                rock_indx_insert(desc, indx, i, k, val);
+            }
+        }
+
+        rock_freq_t *freq = rock_freq_init(desc, indx);
+
+        rock_mpart_t *mpart_desc = rock_mpart_init(mesh->order, mesh->dim_size);
+        rock_mpart_desc_based(desc, mpart_desc, 0, NULL);
+        double imbalance_desc = rock_mpart_imbalance(mpart_desc, indx);
+
+        rock_mpart_t *mpart_indx = rock_mpart_init(mesh->order, mesh->dim_size);
+        double imbalance_indx = 0;
+        assert(rock_mpart_indx_based(freq, mpart_indx, 0, NULL,
+                &imbalance_indx) == ROCK_OK);
+
+        assert(imbalance_indx >= 1.0);
+        assert(imbalance_indx < imbalance_desc);
+        assert(imbalance_indx == rock_mpart_imbalance(mpart_indx, indx));
+
+        rock_mpart_free(mpart_desc);
+        rock_mpart_free(mpart_indx);
+        rock_freq_free(freq);
+        rock_indx_free(indx);
+        rock_desc_free(desc);
+    }
+
+    rock_mesh_free(mesh);
+
+    return ROCK_OK;
+}
+
+/*
+ * Unit test of rock_freq_dist_init() and rock_mpart_imbalance_dist().
+ */
+int
+test_freq_dist()
+{
+    rock_indx_t *indx = NULL;
+    rock_elem_t *elem = NULL;
+    rock_freq_t *freq_sample = NULL;
+    rock_mpart_t *mpart = NULL;
+    double imbalance_sample = 0;
+
+    rock_uint_t proc_order = 3;
+    rock_uint_t proc_dims[] = {2, 4, 2};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    rock_uint_t order = 3;
+    rock_uint_t nnz = 1e5;
+    rock_uint_t dim_size[] = {300, 20, 25000};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    if (mesh->rank == ROCK_MASTER) {
+        /* Leave the ends of every dimension unused. */
+        indx = rock_indx_init(nnz);
+        for (rock_uint_t i = 0; i < nnz; i++) {
+            for (rock_uint_t k = 0; k < order; k++) {
+                double x = rock_double_random();
+                rock_uint_t val = 1 + x * x * (dim_size[k] - 3);
+                rock_indx_insert(desc, indx, i, k, val);
+            }
+        }
+
+        elem = rock_elem_init(nnz);
+        rock_elem_sample(desc, elem);
+
+        freq_sample = rock_freq_init(desc, indx);
+
+        mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+        rock_mpart_desc_based(desc, mpart, 0, NULL);
+
+        rock_mpart_t *mpart_sample =
+                rock_mpart_init(mesh->order, mesh->dim_size);
+        rock_mpart_indx_based(freq_sample, mpart_sample, 0, NULL,
+                &imbalance_sample);
+        rock_mpart_free(mpart_sample);
+    }
+
+    rock_dist_t *dist = rock_dist_init(indx, elem, mpart, mesh);
+    rock_indx_scatter(&indx, dist);
+    rock_elem_scatter(&elem, dist);
+
+    /* Reduce in several segments. */
+    rock_chunk_len = 1000;
+
+    rock_stat_t stat;
+    rock_freq_t *freq = rock_freq_dist_init(desc, indx, mesh, &stat);
+
+    rock_chunk_len = ROCK_USE_DEFAULT;
+
+    assert(stat.nnz == nnz);
+    for (rock_uint_t k = 0; k < order; k++) {
+        assert(stat.dim_min[k] >= 1);
+        assert(stat.dim_max[k] <= dim_size[k] - 2);
+        assert(freq->dim_freq[k][stat.dim_min[k]] > 0);
+        assert(freq->dim_freq[k][stat.dim_max[k]] > 0);
+    }
+
+    if (mesh->rank == ROCK_MASTER) {
+        for (rock_uint_t k = 0; k < order; k++) {
+            assert(memcmp(freq->dim_freq[k], freq_sample->dim_freq[k],
+                    dim_size[k] * sizeof(rock_uint_t)) == 0);
+        }
+    }
+
+    /* Every processor arrives at the same partitioning as the master. */
+    rock_mpart_t *mpart_indx = rock_mpart_init(mesh->order, mesh->dim_size);
+    assert(rock_mpart_indx_based(freq, mpart_indx, 0, NULL, NULL)
+            == ROCK_OK);
+
+    double imbalance = rock_mpart_imbalance_dist(mpart_indx, indx, mesh);
+    double imbalance_max;
+    MPI_Allreduce(&imbalance, &imbalance_max, 1, MPI_DOUBLE, MPI_MAX,
+            mesh->comm);
+
+    assert(imbalance == imbalance_max);
+    if (mesh->rank == ROCK_MASTER) {
+        assert(imbalance == imbalance_sample);
+        rock_freq_free(freq_sample);
+        rock_mpart_free(mpart);
+    }
+
+    rock_mpart_free(mpart_indx);
+    rock_freq_free(freq);
+    rock_dist_free(dist);
+    rock_indx_free(indx);
+    rock_elem_free(elem);
+    rock_desc_free(desc);
+    rock_mesh_free(mesh);
+
+    return ROCK_OK;
+}
+
+/*
+ * Unit test of rock_dist_sample().
+ */
+int
+test_dist_sample()
+{
+    rock_uint_t proc_order = 3;
+    rock_uint_t proc_dims[] = {2, 4, 2};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    rock_uint_t order = 3;
+    rock_uint_t nnz = 2e5;
+    rock_uint_t dim_size[] = {300, 20, 25000};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    rock_indx_t *indx = NULL;
+    rock_elem_t *elem = NULL;
+
+    rock_uint_t small_dims[] = {3, 3, 3};
+    rock_desc_t *small = rock_desc_init(order, small_dims);
+    assert(rock_dist_sample(&indx, &elem, small, 28, 1, mesh) == NULL);
+    rock_desc_free(small);
+
+    rock_dist_t *dist = rock_dist_sample(&indx, &elem, desc, nnz, 42, mesh);
+
+    assert(dist != NULL);
+    assert(dist->sum == nnz);
+    assert(indx->len == dist->count[mesh->rank]);
+    assert(elem->len == dist->count[mesh->rank]);
+
+    /* Lay the tensor out by a multi-partition. */
+    rock_mpart_t *mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+    rock_mpart_desc_based(desc, mpart, 0, NULL);
+
+    rock_dist_t *new_dist = rock_redistribute(&indx, &elem, dist, mpart,
+            mesh);
+
+    /* Indices are distinct over all processors. */
+    rock_indx_gather(&indx, new_dist);
+    rock_elem_gather(&elem, new_dist);
+
+    if (mesh->rank == ROCK_MASTER) {
+        rock_uint_t dims[] = {0, 1, 2};
+        rock_indx_sort(desc, 3, dims, NULL, indx);
+
+        assert(indx->len == nnz);
+        for (rock_uint_t i = 1; i < indx->len; i++) {
+            assert(indx->v[i-1] != indx->v[i]);
+        }
+
+        rock_indx_free(indx);
+        rock_elem_free(elem);
+    }
+
+    rock_dist_free(new_dist);
+    rock_dist_free(dist);
+    rock_mpart_free(mpart);
+    rock_desc_free(desc);
+    rock_mesh_free(mesh);
+
+    return ROCK_OK;
+}
+
+/*
+ * Unit test of rock_indx_scatter_compressed() and
+ * rock_indx_gather_compressed().
+ */
+int
+test_scatter_gather_compressed()
+{
+    rock_indx_t *indx = NULL;
+    rock_indx_t *indx_sample = NULL;
+    rock_indx_t *indx_plain = NULL;
+    rock_elem_t *elem = NULL;
+    rock_desc_t *desc = NULL;
+    rock_mpart_t *mpart = NULL;
+
+    rock_uint_t proc_order = 3;
+    rock_uint_t proc_dims[] = {2, 4, 2};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    if (mesh->rank == ROCK_MASTER) {
+        rock_uint_t order = 3;
+        rock_uint_t nnz = 2e5;
+        rock_uint_t dim_size[] = {300, 20, 25000};
+        rock_uint_t dims[] = {2, 1, 0};
+        desc = rock_desc_init(order, dim_size);
+
+        mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+        rock_mpart_desc_based(desc, mpart, 0, NULL);
+
+        indx = rock_indx_init(nnz);
+        elem = rock_elem_init(nnz);
+        rock_indx_sample(desc, indx);
+        rock_indx_sort(desc, order, dims, NULL, indx);
+    }
+
+    rock_dist_t *dist = rock_dist_init(indx, elem, mpart, mesh);
+
+    if (mesh->rank == ROCK_MASTER) {
+        indx_sample = rock_indx_copy(indx);
+        indx_plain = rock_indx_copy(indx);
+    }
+
+    rock_indx_scatter_compressed(&indx, dist);
+    rock_indx_scatter(&indx_plain, dist);
+
+    assert(rock_indx_eq(indx, indx_plain));
+
+    rock_indx_gather_compressed(&indx, dist);
+
+    if (mesh->rank == ROCK_MASTER) {
+        assert(rock_indx_eq(indx, indx_sample));
+
+        rock_indx_free(indx);
+        rock_indx_free(indx_sample);
+        rock_elem_free(elem);
+        rock_mpart_free(mpart);
+        rock_desc_free(desc);
+    } else {
+        assert(indx == NULL);
+    }
+
+    rock_indx_free(indx_plain);
+    rock_dist_free(dist);
+    rock_mesh_free(mesh);
+
+    return ROCK_OK;
+}
+
+/*
+ * Unit test of rock_dist_append().
+ */
+int
+test_dist_append()
+{
+    rock_indx_t *indx = NULL;
+    rock_elem_t *elem = NULL;
+    rock_indx_t *indx_sample = NULL;
+
+    rock_uint_t proc_order = 3;
+    rock_uint_t proc_dims[] = {2, 4, 2};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    rock_uint_t order = 3;
+    rock_uint_t nnz = 1e5;
+    rock_uint_t batch_len = 2e4;
+    rock_uint_t dim_size[] = {300, 20, 25000};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    rock_mpart_t *mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+    rock_mpart_desc_based(desc, mpart, 0, NULL);
+
+    /* The initial tensor and the batches, all distinct. */
+    if (mesh->rank == ROCK_MASTER) {
+        indx_sample = rock_indx_init(nnz + mesh->np * batch_len);
+        rock_indx_sample(desc, indx_sample);
+
+        indx = rock_indx_init(nnz);
+        elem = rock_elem_init(nnz);
+        memcpy(indx->v, indx_sample->v, nnz * sizeof(rock_uint_t));
+    }
+
+    rock_dist_t *dist = rock_dist_init(indx, elem, mpart, mesh);
+    rock_indx_scatter(&indx, dist);
+    rock_elem_scatter(&elem, dist);
+
+    /* Every processor but the last contributes a batch. */
+    rock_indx_t *new_indx = NULL;
+    rock_elem_t *new_elem = NULL;
+
+    rock_uint_t *batch = malloc(mesh->np * batch_len * sizeof(rock_uint_t));
+    if (mesh->rank == ROCK_MASTER) {
+        memcpy(batch, &indx_sample->v[nnz],
+                mesh->np * batch_len * sizeof(rock_uint_t));
+    }
+    MPI_Bcast(batch, mesh->np * batch_len, ROCK_UINT_MPI, ROCK_MASTER,
+            mesh->comm);
+
+    if (mesh->rank != mesh->np - 1) {
+        new_indx = rock_indx_init(batch_len);
+        new_elem = rock_elem_init(batch_len);
+        memcpy(new_indx->v, &batch[mesh->rank * batch_len],
+                batch_len * sizeof(rock_uint_t));
+    }
+    free(batch);
+
+    /* Mismatching batches are rejected everywhere. */
+    rock_indx_t *no_indx = NULL;
+    rock_elem_t *bad_elem = (mesh->rank == ROCK_MASTER) ?
+            rock_elem_init(1) : NULL;
+    assert(rock_dist_append(&indx, &elem, &no_indx, &bad_elem, mpart, dist)
+            == ROCK_BAD_INPUT);
+    if (bad_elem) {
+        rock_elem_free(bad_elem);
+    }
+
+    /* The batches are taken over. */
+    assert(rock_dist_append(&indx, &elem, &new_indx, &new_elem, mpart, dist)
+            == ROCK_OK);
+    assert(new_indx == NULL && new_elem == NULL);
+
+    rock_uint_t total = nnz + (mesh->np - 1) * batch_len;
+    assert(dist->sum == total);
+    assert(indx->len == dist->count[mesh->rank]);
+    assert(elem->len == dist->count[mesh->rank]);
+    for (rock_uint_t i = 0; i < indx->len; i++) {
+        assert(rock_part_num_from_mpart(mpart, indx, i) == mesh->rank);
+    }
+
+    /* Nothing is lost or duplicated on the way. */
+    rock_indx_gather(&indx, dist);
+    rock_elem_gather(&elem, dist);
+
+    if (mesh->rank == ROCK_MASTER) {
+        rock_uint_t dims[] = {0, 1, 2};
+
+        indx_sample->len = total;
+        rock_indx_sort(desc, 3, dims, NULL, indx_sample);
+        rock_indx_sort(desc, 3, dims, NULL, indx);
+        assert(rock_indx_eq(indx, indx_sample));
+
+        rock_indx_free(indx);
+        rock_elem_free(elem);
+        rock_indx_free(indx_sample);
+    }
+
+    rock_dist_free(dist);
+    rock_mpart_free(mpart);
+    rock_desc_free(desc);
+    rock_mesh_free(mesh);
+
+    return ROCK_OK;
+}
+
+/*
+ * Simulated time spent on the local items, items with low indices in
+ * dimension 0 are four times as expensive.
+ */
+static double
+rebalance_time(rock_desc_t *desc, rock_indx_t *indx)
+{
+    double time = 0;
+
+    for (rock_uint_t i = 0; i < indx->len; i++) {
+        time += (rock_indx_extract(desc, indx, i, 0) < 50) ? 4e-6 : 1e-6;
+    }
+
+    return time;
+}
+
+static double
+rebalance_imbalance(double time, rock_mesh_t *mesh)
+{
+    double max, sum;
+    MPI_Allreduce(&time, &max, 1, MPI_DOUBLE, MPI_MAX, mesh->comm);
+    MPI_Allreduce(&time, &sum, 1, MPI_DOUBLE, MPI_SUM, mesh->comm);
+
+    return max * mesh->np / sum;
+}
+
+/*
+ * Unit test of rock_mpart_rebalance().
+ */
+int
+test_mpart_rebalance()
+{
+    rock_indx_t *indx = NULL;
+    rock_elem_t *elem = NULL;
+
+    rock_uint_t proc_order = 2;
+    rock_uint_t proc_dims[] = {4, 4};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    rock_uint_t order = 3;
+    rock_uint_t nnz = 2e5;
+    rock_uint_t dim_size[] = {300, 20, 2500};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    rock_mpart_t *mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+    rock_uint_t part_dims[] = {0, 2};
+    rock_mpart_desc_based(desc, mpart, 2, part_dims);
+
+    rock_dist_t *dist = rock_dist_sample(&indx, &elem, desc, nnz, 3, mesh);
+    rock_dist_t *old = dist;
+    dist = rock_redistribute(&indx, &elem, old, mpart, mesh);
+    rock_dist_free(old);
+
+    assert(rock_mpart_rebalance(&indx, &elem, 1.0, 0, mpart, dist)
+            == ROCK_BAD_INPUT);
+    assert(rock_mpart_rebalance(&indx, &elem, -1.0, 1, mpart, dist)
+            == ROCK_BAD_INPUT);
+
+    double time = rebalance_time(desc, indx);
+    double imbalance_before = rebalance_imbalance(time, mesh);
+
+    for (int iter = 0; iter < 3; iter++) {
+        assert(rock_mpart_rebalance(&indx, &elem, time, 0.8, mpart, dist)
+                == ROCK_OK);
+        time = rebalance_time(desc, indx);
+    }
+
+    double imbalance_after = rebalance_imbalance(time, mesh);
+    assert(imbalance_after < imbalance_before);
+    assert(imbalance_after < 1.2);
+
+    /* Every item sits at its new owner, none are lost. */
+    assert(dist->sum == nnz);
+    assert(indx->len == dist->count[mesh->rank]);
+    for (rock_uint_t i = 0; i < indx->len; i++) {
+        assert(rock_part_num_from_mpart(mpart, indx, i) == mesh->rank);
+    }
+
+    rock_indx_free(indx);
+    rock_elem_free(elem);
+    rock_dist_free(dist);
+    rock_mpart_free(mpart);
+    rock_desc_free(desc);
+    rock_mesh_free(mesh);
+
+    return ROCK_OK;
+}
+
+/*
+ * Unit test of rock_mesh_shape() and meshes of higher order.
+ */
+int
+test_mesh_shape()
+{
+    int np;
+    MPI_Comm_size(MPI_COMM_WORLD, &np);
+
+    rock_uint_t shape[ROCK_MAX_ORDER];
+
+    rock_uint_t dim_size_1[] = {1000, 1000, 10};
+    rock_desc_t *desc_1 = rock_desc_init(3, dim_size_1);
+    assert(rock_mesh_shape(desc_1, 12, shape) == ROCK_OK);
+    assert(shape[0] == 3 && shape[1] == 4 && shape[2] == 1);
+
+    /* Too small a tensor for that many processors. */
+    assert(rock_mesh_shape(desc_1, 1009, shape) == ROCK_BAD_INPUT);
+    rock_desc_free(desc_1);
+
+    /* One mesh dimension per tensor dimension. */
+    rock_uint_t order = 4;
+    rock_uint_t nnz = 1e5;
+    rock_uint_t dim_size[] = {40, 50, 30, 60};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    assert(rock_mesh_shape(desc, np, shape) == ROCK_OK);
+    rock_uint_t total = 1;
+    for (rock_uint_t i = 0; i < order; i++) {
+        assert(shape[i] <= dim_size[i]);
+        total *= shape[i];
+    }
+    assert(total == (rock_uint_t) np);
+
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, order, shape);
+    assert(mesh != NULL);
+
+    rock_mpart_t *mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+    rock_uint_t part_dims[] = {0, 1, 2, 3};
+    rock_mpart_desc_based(desc, mpart, order, part_dims);
+
+    rock_indx_t *indx = NULL;
+    rock_elem_t *elem = NULL;
+    if (mesh->rank == ROCK_MASTER) {
+        indx = rock_indx_init(nnz);
+        elem = rock_elem_init(nnz);
+        rock_indx_sample(desc, indx);
+        rock_elem_sample(desc, elem);
+    }
+
+    rock_dist_t *dist = rock_dist_init(indx, elem, mpart, mesh);
+
+    rock_chunk_scatter(&indx, &elem, dist);
+
+    for (rock_uint_t i = 0; i < indx->len; i++) {
+        assert(rock_part_num_from_mpart(mpart, indx, i) == mesh->rank);
+        for (rock_uint_t k = 0; k < order; k++) {
+            rock_uint_t val = rock_indx_extract(desc, indx, i, k);
+            rock_part_t *part = mpart->dim_part[k];
+            assert(val >= part->offset[mesh->coord[k]]);
+            assert(val < part->offset[mesh->coord[k] + 1]);
+        }
+    }
+
+    rock_indx_free(indx);
+    rock_elem_free(elem);
+    rock_mpart_free(mpart);
+    rock_desc_free(desc);
+    rock_mesh_free(mesh);
+    rock_dist_free(dist);
+
+    return ROCK_OK;
+}
+
 int
 main(int argc, char **argv)
 {
     srand(time(NULL));
 
     MPI_Init(&argc, &argv);
+    assert(test_mesh() == ROCK_OK);
+    assert(test_dist_init() == ROCK_OK);
     assert(test_scatter_gather() == ROCK_OK);
+    assert(test_redistribute() == ROCK_OK);
+    assert(test_chunk_scatter_gather() == ROCK_OK);
+    assert(test_tensor_scatter_gather() == ROCK_OK);
+    assert(test_mpart_indx_based() == ROCK_OK);
+    assert(test_mesh_shape() == ROCK_OK);
+    assert(test_freq_dist() == ROCK_OK);
+    assert(test_dist_sample() == ROCK_OK);
+    assert(test_scatter_gather_compressed() == ROCK_OK);
+    assert(test_dist_append() == ROCK_OK);
+    assert(test_mpart_rebalance() == ROCK_OK);
     MPI_Finalize();
 
     return ROCK_OK;
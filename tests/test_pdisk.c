@@ -0,0 +1,483 @@
+/**
+ * @file test_pdisk.c
+ * @author timoteus <mail@timoteus.se>
+ */
+
+#include "core.h"
+#include "distribute.h"
+#include "pdisk.h"
+#include "disk.h"
+#include "sort.h"
+#include "random.h"
+#include "hdf5_hl.h"
+
+/*
+ * Gather a distributed tensor and compare it with a sample at the
+ * master (sorting both).
+ */
+static void
+check_gathered(rock_desc_t *desc,
+               rock_indx_t *indx,
+               rock_elem_t *elem,
+               rock_dist_t *dist,
+               rock_indx_t *indx_sample,
+               rock_elem_t *elem_sample)
+{
+    rock_indx_t *indx_copy = rock_indx_copy(indx);
+    rock_elem_t *elem_copy = rock_elem_copy(elem);
+
+    rock_indx_gather(&indx_copy, dist);
+    rock_elem_gather(&elem_copy, dist);
+
+    if (dist->mesh->rank == ROCK_MASTER) {
+        rock_uint_t dims[] = {0, 1, 2};
+        rock_perm_t *perm_sort = rock_perm_init(indx_sample->len);
+
+        rock_indx_sort(desc, 3, dims, perm_sort, indx_sample);
+        rock_elem_permute(elem_sample, perm_sort);
+        rock_indx_sort(desc, 3, dims, perm_sort, indx_copy);
+        rock_elem_permute(elem_copy, perm_sort);
+
+        assert(rock_indx_eq(indx_copy, indx_sample));
+        assert(rock_elem_eq(elem_copy, elem_sample));
+
+        rock_perm_free(perm_sort);
+        rock_indx_free(indx_copy);
+        rock_elem_free(elem_copy);
+    }
+}
+
+/*
+ * Remove the files of a checkpoint.
+ */
+static void
+remove_files(char *prefix, int np, MPI_Comm comm)
+{
+    int rank;
+    char fname[256];
+
+    MPI_Barrier(comm);
+    MPI_Comm_rank(comm, &rank);
+    if (rank == ROCK_MASTER) {
+        for (int i = 0; i < np; i++) {
+            snprintf(fname, sizeof(fname), "%s.%d.h5", prefix, i);
+            remove(fname);
+        }
+    }
+    MPI_Barrier(comm);
+}
+
+/*
+ * Unit test of rock_dist_save() and rock_dist_load() using the same
+ * number of processors.
+ */
+int
+test_dist_save_load()
+{
+    char *prefix = "test_dist_save_load";
+    rock_indx_t *indx = NULL;
+    rock_elem_t *elem = NULL;
+    rock_indx_t *indx_sample = NULL;
+    rock_elem_t *elem_sample = NULL;
+    rock_mpart_t *mpart = NULL;
+
+    rock_uint_t proc_order = 3;
+    rock_uint_t proc_dims[] = {2, 4, 2};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    rock_uint_t order = 3;
+    rock_uint_t nnz = 1e5;
+    rock_uint_t dim_size[] = {300, 20, 25000};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+    rock_uint_t part_dims[] = {2, 0, 1};
+    rock_mpart_desc_based(desc, mpart, 3, part_dims);
+
+    if (mesh->rank == ROCK_MASTER) {
+        elem_sample = rock_elem_init(nnz);
+        indx_sample = rock_indx_init(nnz);
+        rock_elem_sample(desc, elem_sample);
+        rock_indx_sample(desc, indx_sample);
+
+        elem = rock_elem_copy(elem_sample);
+        indx = rock_indx_copy(indx_sample);
+    }
+
+    rock_dist_t *dist = rock_dist_init(indx, elem, mpart, mesh);
+    rock_indx_scatter(&indx, dist);
+    rock_elem_scatter(&elem, dist);
+
+    /* Local arrays must follow the distribution. */
+    rock_indx_t *indx_short = rock_indx_init(0);
+    assert(rock_dist_save(indx_short, elem, mpart, dist, prefix) ==
+            ROCK_BAD_INPUT);
+    rock_indx_free(indx_short);
+
+    assert(rock_dist_save(indx, elem, mpart, dist, prefix) == ROCK_OK);
+
+    /* Restart restores the local arrays and the layout as they were. */
+    rock_indx_t *indx_load = NULL;
+    rock_elem_t *elem_load = NULL;
+    rock_desc_t *desc_load = NULL;
+    rock_mpart_t *mpart_load = NULL;
+
+    rock_dist_t *dist_load = rock_dist_load(&indx_load, &elem_load,
+            &desc_load, &mpart_load, mesh, prefix);
+
+    assert(dist_load != NULL);
+    assert(rock_indx_eq(indx_load, indx));
+    assert(rock_elem_eq(elem_load, elem));
+    assert(desc_load->order == desc->order);
+    assert(mpart_load->desc == desc_load);
+
+    for (rock_uint_t i = 0; i < order; i++) {
+        assert(desc_load->dim_size[i] == desc->dim_size[i]);
+    }
+
+    for (rock_uint_t m = 0; m < mesh->order; m++) {
+        rock_part_t *part = mpart->dim_part[m];
+        assert(mpart_load->dim_num[m] == mpart->dim_num[m]);
+        for (rock_uint_t j = 0; j <= part->num_parts; j++) {
+            assert(mpart_load->dim_part[m]->offset[j] == part->offset[j]);
+        }
+    }
+
+    for (rock_uint_t p = 0; p < mesh->np; p++) {
+        assert(dist_load->count[p] == dist->count[p]);
+    }
+
+    /* Missing files fail everywhere. */
+    rock_indx_t *indx_none = NULL;
+    rock_elem_t *elem_none = NULL;
+    rock_desc_t *desc_none = NULL;
+    rock_mpart_t *mpart_none = NULL;
+    assert(rock_dist_load(&indx_none, &elem_none, &desc_none, &mpart_none,
+                mesh, "test_dist_save_load_missing") == NULL);
+
+    /* A partitioned dimension outside the tensor fails everywhere. */
+    MPI_Barrier(mesh->comm);
+    if (mesh->rank == ROCK_MASTER) {
+        rock_uint_t bad_dim_num[] = {order, order, order};
+        hid_t file_id = H5Fopen("test_dist_save_load.0.h5", H5F_ACC_RDWR,
+                H5P_DEFAULT);
+        hid_t dset_id = H5Dopen(file_id, "/dim_num", H5P_DEFAULT);
+        H5Dwrite(dset_id, ROCK_UINT_H5T, H5S_ALL, H5S_ALL, H5P_DEFAULT,
+                bad_dim_num);
+        H5Dclose(dset_id);
+        H5Fclose(file_id);
+    }
+    MPI_Barrier(mesh->comm);
+    assert(rock_dist_load(&indx_none, &elem_none, &desc_none, &mpart_none,
+                mesh, prefix) == NULL);
+
+    check_gathered(desc, indx_load, elem_load, dist_load,
+            indx_sample, elem_sample);
+
+    remove_files(prefix, mesh->np, mesh->comm);
+
+    if (mesh->rank == ROCK_MASTER) {
+        rock_indx_free(indx_sample);
+        rock_elem_free(elem_sample);
+    }
+
+    rock_indx_free(indx);
+    rock_elem_free(elem);
+    rock_indx_free(indx_load);
+    rock_elem_free(elem_load);
+    rock_mpart_free(mpart);
+    rock_mpart_free(mpart_load);
+    rock_desc_free(desc);
+    rock_desc_free(desc_load);
+    rock_dist_free(dist);
+    rock_dist_free(dist_load);
+    rock_mesh_free(mesh);
+
+    return ROCK_OK;
+}
+
+/*
+ * Unit test of rock_dist_load() restarting on more processors.
+ */
+int
+test_dist_load_other_np()
+{
+    char *prefix = "test_dist_load_other_np";
+    rock_indx_t *indx = NULL;
+    rock_elem_t *elem = NULL;
+    rock_indx_t *indx_sample = NULL;
+    rock_elem_t *elem_sample = NULL;
+
+    rock_uint_t order = 3;
+    rock_uint_t nnz = 1e5;
+    rock_uint_t dim_size[] = {300, 20, 25000};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    int world_rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &world_rank);
+
+    if (world_rank == ROCK_MASTER) {
+        elem_sample = rock_elem_init(nnz);
+        indx_sample = rock_indx_init(nnz);
+        rock_elem_sample(desc, elem_sample);
+        rock_indx_sample(desc, indx_sample);
+    }
+
+    /* Checkpoint on half of the processors. */
+    MPI_Comm half_comm;
+    MPI_Comm_split(MPI_COMM_WORLD, world_rank < 8, world_rank, &half_comm);
+
+    if (world_rank < 8) {
+        rock_uint_t half_dims[] = {2, 4};
+        rock_mesh_t *half_mesh = rock_mesh_init(half_comm, 2, half_dims);
+        rock_mpart_t *mpart = rock_mpart_init(half_mesh->order,
+                half_mesh->dim_size);
+        rock_uint_t part_dims[] = {0, 2};
+        rock_mpart_desc_based(desc, mpart, 2, part_dims);
+
+        if (half_mesh->rank == ROCK_MASTER) {
+            elem = rock_elem_copy(elem_sample);
+            indx = rock_indx_copy(indx_sample);
+        }
+
+        rock_dist_t *dist = rock_dist_init(indx, elem, mpart, half_mesh);
+        rock_indx_scatter(&indx, dist);
+        rock_elem_scatter(&elem, dist);
+
+        assert(rock_dist_save(indx, elem, mpart, dist, prefix) == ROCK_OK);
+
+        rock_indx_free(indx);
+        rock_elem_free(elem);
+        rock_mpart_free(mpart);
+        rock_dist_free(dist);
+        rock_mesh_free(half_mesh);
+    }
+
+    MPI_Comm_free(&half_comm);
+
+    /* Restart on all of them, using a different mesh. */
+    rock_uint_t proc_dims[] = {2, 4, 2};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, 3, proc_dims);
+
+    rock_desc_t *desc_load = NULL;
+    rock_mpart_t *mpart_load = NULL;
+    rock_dist_t *dist = rock_dist_load(&indx, &elem, &desc_load,
+            &mpart_load, mesh, prefix);
+
+    assert(dist != NULL);
+    assert(dist->sum == nnz);
+    assert(indx->len == dist->count[mesh->rank]);
+    assert(elem->len == indx->len);
+
+    /* The saved dimensions are partitioned first. */
+    assert(mpart_load->order == mesh->order);
+    assert(mpart_load->dim_num[0] == 0);
+    assert(mpart_load->dim_num[1] == 2);
+
+    for (rock_uint_t i = 0; i < indx->len; i++) {
+        assert(rock_part_num_from_mpart(mpart_load, indx, i) == mesh->rank);
+    }
+
+    check_gathered(desc, indx, elem, dist, indx_sample, elem_sample);
+
+    remove_files(prefix, 8, mesh->comm);
+
+    if (mesh->rank == ROCK_MASTER) {
+        rock_indx_free(indx_sample);
+        rock_elem_free(elem_sample);
+    }
+
+    rock_indx_free(indx);
+    rock_elem_free(elem);
+    rock_mpart_free(mpart_load);
+    rock_desc_free(desc);
+    rock_desc_free(desc_load);
+    rock_dist_free(dist);
+    rock_mesh_free(mesh);
+
+    return ROCK_OK;
+}
+
+/*
+ * Unit test of rock_dist_load_shared().
+ */
+int
+test_dist_load_shared()
+{
+    char *indx_fname = "test_dist_load_shared_indx.h5";
+    char *elem_fname = "test_dist_load_shared_elem.h5";
+    rock_indx_t *indx = NULL;
+    rock_elem_t *elem = NULL;
+    rock_indx_t *indx_sample = NULL;
+    rock_elem_t *elem_sample = NULL;
+
+    rock_uint_t proc_order = 3;
+    rock_uint_t proc_dims[] = {2, 4, 2};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    rock_uint_t order = 3;
+    rock_uint_t nnz = 1e5 + 7;
+    rock_uint_t dim_size[] = {300, 20, 25000};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    if (mesh->rank == ROCK_MASTER) {
+        elem_sample = rock_elem_init(nnz);
+        indx_sample = rock_indx_init(nnz);
+        rock_elem_sample(desc, elem_sample);
+        rock_indx_sample(desc, indx_sample);
+
+        assert(rock_indx_save(indx_sample, indx_fname) == ROCK_OK);
+        assert(rock_elem_save(elem_sample, elem_fname) == ROCK_OK);
+    }
+    MPI_Barrier(mesh->comm);
+
+    /* Given multi-partition. */
+    rock_mpart_t *mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+    rock_uint_t part_dims[] = {2, 0, 1};
+    rock_mpart_desc_based(desc, mpart, 3, part_dims);
+
+    rock_dist_t *dist = rock_dist_load_shared(&indx, &elem, desc, mpart,
+            mesh, indx_fname, elem_fname);
+
+    assert(dist != NULL);
+    assert(dist->sum == nnz);
+    assert(indx->len == dist->count[mesh->rank]);
+    for (rock_uint_t i = 0; i < indx->len; i++) {
+        assert(rock_part_num_from_mpart(mpart, indx, i) == mesh->rank);
+    }
+
+    check_gathered(desc, indx, elem, dist, indx_sample, elem_sample);
+
+    rock_indx_free(indx);
+    rock_elem_free(elem);
+    rock_dist_free(dist);
+    rock_mpart_free(mpart);
+
+    /* Multi-partition populated from the loaded indices. */
+    mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+    dist = rock_dist_load_shared(&indx, &elem, desc, mpart, mesh,
+            indx_fname, elem_fname);
+
+    assert(dist != NULL);
+    assert(mpart->desc == desc);
+    assert(dist->sum == nnz);
+    for (rock_uint_t i = 0; i < indx->len; i++) {
+        assert(rock_part_num_from_mpart(mpart, indx, i) == mesh->rank);
+    }
+
+    check_gathered(desc, indx, elem, dist, indx_sample, elem_sample);
+
+    /* Missing files fail everywhere. */
+    rock_indx_t *indx_none = NULL;
+    rock_elem_t *elem_none = NULL;
+    assert(rock_dist_load_shared(&indx_none, &elem_none, desc, mpart, mesh,
+                indx_fname, "test_dist_load_shared_missing.h5") == NULL);
+
+    MPI_Barrier(mesh->comm);
+    if (mesh->rank == ROCK_MASTER) {
+        remove(indx_fname);
+        remove(elem_fname);
+        rock_indx_free(indx_sample);
+        rock_elem_free(elem_sample);
+    }
+
+    rock_indx_free(indx);
+    rock_elem_free(elem);
+    rock_dist_free(dist);
+    rock_mpart_free(mpart);
+    rock_desc_free(desc);
+    rock_mesh_free(mesh);
+
+    return ROCK_OK;
+}
+
+/*
+ * Unit test of distributing a memory mapped tensor (rock_tensor_mmap).
+ */
+int
+test_dist_mmap()
+{
+    char *fname = "test_dist_mmap.bin";
+
+    rock_uint_t proc_order = 3;
+    rock_uint_t proc_dims[] = {2, 4, 2};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    rock_uint_t order = 3;
+    rock_uint_t nnz = 1e5 + 7;
+    rock_uint_t dim_size[] = {300, 20, 25000};
+    rock_tensor_t *sample = NULL;
+    rock_tensor_t *mapped = NULL;
+    rock_indx_t *indx = NULL;
+    rock_elem_t *elem = NULL;
+
+    if (mesh->rank == ROCK_MASTER) {
+        sample = rock_tensor_init(order, dim_size, nnz);
+        rock_tensor_sample(sample);
+        assert(rock_tensor_save_native(sample, fname) == ROCK_OK);
+
+        mapped = rock_tensor_mmap(fname);
+        assert(mapped != NULL);
+        indx = mapped->indx;
+        elem = mapped->elem;
+    }
+
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+    rock_mpart_t *mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+    rock_uint_t part_dims[] = {2, 0, 1};
+    rock_mpart_desc_based(desc, mpart, 3, part_dims);
+
+    /* Grouped in place, the arrays stay mapped. */
+    rock_dist_t *dist = rock_dist_init(indx, elem, mpart, mesh);
+    assert(dist->sum == nnz);
+
+    /* Detached before scattering, which frees the master's arrays. */
+    if (mesh->rank == ROCK_MASTER) {
+        assert(indx->v == (void *) ((char *) mapped->map + ROCK_NATIVE_ALIGN));
+        rock_tensor_detach(mapped);
+        indx = mapped->indx;
+        elem = mapped->elem;
+    }
+    rock_indx_scatter(&indx, dist);
+    rock_elem_scatter(&elem, dist);
+    if (mesh->rank == ROCK_MASTER) {
+        mapped->indx = rock_indx_init(0);
+        mapped->elem = rock_elem_init(0);
+        rock_tensor_free(mapped);
+    }
+
+    for (rock_uint_t i = 0; i < indx->len; i++) {
+        assert(rock_part_num_from_mpart(mpart, indx, i) == mesh->rank);
+    }
+
+    check_gathered(desc, indx, elem, dist,
+            sample ? sample->indx : NULL, sample ? sample->elem : NULL);
+
+    MPI_Barrier(mesh->comm);
+    if (mesh->rank == ROCK_MASTER) {
+        remove(fname);
+        rock_tensor_free(sample);
+    }
+
+    rock_indx_free(indx);
+    rock_elem_free(elem);
+    rock_dist_free(dist);
+    rock_mpart_free(mpart);
+    rock_desc_free(desc);
+    rock_mesh_free(mesh);
+
+    return ROCK_OK;
+}
+
+int
+main(int argc, char **argv)
+{
+    MPI_Init(&argc, &argv);
+    assert(test_dist_save_load() == ROCK_OK);
+    assert(test_dist_load_other_np() == ROCK_OK);
+    assert(test_dist_load_shared() == ROCK_OK);
+    assert(test_dist_mmap() == ROCK_OK);
+    MPI_Finalize();
+
+    return ROCK_OK;
+}
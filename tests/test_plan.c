@@ -0,0 +1,148 @@
+/**
+ * @file test_plan.c
+ * @author timoteus <mail@timoteus.se>
+ */
+
+#include "core.h"
+#include "distribute.h"
+#include "plan.h"
+#include "random.h"
+
+/*
+ * Unit test of rock_comm_plan_exchange() and rock_comm_plan_reduce().
+ */
+int
+test_comm_plan()
+{
+    rock_indx_t *indx = NULL;
+    rock_elem_t *elem = NULL;
+
+    rock_uint_t proc_order = 2;
+    rock_uint_t proc_dims[] = {4, 4};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    /* Every processor needs the multi-partition to build a plan. */
+    rock_uint_t order = 3;
+    rock_uint_t nnz = 5e4;
+    rock_uint_t num_cols = 4;
+    rock_uint_t dim_size[] = {300, 7, 2500};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    rock_mpart_t *mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+    rock_uint_t part_dims[] = {0, 2};
+    rock_mpart_desc_based(desc, mpart, 2, part_dims);
+
+    if (mesh->rank == ROCK_MASTER) {
+        indx = rock_indx_init(nnz);
+        elem = rock_elem_init(nnz);
+        rock_indx_sample(desc, indx);
+        rock_elem_sample(desc, elem);
+    }
+
+    rock_dist_t *dist = rock_dist_init(indx, elem, mpart, mesh);
+    rock_indx_scatter(&indx, dist);
+    rock_elem_scatter(&elem, dist);
+
+    rock_comm_plan_t *plan =
+            rock_comm_plan_init(desc, indx, mpart, mesh, num_cols);
+
+    for (rock_uint_t d = 0; d < order; d++) {
+        rock_uint_t total_len;
+
+        /* Every row is owned by exactly one processor. */
+        MPI_Allreduce(&plan->own_len[d], &total_len, 1, ROCK_UINT_MPI,
+                MPI_SUM, mesh->comm);
+        assert(total_len == dim_size[d]);
+
+        /* The distinct indices cover every local non-zero element. */
+        for (rock_uint_t i = 0; i < indx->len; i++) {
+            rock_uint_t val = rock_indx_extract(desc, indx, i, d);
+            rock_uint_t low = 0, high = plan->num_uniq[d];
+            while (low < high) {
+                rock_uint_t mid = (low + high) / 2;
+                if (plan->uniq[d][mid] < val) {
+                    low = mid + 1;
+                } else {
+                    high = mid;
+                }
+            }
+            assert(low < plan->num_uniq[d] && plan->uniq[d][low] == val);
+        }
+
+        rock_elem_t *owned = rock_elem_init(plan->own_len[d] * num_cols);
+        rock_elem_t *needed = rock_elem_init(plan->num_uniq[d] * num_cols);
+
+        /* Exchange rows tagged by their global row and column. */
+        for (rock_uint_t r = 0; r < plan->own_len[d]; r++) {
+            for (rock_uint_t c = 0; c < num_cols; c++) {
+                owned->v[r * num_cols + c] =
+                        (plan->own_offset[d] + r) * num_cols + c;
+            }
+        }
+
+        assert(rock_comm_plan_exchange(plan, d, owned, needed) == ROCK_OK);
+
+        for (rock_uint_t u = 0; u < plan->num_uniq[d]; u++) {
+            for (rock_uint_t c = 0; c < num_cols; c++) {
+                assert(needed->v[u * num_cols + c] ==
+                        plan->uniq[d][u] * num_cols + c);
+            }
+        }
+
+        /* Reduce ones, each owned row counts the processors using it. */
+        rock_uint_t *used = calloc(dim_size[d], sizeof(rock_uint_t));
+        rock_uint_t *num_used = calloc(dim_size[d], sizeof(rock_uint_t));
+
+        for (rock_uint_t u = 0; u < plan->num_uniq[d]; u++) {
+            used[plan->uniq[d][u]] = 1;
+        }
+        MPI_Allreduce(used, num_used, dim_size[d], ROCK_UINT_MPI, MPI_SUM,
+                mesh->comm);
+
+        for (rock_uint_t i = 0; i < needed->len; i++) {
+            needed->v[i] = 1;
+        }
+        for (rock_uint_t i = 0; i < owned->len; i++) {
+            owned->v[i] = 0;
+        }
+
+        assert(rock_comm_plan_reduce(plan, d, needed, owned) == ROCK_OK);
+
+        for (rock_uint_t r = 0; r < plan->own_len[d]; r++) {
+            for (rock_uint_t c = 0; c < num_cols; c++) {
+                assert(owned->v[r * num_cols + c] ==
+                        num_used[plan->own_offset[d] + r]);
+            }
+        }
+
+        free(used);
+        free(num_used);
+        rock_elem_free(owned);
+        rock_elem_free(needed);
+    }
+
+    assert(rock_comm_plan_exchange(plan, order, NULL, NULL) ==
+            ROCK_BAD_INPUT);
+
+    rock_comm_plan_free(plan);
+    rock_dist_free(dist);
+    rock_mpart_free(mpart);
+    rock_indx_free(indx);
+    rock_elem_free(elem);
+    rock_desc_free(desc);
+    rock_mesh_free(mesh);
+
+    return ROCK_OK;
+}
+
+int
+main(int argc, char **argv)
+{
+    srand(time(NULL));
+
+    MPI_Init(&argc, &argv);
+    assert(test_comm_plan() == ROCK_OK);
+    MPI_Finalize();
+
+    return ROCK_OK;
+}
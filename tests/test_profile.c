@@ -0,0 +1,156 @@
+/**
+ * @file test_profile.c
+ * @author timoteus <mail@timoteus.se>
+ */
+
+#include "core.h"
+#include "distribute.h"
+#include "profile.h"
+#include "random.h"
+
+/*
+ * Unit test of rock_prof_stop(), rock_prof_barrier() and rock_prof_get().
+ */
+int
+test_prof_records()
+{
+    rock_indx_t *indx = NULL;
+    rock_elem_t *elem = NULL;
+    rock_desc_t *desc = NULL;
+    rock_mpart_t *mpart = NULL;
+
+    rock_uint_t proc_order = 2;
+    rock_uint_t proc_dims[] = {4, 4};
+    rock_mesh_t *mesh = rock_mesh_init(MPI_COMM_WORLD, proc_order, proc_dims);
+
+    if (mesh->rank == ROCK_MASTER) {
+        rock_uint_t order = 3;
+        rock_uint_t nnz = 1e4;
+        rock_uint_t dim_size[] = {300, 20, 2500};
+        desc = rock_desc_init(order, dim_size);
+
+        mpart = rock_mpart_init(mesh->order, mesh->dim_size);
+        rock_mpart_desc_based(desc, mpart, 0, NULL);
+
+        indx = rock_indx_init(nnz);
+        elem = rock_elem_init(nnz);
+        rock_indx_sample(desc, indx);
+        rock_elem_sample(desc, elem);
+    }
+
+    /* Nothing is recorded unless switched on. */
+    rock_prof_reset();
+    rock_dist_t *dist = rock_dist_init(indx, elem, mpart, mesh);
+    assert(rock_prof_get(ROCK_PROF_DIST_INIT)->calls == 0);
+
+    rock_profiling = 1;
+
+    rock_indx_scatter(&indx, dist);
+    rock_elem_scatter(&elem, dist);
+    rock_indx_gather(&indx, dist);
+
+    rock_prof_t *rec = rock_prof_get(ROCK_PROF_INDX_SCATTER);
+    assert(rec->calls == 1);
+    assert(rec->time >= rec->wait && rec->wait >= 0);
+
+    if (mesh->rank == ROCK_MASTER) {
+        uint64_t sent = dist->sum - dist->count[ROCK_MASTER];
+        assert(rec->bytes == sent * sizeof(rock_uint_t));
+        assert(rec->msgs == mesh->np - 1);
+    } else {
+        assert(rec->bytes == dist->count[mesh->rank] * sizeof(rock_uint_t));
+        assert(rec->msgs == 1);
+    }
+
+    /* Every processor sends what the master receives. */
+    uint64_t bytes = rock_prof_get(ROCK_PROF_INDX_GATHER)->bytes;
+    uint64_t total = 0;
+    MPI_Allreduce(&bytes, &total, 1, MPI_UINT64_T, MPI_SUM, mesh->comm);
+    assert(total == 2 * (dist->sum - dist->count[ROCK_MASTER]) *
+            sizeof(rock_uint_t));
+
+    rock_prof_barrier(ROCK_PROF_INDX_GATHER, mesh->comm);
+    assert(rock_prof_get(ROCK_PROF_INDX_GATHER)->calls == 1);
+
+    assert(rock_prof_get(ROCK_PROF_NUM_OPS) == NULL);
+    assert(rock_prof_name(ROCK_PROF_NUM_OPS) == NULL);
+    assert(strcmp(rock_prof_name(ROCK_PROF_ELEM_SCATTER),
+            "rock_elem_scatter") == 0);
+
+    rock_prof_reset();
+    assert(rock_prof_get(ROCK_PROF_INDX_SCATTER)->calls == 0);
+
+    rock_profiling = 0;
+
+    if (mesh->rank == ROCK_MASTER) {
+        rock_indx_free(indx);
+        rock_mpart_free(mpart);
+        rock_desc_free(desc);
+    }
+
+    rock_elem_free(elem);
+    rock_dist_free(dist);
+    rock_mesh_free(mesh);
+
+    return ROCK_OK;
+}
+
+/*
+ * Unit test of rock_prof_report().
+ */
+int
+test_prof_report()
+{
+    int rank;
+    MPI_Comm_rank(MPI_COMM_WORLD, &rank);
+
+    rock_prof_reset();
+    rock_profiling = 1;
+
+    /* Only some processors take part in an operation. */
+    double start = rock_prof_start();
+    if (rank % 2 == 0) {
+        rock_prof_stop(ROCK_PROF_REDISTRIBUTE, start, 100, 3);
+    }
+    rock_prof_stop(ROCK_PROF_CHUNK_SCATTER, start, 10, 1);
+
+    rock_profiling = 0;
+
+    char buf[1 << 14] = {0};
+    FILE *stream = tmpfile();
+
+    assert(rock_prof_report(MPI_COMM_WORLD, stream, 42) == ROCK_BAD_INPUT);
+    assert(rock_prof_report(MPI_COMM_WORLD, stream, ROCK_PROF_TABLE)
+            == ROCK_OK);
+    assert(rock_prof_report(MPI_COMM_WORLD, stream, ROCK_PROF_JSON)
+            == ROCK_OK);
+
+    rewind(stream);
+    fread(buf, 1, sizeof(buf) - 1, stream);
+    fclose(stream);
+
+    if (rank == ROCK_MASTER) {
+        assert(strstr(buf, "rock_redistribute") != NULL);
+        assert(strstr(buf, "rock_chunk_scatter") != NULL);
+        assert(strstr(buf, "rock_dist_init") == NULL);
+        assert(strstr(buf, "\"np\": 16") != NULL);
+        assert(strstr(buf, "\"bytes\": [100, 0, 100, 0") != NULL);
+    }
+
+    rock_prof_reset();
+
+    return ROCK_OK;
+}
+
+int
+main(int argc, char **argv)
+{
+    srand(time(NULL));
+
+    MPI_Init(&argc, &argv);
+    assert(test_prof_records() == ROCK_OK);
+    assert(test_prof_report() == ROCK_OK);
+    MPI_Finalize();
+
+    return ROCK_OK;
+}
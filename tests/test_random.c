@@ -5,6 +5,7 @@
 
 #include "core.h"
 #include "random.h"
+#include "sort.h"
 
 /**
   * Unit test of rock_indx_sample().
@@ -59,12 +60,103 @@ test_rock_indx_sample()
     rock_indx_free(indx_ok);
 }
 
+/**
+ * Unit test of rock_lmap_sample().
+ */
+void
+test_rock_lmap_sample()
+{
+    rock_uint_t order = 3;
+    rock_uint_t dim_size[] = {6, 40, 2};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+    rock_lmap_t *lmap = rock_lmap_init(desc);
+
+    rock_lmap_sample(lmap);
+
+    for (rock_uint_t i = 0; i < order; i++) {
+        for (rock_uint_t k = 0; k < dim_size[i]; k++) {
+            assert(lmap->dim_map[i][k] < dim_size[i]);
+            assert(lmap->dim_inv[i][lmap->dim_map[i][k]] == k);
+        }
+    }
+
+    rock_lmap_free(lmap);
+    rock_desc_free(desc);
+}
+
+/**
+ * Unit test of rock_indx_sample_range().
+ */
+void
+test_rock_indx_sample_range()
+{
+    rock_uint_t order = 3;
+    rock_uint_t dim_size[] = {60, 400, 20};
+    rock_desc_t *desc = rock_desc_init(order, dim_size);
+
+    rock_uint_t first = 1000;
+    rock_uint_t range = 150000;
+    rock_uint_t len = 1e5;
+
+    rock_indx_t *indx_err = rock_indx_init(range + 1);
+    assert(rock_indx_sample_range(desc, indx_err, first, range, 7)
+            == ROCK_BAD_INPUT);
+    assert(rock_indx_sample_range(desc, indx_err, desc->total_size - 10,
+            range, 7) == ROCK_BAD_INPUT);
+
+    rock_indx_t *indx = rock_indx_init(len);
+    assert(rock_indx_sample_range(desc, indx, first, range, 7) == ROCK_OK);
+
+    /* Distinct positions within the range, in increasing order. */
+    rock_uint_t prev = 0;
+    for (rock_uint_t i = 0; i < indx->len; i++) {
+        rock_uint_t pos = 0;
+        for (rock_uint_t k = order; k-- > 0;) {
+            pos = pos * dim_size[k] + rock_indx_extract(desc, indx, i, k);
+        }
+        assert(pos >= first && pos < first + range);
+        assert(i == 0 || pos > prev);
+        prev = pos;
+    }
+
+    /* Same seed, same indices, regardless of the number of threads. */
+    rock_indx_t *indx_same = rock_indx_init(len);
+    rock_num_threads = 3;
+    rock_indx_sample_range(desc, indx_same, first, range, 7);
+    rock_num_threads = ROCK_USE_DEFAULT;
+    assert(rock_indx_eq(indx, indx_same));
+
+    rock_indx_sample_range(desc, indx_same, first, range, 8);
+    assert(!rock_indx_eq(indx, indx_same));
+
+    /* Elements are in [0, 1) and reproducible from any offset. */
+    rock_elem_t *elem = rock_elem_init(100);
+    rock_elem_t *elem_tail = rock_elem_init(50);
+    rock_elem_sample_counter(elem, 7, 0);
+    rock_elem_sample_counter(elem_tail, 7, 50);
+    for (rock_uint_t i = 0; i < elem->len; i++) {
+        assert(elem->v[i] >= 0 && elem->v[i] < 1);
+    }
+    for (rock_uint_t i = 0; i < elem_tail->len; i++) {
+        assert(elem_tail->v[i] == elem->v[50 + i]);
+    }
+
+    rock_elem_free(elem);
+    rock_elem_free(elem_tail);
+    rock_indx_free(indx_same);
+    rock_indx_free(indx);
+    rock_indx_free(indx_err);
+    rock_desc_free(desc);
+}
+
 int
 main()
 {
     srand(time(NULL));
 
     test_rock_indx_sample();
+    test_rock_lmap_sample();
+    test_rock_indx_sample_range();
 
     return ROCK_OK;
 }
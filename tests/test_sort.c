@@ -96,12 +96,57 @@ test_rock_indx_sort()
     rock_perm_free(perm_correct);
 }
 
+/*
+ * Unit test of rock_thread_count().
+ */
+void
+test_rock_thread_count()
+{
+    rock_uint_t small = ROCK_PARALLEL_THRESHOLD;
+    rock_uint_t large = 2 * ROCK_PARALLEL_THRESHOLD;
+    int max_threads = omp_get_max_threads();
+
+    rock_num_threads = ROCK_USE_DEFAULT;
+    rock_max_threads = ROCK_USE_DEFAULT;
+    assert(rock_thread_count(small) == 1);
+    assert(rock_thread_count(large) == max_threads);
+
+    rock_max_threads = 3;
+    assert(rock_thread_count(small) == 1);
+    assert(rock_thread_count(large) == ((max_threads < 3) ? max_threads : 3));
+
+    /* Never more than the OpenMP runtime offers. */
+    omp_set_num_threads(2);
+    assert(rock_thread_count(large) == 2);
+    omp_set_num_threads(max_threads);
+
+    rock_num_threads = 5;
+    assert(rock_thread_count(small) == 5);
+    assert(rock_thread_count(large) == 5);
+
+    /* Sorting leaves the settings of the OpenMP runtime alone. */
+    rock_num_threads = ROCK_USE_DEFAULT;
+    rock_max_threads = ROCK_USE_DEFAULT;
+
+    rock_uint_t dim_size[] = {10};
+    rock_uint_t dims[] = {0};
+    rock_desc_t *desc = rock_desc_init(1, dim_size);
+    rock_indx_t *indx = rock_indx_init(10);
+
+    rock_indx_sort(desc, 1, dims, NULL, indx);
+    assert(omp_get_max_threads() == max_threads);
+
+    rock_indx_free(indx);
+    rock_desc_free(desc);
+}
+
 int
 main()
 {
     srand(time(NULL));
 
     test_rock_indx_sort();
+    test_rock_thread_count();
 
     return ROCK_OK;
 }
@@ -0,0 +1,349 @@
+/**
+ * @file test_text.c
+ * @author timoteus <mail@timoteus.se>
+ */
+
+#include "core.h"
+#include "text.h"
+#include "sort.h"
+#include "random.h"
+
+/*
+ * Write a string to a file.
+ */
+void
+write_file(char *fname, char *text)
+{
+    FILE *f = fopen(fname, "w");
+    fputs(text, f);
+    fclose(f);
+}
+
+/**
+ * Unit test of rock_tns_load() on hand written input.
+ */
+void
+test_rock_tns_load()
+{
+    char *fname = "test_rock_tns_load.tns";
+
+    write_file(fname,
+            "# FROSTT tensor\n"
+            "1 1 1 1.5\n"
+            "\n"
+            "  3\t2 4  -2.25e-3\r\n"
+            "# interleaved comment\n"
+            "2 5 1 7\n"
+            "1 2 3 0.1\n"
+            "3 5 4 123456789012345678901234.5");
+
+    /* Order and dimension sizes discovered. */
+    rock_tensor_t *tensor = rock_tns_load(fname, 0, NULL);
+    assert(tensor != NULL);
+    assert(tensor->desc->order == 3);
+    assert(tensor->desc->dim_size[0] == 3);
+    assert(tensor->desc->dim_size[1] == 5);
+    assert(tensor->desc->dim_size[2] == 4);
+    assert(tensor->indx->len == 5);
+
+    rock_uint_t expected[][3] = {{0, 0, 0}, {2, 1, 3}, {1, 4, 0}, {0, 1, 2},
+        {2, 4, 3}};
+    double values[] = {1.5, -2.25e-3, 7, 0.1, 123456789012345678901234.5};
+    rock_elem_t *elem = rock_elem_init(5);
+
+    for (rock_uint_t i = 0; i < 5; i++) {
+        for (rock_uint_t k = 0; k < 3; k++) {
+            assert(rock_indx_extract(tensor->desc, tensor->indx, i, k) ==
+                    expected[i][k]);
+        }
+        elem->v[i] = values[i];
+    }
+    assert(rock_elem_eq(tensor->elem, elem));
+    rock_elem_free(elem);
+    rock_tensor_free(tensor);
+
+    /* Given dimension sizes, coordinates must be within them. */
+    rock_uint_t dim_size[] = {10, 10, 10};
+    tensor = rock_tns_load(fname, 3, dim_size);
+    assert(tensor != NULL);
+    assert(tensor->desc->dim_size[0] == 10);
+    rock_tensor_free(tensor);
+
+    rock_uint_t small_size[] = {3, 4, 4};
+    assert(rock_tns_load(fname, 3, small_size) == NULL);
+
+    /* Malformed lines. */
+    write_file(fname, "1 1 1 1.0\n0 1 1 1.0\n");
+    assert(rock_tns_load(fname, 0, NULL) == NULL);
+    write_file(fname, "1 1 1 1.0\n1 1 x 1.0\n");
+    assert(rock_tns_load(fname, 0, NULL) == NULL);
+    write_file(fname, "1 1 1 1.0\n1 1 1 1.0 5\n");
+    assert(rock_tns_load(fname, 0, NULL) == NULL);
+
+    /* Empty files. */
+    write_file(fname, "");
+    assert(rock_tns_load(fname, 0, NULL) == NULL);
+    tensor = rock_tns_load(fname, 3, dim_size);
+    assert(tensor != NULL && tensor->indx->len == 0);
+    rock_tensor_free(tensor);
+
+    assert(rock_tns_load("test_rock_tns_missing.tns", 0, NULL) == NULL);
+
+    remove(fname);
+}
+
+/**
+ * Unit test of rock_tns_save() and rock_tns_load() using many threads.
+ */
+void
+test_rock_tns_save_load()
+{
+    char *fname = "test_rock_tns_save_load.tns";
+
+    rock_uint_t order = 4;
+    rock_uint_t dim_size[] = {20, 500, 4, 1000};
+    rock_uint_t nnz = 100000;
+
+    rock_tensor_t *tensor = rock_tensor_init(order, dim_size, nnz);
+    rock_tensor_sample(tensor);
+    tensor->elem->v[0] = 0.5;
+    tensor->elem->v[1] = -1e-300;
+
+    /* More ranges than lines per block, and uneven ranges. */
+    rock_num_threads = 7;
+    assert(rock_tns_save(tensor, fname) == ROCK_OK);
+
+    rock_tensor_t *loaded = rock_tns_load(fname, order, dim_size);
+    assert(loaded != NULL);
+    assert(rock_indx_eq(loaded->indx, tensor->indx));
+    assert(rock_elem_eq(loaded->elem, tensor->elem));
+    rock_tensor_free(loaded);
+
+    /* Same result using a single thread. */
+    rock_num_threads = 1;
+    loaded = rock_tns_load(fname, order, dim_size);
+    assert(rock_indx_eq(loaded->indx, tensor->indx));
+    rock_tensor_free(loaded);
+    rock_num_threads = ROCK_USE_DEFAULT;
+
+    rock_tensor_free(tensor);
+    remove(fname);
+}
+
+/*
+ * Assert that the elements of a matrix are the expected ones, in order.
+ */
+void
+assert_matrix(rock_tensor_t *tensor,
+              rock_uint_t len,
+              rock_uint_t expected[][2],
+              double *values)
+{
+    rock_elem_t *elem = rock_elem_init(len);
+
+    assert(tensor->indx->len == len);
+    for (rock_uint_t i = 0; i < len; i++) {
+        for (rock_uint_t k = 0; k < 2; k++) {
+            assert(rock_indx_extract(tensor->desc, tensor->indx, i, k) ==
+                    expected[i][k]);
+        }
+        elem->v[i] = values[i];
+    }
+    assert(rock_elem_eq(tensor->elem, elem));
+    rock_elem_free(elem);
+}
+
+/**
+ * Unit test of rock_mm_load().
+ */
+void
+test_rock_mm_load()
+{
+    char *fname = "test_rock_mm_load.mtx";
+
+    write_file(fname,
+            "%%MatrixMarket matrix coordinate real general\n"
+            "% comment\n"
+            "%\n"
+            "  4 6 3\n"
+            "1 1 1.5\n"
+            "4 6 -2\n"
+            "2 3 1e2\n");
+
+    rock_tensor_t *tensor = rock_mm_load(fname);
+    assert(tensor != NULL);
+    assert(tensor->desc->order == 2);
+    assert(tensor->desc->dim_size[0] == 4);
+    assert(tensor->desc->dim_size[1] == 6);
+    assert_matrix(tensor, 3, (rock_uint_t [][2]) {{0, 0}, {3, 5}, {1, 2}},
+            (double []) {1.5, -2, 100});
+    rock_tensor_free(tensor);
+
+    /* Pattern matrices have values of 1. */
+    write_file(fname,
+            "%%MatrixMarket Matrix Coordinate Pattern General\n"
+            "3 3 2\n"
+            "1 2\n"
+            "3 1\n");
+    tensor = rock_mm_load(fname);
+    assert(tensor != NULL);
+    assert_matrix(tensor, 2, (rock_uint_t [][2]) {{0, 1}, {2, 0}},
+            (double []) {1, 1});
+    rock_tensor_free(tensor);
+
+    /* The upper triangle is added, except for the diagonal. */
+    write_file(fname,
+            "%%MatrixMarket matrix coordinate integer symmetric\n"
+            "3 3 3\n"
+            "1 1 4\n"
+            "3 1 5\n"
+            "3 2 6\n");
+    tensor = rock_mm_load(fname);
+    assert(tensor != NULL);
+    assert_matrix(tensor, 5,
+            (rock_uint_t [][2]) {{0, 0}, {2, 0}, {0, 2}, {2, 1}, {1, 2}},
+            (double []) {4, 5, 5, 6, 6});
+    rock_tensor_free(tensor);
+
+    write_file(fname,
+            "%%MatrixMarket matrix coordinate real skew-symmetric\n"
+            "2 2 1\n"
+            "2 1 0.5\n");
+    tensor = rock_mm_load(fname);
+    assert(tensor != NULL);
+    assert_matrix(tensor, 2, (rock_uint_t [][2]) {{1, 0}, {0, 1}},
+            (double []) {0.5, -0.5});
+    rock_tensor_free(tensor);
+
+    /* Entries not matching the size line. */
+    write_file(fname,
+            "%%MatrixMarket matrix coordinate real general\n"
+            "2 2 3\n"
+            "1 1 1\n"
+            "2 2 1\n");
+    assert(rock_mm_load(fname) == NULL);
+    write_file(fname,
+            "%%MatrixMarket matrix coordinate real general\n"
+            "2 2 1\n"
+            "3 1 1\n");
+    assert(rock_mm_load(fname) == NULL);
+
+    /* Unsupported formats. */
+    write_file(fname,
+            "%%MatrixMarket matrix coordinate complex general\n"
+            "2 2 1\n"
+            "1 1 1 0\n");
+    assert(rock_mm_load(fname) == NULL);
+    write_file(fname,
+            "%%MatrixMarket matrix array real general\n"
+            "1 1\n"
+            "1\n");
+    assert(rock_mm_load(fname) == NULL);
+    write_file(fname, "1 1 1\n");
+    assert(rock_mm_load(fname) == NULL);
+
+    remove(fname);
+}
+
+/**
+ * Unit test of rock_csv_load().
+ */
+void
+test_rock_csv_load()
+{
+    char *fname = "test_rock_csv_load.csv";
+
+    /* Header, zero-based coordinates, discovered sizes. */
+    write_file(fname,
+            "row,col,value\n"
+            "0,0,1.5\n"
+            "3, 1 ,-2\n"
+            "# comment\n"
+            "1,4,7\n");
+
+    rock_tensor_t *tensor = rock_csv_load(fname, ',', 0, 0, NULL);
+    assert(tensor != NULL);
+    assert(tensor->desc->order == 2);
+    assert(tensor->desc->dim_size[0] == 4);
+    assert(tensor->desc->dim_size[1] == 5);
+    assert_matrix(tensor, 3, (rock_uint_t [][2]) {{0, 0}, {3, 1}, {1, 4}},
+            (double []) {1.5, -2, 7});
+    rock_tensor_free(tensor);
+
+    /* Given sizes, must hold the coordinates. */
+    rock_uint_t dim_size[] = {8, 8};
+    tensor = rock_csv_load(fname, ',', 0, 2, dim_size);
+    assert(tensor != NULL);
+    assert(tensor->desc->dim_size[0] == 8);
+    rock_tensor_free(tensor);
+
+    rock_uint_t small_size[] = {3, 8};
+    assert(rock_csv_load(fname, ',', 0, 2, small_size) == NULL);
+
+    /* No header, one-based, no values. */
+    write_file(fname,
+            "1;2\n"
+            "2;1\n");
+    tensor = rock_csv_load(fname, ';', 1, 2, NULL);
+    assert(tensor != NULL);
+    assert_matrix(tensor, 2, (rock_uint_t [][2]) {{0, 1}, {1, 0}},
+            (double []) {1, 1});
+    rock_tensor_free(tensor);
+
+    /* Wrong delimiter. */
+    assert(rock_csv_load(fname, ',', 1, 2, NULL) == NULL);
+
+    remove(fname);
+}
+
+/**
+ * Unit test of rock_csv_load() using many threads.
+ */
+void
+test_rock_csv_load_threads()
+{
+    char *fname = "test_rock_csv_load_threads.csv";
+
+    rock_uint_t order = 3;
+    rock_uint_t dim_size[] = {30, 700, 9};
+    rock_uint_t nnz = 50000;
+
+    rock_tensor_t *tensor = rock_tensor_init(order, dim_size, nnz);
+    rock_tensor_sample(tensor);
+
+    FILE *f = fopen(fname, "w");
+    fputs("i,j,k,value\n", f);
+    for (rock_uint_t i = 0; i < nnz; i++) {
+        for (rock_uint_t k = 0; k < order; k++) {
+            fprintf(f, "%lu,", (unsigned long)
+                    rock_indx_extract(tensor->desc, tensor->indx, i, k));
+        }
+        fprintf(f, "%.17g\n", (double) tensor->elem->v[i]);
+    }
+    fclose(f);
+
+    rock_num_threads = 5;
+    rock_tensor_t *loaded = rock_csv_load(fname, ',', 0, order, dim_size);
+    assert(loaded != NULL);
+    assert(rock_indx_eq(loaded->indx, tensor->indx));
+    assert(rock_elem_eq(loaded->elem, tensor->elem));
+    rock_tensor_free(loaded);
+    rock_num_threads = ROCK_USE_DEFAULT;
+
+    rock_tensor_free(tensor);
+    remove(fname);
+}
+
+int
+main()
+{
+    srand(time(NULL));
+
+    test_rock_tns_load();
+    test_rock_tns_save_load();
+    test_rock_mm_load();
+    test_rock_csv_load();
+    test_rock_csv_load_threads();
+
+    return ROCK_OK;
+}